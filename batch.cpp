@@ -0,0 +1,225 @@
+#include "headers/batch.h"
+#include <cstdio>
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#include <immintrin.h>
+#define BATCH_HAVE_AVX2_PATH 1
+#endif
+
+// Info bits of a table entry; ticks taken are stored from bit 8
+static const int BATCH_INFO_FALL = 1;  // Lands off the platform or on a gap
+static const int BATCH_INFO_GOAL = 2;  // Stands on the goal
+static const int BATCH_INFO_RESET = 4; // Restart: hide every bridge
+static const int BATCH_TICKS_SHIFT = 8;
+
+// Entries per state: one per input, padded to 8 (unknown inputs wait)
+static const int BATCH_INPUTS = 8;
+
+bool batchLoadLevel(BatchSim &batch, const SimState &level, int games) {
+  const int cells = level.rows * level.cols;
+  if (level.toggleGroups.size() > 32) {
+    printf("Batch: %d toggle groups, at most 32 fit the mask\n",
+           (int)level.toggleGroups.size());
+    return false;
+  }
+  if (cells <= 0 || cells > (1 << 22)) {
+    printf("Batch: level of %d x %d is too large\n", level.rows, level.cols);
+    return false;
+  }
+
+  // Toggle group of each bridge cell (-1 if none) and the groups each
+  // action tile toggles
+  std::vector<int> bridgeGroup(cells, -1);
+  std::vector<unsigned int> actionGroups(cells, 0);
+  for (size_t g = 0; g < level.toggleGroups.size(); g++) {
+    const ToggleGroup &group = level.toggleGroups[g];
+    for (size_t t = 0; t < group.tiles.size(); t++) {
+      int cell = group.tiles[t].first * level.cols + group.tiles[t].second;
+      if (bridgeGroup[cell] >= 0 && bridgeGroup[cell] != (int)g) {
+        printf("Batch: tile %d,%d is in two toggle groups\n",
+               group.tiles[t].first, group.tiles[t].second);
+        return false;
+      }
+      bridgeGroup[cell] = g;
+    }
+    if (simTileAt(level, group.actionRow, group.actionCol) == 5)
+      actionGroups[group.actionRow * level.cols + group.actionCol] |= 1u << g;
+  }
+  for (int cell = 0; cell < cells; cell++) {
+    if (actionGroups[cell] && bridgeGroup[cell] >= 0) {
+      printf("Batch: action tile %d,%d is also a bridge\n", cell / level.cols,
+             cell % level.cols);
+      return false;
+    }
+  }
+
+  batch.rows = level.rows;
+  batch.cols = level.cols;
+  batch.groupCount = level.toggleGroups.size();
+  batch.startState = (level.startRow * level.cols + level.startCol) * 4;
+  batch.table.assign((size_t)cells * 4 * BATCH_INPUTS * 4, 0);
+
+  // Rolls come from the rules themselves, played on a scratch copy
+  SimState scratch = level;
+  for (int state = 0; state < cells * 4; state++) {
+    int *entry = &batch.table[(size_t)state * BATCH_INPUTS * 4];
+    for (int input = 0; input < BATCH_INPUTS; input++, entry += 4) {
+      entry[0] = state;
+      entry[3] = 1 << BATCH_TICKS_SHIFT;
+      if (input == INPUT_RESET) {
+        entry[0] = batch.startState;
+        entry[3] |= BATCH_INFO_RESET;
+      }
+      if (input < INPUT_LEFT || input > INPUT_DOWN || (state & 3) == 3)
+        continue;
+
+      Block &block = scratch.block;
+      block.row = (state >> 2) / level.cols;
+      block.col = (state >> 2) % level.cols;
+      block.orientation = (BlockOrientation)(state & 3);
+      simMoveBlock(scratch, (SimInput)input);
+      entry[3] = BLOCK_ANIMATION_TICKS << BATCH_TICKS_SHIFT;
+
+      int row2, col2;
+      simSecondCell(block, row2, col2);
+      const int rowsOf[2] = {block.row, row2};
+      const int colsOf[2] = {block.col, col2};
+      bool inside = true;
+      for (int c = 0; c < 2; c++) {
+        int row = rowsOf[c], col = colsOf[c];
+        if ((unsigned)row >= (unsigned)level.rows ||
+            (unsigned)col >= (unsigned)level.cols) {
+          inside = false;
+          entry[3] |= BATCH_INFO_FALL;
+          continue;
+        }
+        int cell = row * level.cols + col;
+        if (bridgeGroup[cell] >= 0)
+          entry[1] |= 1u << bridgeGroup[cell];
+        else if (level.layout[row][col] == 0)
+          entry[3] |= BATCH_INFO_FALL;
+        entry[2] |= actionGroups[cell];
+      }
+      if (block.orientation == STANDING &&
+          simTileAt(level, block.row, block.col) == 2)
+        entry[3] |= BATCH_INFO_GOAL;
+      entry[0] = inside ? (block.row * level.cols + block.col) * 4 +
+                              block.orientation
+                        : batch.startState;
+    }
+  }
+
+  batch.count = games;
+  batchReset(batch);
+  return true;
+}
+
+void batchReset(BatchSim &batch) {
+  batch.state.assign(batch.count, batch.startState);
+  batch.mask.assign(batch.count, 0);
+  batch.ticks.assign(batch.count, 0);
+}
+
+// One game: landing toggles first, then a win restarts the level (one more
+// tick, as INPUT_RESET) or a missing tile makes the block fall back to the
+// start with the bridges left as they are
+static inline void stepGame(BatchSim &batch, int i, unsigned char action,
+                            unsigned char *events) {
+  const int *entry =
+      &batch.table[((size_t)batch.state[i] * BATCH_INPUTS + (action & 7)) * 4];
+  int info = entry[3];
+  unsigned int mask = batch.mask[i] ^ (unsigned int)entry[2];
+  if (info & BATCH_INFO_RESET)
+    mask = 0;
+  bool won = (info & BATCH_INFO_GOAL) != 0;
+  bool fell = !won && ((info & BATCH_INFO_FALL) ||
+                       ((unsigned int)entry[1] & ~mask) != 0);
+  batch.state[i] = won || fell ? batch.startState : entry[0];
+  batch.mask[i] = won ? 0 : mask;
+  batch.ticks[i] +=
+      (info >> BATCH_TICKS_SHIFT) + (fell ? FALL_RESET_TICKS : 0) + won;
+  if (events)
+    events[i] = won ? BATCH_WON : fell ? BATCH_FELL : BATCH_NONE;
+}
+
+void batchStepScalar(BatchSim &batch, const unsigned char *actions,
+                     unsigned char *events, int first, int count) {
+  for (int i = first; i < first + count; i++)
+    stepGame(batch, i, actions[i], events);
+}
+
+#ifdef BATCH_HAVE_AVX2_PATH
+// The same step for 8 games: four gathers from the entry of each game's
+// (state, action), then the toggle, win and fall logic as lane masks
+__attribute__((target("avx2"))) static int
+stepAvx2(BatchSim &batch, const unsigned char *actions, unsigned char *events,
+         int first, int count) {
+  const int *table = batch.table.data();
+  const __m256i start = _mm256_set1_epi32(batch.startState);
+  const __m256i seven = _mm256_set1_epi32(7);
+  const __m256i zero = _mm256_setzero_si256();
+  const __m256i ones = _mm256_set1_epi32(-1);
+  const __m256i fallBit = _mm256_set1_epi32(BATCH_INFO_FALL);
+  const __m256i goalBit = _mm256_set1_epi32(BATCH_INFO_GOAL);
+  const __m256i resetBit = _mm256_set1_epi32(BATCH_INFO_RESET);
+  const __m256i fallTicks = _mm256_set1_epi32(FALL_RESET_TICKS);
+  const __m256i one = _mm256_set1_epi32(1);
+  const __m256i two = _mm256_set1_epi32(2);
+
+  int i = first;
+  for (; i + 8 <= first + count; i += 8) {
+    __m256i *statePtr = (__m256i *)&batch.state[i];
+    __m256i *maskPtr = (__m256i *)&batch.mask[i];
+    __m256i *ticksPtr = (__m256i *)&batch.ticks[i];
+    __m256i state = _mm256_loadu_si256(statePtr);
+    __m256i action = _mm256_and_si256(
+        _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i *)(actions + i))),
+        seven);
+    __m256i index =
+        _mm256_slli_epi32(_mm256_or_si256(_mm256_slli_epi32(state, 3), action),
+                          2);
+    __m256i next = _mm256_i32gather_epi32(table, index, 4);
+    __m256i need = _mm256_i32gather_epi32(table + 1, index, 4);
+    __m256i toggle = _mm256_i32gather_epi32(table + 2, index, 4);
+    __m256i info = _mm256_i32gather_epi32(table + 3, index, 4);
+
+    __m256i reset = _mm256_cmpeq_epi32(_mm256_and_si256(info, resetBit),
+                                       resetBit);
+    __m256i mask = _mm256_andnot_si256(
+        reset, _mm256_xor_si256(_mm256_loadu_si256(maskPtr), toggle));
+    __m256i won = _mm256_cmpeq_epi32(_mm256_and_si256(info, goalBit), goalBit);
+    __m256i hard = _mm256_cmpeq_epi32(_mm256_and_si256(info, fallBit), fallBit);
+    __m256i missing = _mm256_xor_si256(
+        _mm256_cmpeq_epi32(_mm256_andnot_si256(mask, need), zero), ones);
+    __m256i fell = _mm256_andnot_si256(won, _mm256_or_si256(hard, missing));
+    __m256i restart = _mm256_or_si256(won, fell);
+
+    _mm256_storeu_si256(statePtr, _mm256_blendv_epi8(next, start, restart));
+    _mm256_storeu_si256(maskPtr, _mm256_andnot_si256(won, mask));
+    __m256i ticks = _mm256_add_epi32(
+        _mm256_srli_epi32(info, BATCH_TICKS_SHIFT),
+        _mm256_add_epi32(_mm256_and_si256(fell, fallTicks),
+                         _mm256_and_si256(won, one)));
+    _mm256_storeu_si256(ticksPtr,
+                        _mm256_add_epi32(_mm256_loadu_si256(ticksPtr), ticks));
+    if (events) {
+      __m256i event = _mm256_or_si256(_mm256_and_si256(fell, one),
+                                      _mm256_and_si256(won, two));
+      __m128i words = _mm_packus_epi32(_mm256_castsi256_si128(event),
+                                       _mm256_extracti128_si256(event, 1));
+      _mm_storel_epi64((__m128i *)(events + i), _mm_packus_epi16(words, words));
+    }
+  }
+  return i;
+}
+#endif
+
+void batchStep(BatchSim &batch, const unsigned char *actions,
+               unsigned char *events, int first, int count) {
+  int done = first;
+#ifdef BATCH_HAVE_AVX2_PATH
+  static const bool avx2 = __builtin_cpu_supports("avx2");
+  if (avx2)
+    done = stepAvx2(batch, actions, events, first, count);
+#endif
+  batchStepScalar(batch, actions, events, done, first + count - done);
+}
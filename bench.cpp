@@ -0,0 +1,945 @@
+// Headless benchmarks for the level data paths. No window or GL needed.
+//
+//   ./bench pack [levels] [out.blxp]
+//       Level pack compression ratio and decode speed, optionally saving the
+//       generated pack
+//   ./bench import [levels]
+//       Text level import speed for 1..N threads and error reporting
+//   ./bench grid [size]
+//       Memory and scan speed of the int layout, byte grid and nibble-packed
+//       grid on one size x size level
+//   ./bench replay [sessions]
+//       Record random sessions as input logs and verify them on 1..N threads
+//   ./bench batch [games] [steps]
+//       Step many games at once with the batch simulator, checked against
+//       the rules, then scalar and gathered steps on 1..N threads
+//   ./bench envs [envs] [steps]
+//       reset()/step() over many environments with 9x9 observations on a
+//       pool of 1..N threads
+//   ./bench mesh [size]
+//       Platform triangles and build time, per-tile cubes against the
+//       culled and merged mesh, on the built-in levels and generated ones
+//   ./bench rewind [seconds]
+//       Record random play into the rewind history, check every kept tick
+//       and time seeks and rewinding
+//   ./bench undo
+//       Undo and redo a fall off every edge of the built-in levels
+#include "headers/batch.h"
+#include "headers/envpool.h"
+#include "headers/grid.h"
+#include "headers/levelfile.h"
+#include "headers/levels.h"
+#include "headers/levelpack.h"
+#include "headers/platformmesh.h"
+#include "headers/replay.h"
+#include "headers/rewind.h"
+#include "headers/sim.h"
+#include <atomic>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+typedef std::chrono::steady_clock Clock;
+
+static double secondsSince(Clock::time_point start) {
+  return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+// Small deterministic PRNG so every run generates the same levels
+static unsigned int nextRandom(unsigned int &state) {
+  state ^= state << 13;
+  state ^= state >> 17;
+  state ^= state << 5;
+  return state;
+}
+
+static int randomRange(unsigned int &state, int lo, int hi) {
+  return lo + (int)(nextRandom(state) % (unsigned int)(hi - lo + 1));
+}
+
+// Generate a level like the hand-made ones: rectangular islands of normal
+// tiles joined by corridors on an empty background, with a start, a goal,
+// some fragile tiles and a switch with its bridge.
+static void generateLevel(unsigned int seed, int rows, int cols,
+                          TileGrid &grid, SwitchDef *switchDef = NULL) {
+  unsigned int state = seed * 2654435761u + 1;
+  resizeGrid(grid, rows, cols);
+  memset(grid.tiles.data(), 0, grid.tiles.size());
+
+  int islands = 3 + (rows * cols) / 600;
+  int prevRow = -1, prevCol = -1;
+  for (int n = 0; n < islands; n++) {
+    int h = randomRange(state, 3, rows / 3 > 3 ? rows / 3 : 3);
+    int w = randomRange(state, 3, cols / 3 > 3 ? cols / 3 : 3);
+    int top = randomRange(state, 0, rows - h);
+    int left = randomRange(state, 0, cols - w);
+    for (int i = top; i < top + h; i++)
+      memset(grid.row(i) + left, 1, w);
+
+    // Corridor from the previous island (horizontal then vertical)
+    int row = top + h / 2, col = left + w / 2;
+    if (prevRow >= 0) {
+      for (int j = std::min(col, prevCol); j <= std::max(col, prevCol); j++)
+        grid.row(prevRow)[j] = 1;
+      for (int i = std::min(row, prevRow); i <= std::max(row, prevRow); i++)
+        grid.row(i)[col] = 1;
+    }
+    prevRow = row;
+    prevCol = col;
+  }
+
+  // Special tiles sprinkled over the occupied area
+  for (int n = 0; n < 4; n++) {
+    int i = randomRange(state, 0, rows - 1);
+    int j = randomRange(state, 0, cols - 2);
+    grid.row(i)[j] = 3;
+    grid.row(i)[j + 1] = 3;
+  }
+  int bridgeRow = randomRange(state, 0, rows - 1);
+  int bridgeCol = randomRange(state, 0, cols - 2);
+  grid.row(bridgeRow)[bridgeCol] = 4;
+  grid.row(bridgeRow)[bridgeCol + 1] = 4;
+  const unsigned char singles[3] = {5, 2, 9}; // Switch, goal, start
+  for (int n = 0; n < 3; n++) {
+    // Not over the bridge or another single, so the switch stays valid
+    int i, j;
+    do {
+      i = randomRange(state, 0, rows - 1);
+      j = randomRange(state, 0, cols - 1);
+    } while (grid.row(i)[j] == 4 || grid.row(i)[j] == 5 ||
+             grid.row(i)[j] == 2 || grid.row(i)[j] == 9);
+    grid.row(i)[j] = singles[n];
+    if (n == 0 && switchDef) {
+      switchDef->actionRow = i;
+      switchDef->actionCol = j;
+      switchDef->tiles.assign(1, std::make_pair(bridgeRow, bridgeCol));
+      switchDef->tiles.push_back(std::make_pair(bridgeRow, bridgeCol + 1));
+    }
+  }
+}
+
+static void levelSize(unsigned int seed, int &rows, int &cols) {
+  unsigned int state = seed * 40503u + 7;
+  rows = randomRange(state, 8, 128);
+  cols = randomRange(state, 8, 128);
+}
+
+static int benchPack(int levels, const char *outPath) {
+  printf("Level pack: %d generated levels\n", levels);
+
+  std::vector<unsigned char> pack;
+  beginLevelPack(pack);
+  TileGrid grid;
+  size_t rawBytes = 0;
+  Clock::time_point start = Clock::now();
+  for (int n = 0; n < levels; n++) {
+    int rows, cols;
+    levelSize(n, rows, cols);
+    generateLevel(n, rows, cols, grid);
+    rawBytes += grid.tiles.size();
+    appendPackedLevel(pack, grid);
+  }
+  double encodeSeconds = secondsSince(start);
+
+  // Decode every level row by row into one reused grid buffer
+  start = Clock::now();
+  size_t offset = LEVEL_PACK_HEADER_BYTES;
+  size_t decodedBytes = 0;
+  for (int n = 0; n < levels; n++) {
+    unpackLevel(pack, offset, grid);
+    decodedBytes += grid.tiles.size();
+  }
+  double decodeSeconds = secondsSince(start);
+
+  // Verify the round trip
+  TileGrid expected;
+  offset = LEVEL_PACK_HEADER_BYTES;
+  for (int n = 0; n < levels; n++) {
+    int rows, cols;
+    levelSize(n, rows, cols);
+    generateLevel(n, rows, cols, expected);
+    if (!unpackLevel(pack, offset, grid) || grid.rows != rows ||
+        grid.cols != cols || grid.tiles != expected.tiles) {
+      printf("  round trip FAILED at level %d\n", n);
+      return 1;
+    }
+  }
+
+  printf("  raw tiles     %.1f MB (1 byte/tile), %.1f MB as int layout\n",
+         rawBytes / 1e6, rawBytes * sizeof(int) / 1e6);
+  printf("  packed        %.2f MB, ratio %.1fx (%.1fx vs int layout)\n",
+         pack.size() / 1e6, (double)rawBytes / pack.size(),
+         (double)rawBytes * sizeof(int) / pack.size());
+  printf("  encode        %.2f s, %.2f GB/s\n", encodeSeconds,
+         rawBytes / encodeSeconds / 1e9);
+  printf("  decode        %.2f s, %.2f GB/s of tiles\n", decodeSeconds,
+         decodedBytes / decodeSeconds / 1e9);
+  printf("  round trip    ok\n");
+
+  if (outPath && saveLevelPack(outPath, pack))
+    printf("  saved         %s\n", outPath);
+  return 0;
+}
+
+// Write a level in the text format
+static void appendLevelText(std::string &out, int n, const TileGrid &grid,
+                            const SwitchDef &def) {
+  char line[96];
+  snprintf(line, sizeof(line), "@level Generated %d\n@switch %d %d :", n,
+           def.actionRow, def.actionCol);
+  out += line;
+  for (size_t t = 0; t < def.tiles.size(); t++) {
+    snprintf(line, sizeof(line), " %d %d", def.tiles[t].first,
+             def.tiles[t].second);
+    out += line;
+  }
+  out += '\n';
+  for (int r = 0; r < grid.rows; r++) {
+    for (int c = 0; c < grid.cols; c++)
+      out += (char)('0' + grid.row(r)[c]);
+    out += '\n';
+  }
+}
+
+static int benchImport(int levels) {
+  std::string text;
+  TileGrid grid;
+  SwitchDef def;
+  for (int n = 0; n < levels; n++) {
+    int rows, cols;
+    levelSize(n, rows, cols);
+    generateLevel(n, rows, cols, grid, &def);
+    appendLevelText(text, n, grid, def);
+  }
+  printf("Text import: %d levels, %.1f MB\n", levels, text.size() / 1e6);
+
+  std::vector<LevelData> parsed;
+  LevelParseError error;
+  int maxThreads = std::max(1u, std::thread::hardware_concurrency());
+  for (int threads = 1;; threads *= 2) {
+    if (threads > maxThreads)
+      threads = maxThreads;
+    double seconds = 0.0;
+    for (int run = 0; run < 3; run++) { // Best of three
+      Clock::time_point start = Clock::now();
+      bool ok =
+          parseLevelText(text.data(), text.size(), parsed, threads, error);
+      double elapsed = secondsSince(start);
+      if (!ok || (int)parsed.size() != levels) {
+        printf("  import FAILED: %s\n",
+               ok ? "wrong level count" : error.message.c_str());
+        return 1;
+      }
+      if (run == 0 || elapsed < seconds)
+        seconds = elapsed;
+    }
+    printf("  %2d threads    %.3f s, %.0f MB/s\n", threads, seconds,
+           text.size() / seconds / 1e6);
+    if (threads == maxThreads)
+      break;
+  }
+
+  // Parsed grids and switches must match what was generated
+  for (int n = 0; n < levels; n++) {
+    int rows, cols;
+    levelSize(n, rows, cols);
+    generateLevel(n, rows, cols, grid, &def);
+    const LevelData &level = parsed[n];
+    if (level.grid.rows != rows || level.grid.cols != cols ||
+        level.grid.tiles != grid.tiles || level.switches.size() != 1 ||
+        level.switches[0].tiles != def.tiles) {
+      printf("  verify FAILED at level %d\n", n);
+      return 1;
+    }
+  }
+  printf("  verify        ok\n");
+
+  // Corrupt one tile near the end and check the reported position
+  size_t bad = text.size() - 10;
+  while (text[bad] == '\n')
+    bad--;
+  size_t line = 1 + std::count(text.begin(), text.begin() + bad, '\n');
+  size_t column = bad - text.rfind('\n', bad - 1);
+  text[bad] = 'x';
+  Clock::time_point start = Clock::now();
+  bool ok = parseLevelText(text.data(), text.size(), parsed, maxThreads, error);
+  double seconds = secondsSince(start);
+  bool right = !ok && error.line == line && error.column == column;
+  printf("  bad tile      %s:%d:%d: %s (%.3f s) %s\n", "generated",
+         (int)error.line, (int)error.column, error.message.c_str(), seconds,
+         right ? "ok" : "WRONG POSITION");
+  return right ? 0 : 1;
+}
+
+// Scans over the vector-of-rows layout the game draws from, for comparison
+static size_t
+layoutCountNonEmpty(const std::vector<std::vector<int> > &layout) {
+  size_t count = 0;
+  for (size_t i = 0; i < layout.size(); i++)
+    for (size_t j = 0; j < layout[i].size(); j++)
+      count += layout[i][j] != 0;
+  return count;
+}
+
+static void layoutFindTiles(const std::vector<std::vector<int> > &layout,
+                            int type, std::vector<int> &cells) {
+  cells.clear();
+  for (size_t i = 0; i < layout.size(); i++)
+    for (size_t j = 0; j < layout[i].size(); j++)
+      if (layout[i][j] == type)
+        cells.push_back((int)(i * layout[i].size() + j));
+}
+
+static void layoutWalkableMask(const std::vector<std::vector<int> > &layout,
+                               std::vector<unsigned long long> &mask) {
+  int cols = layout.empty() ? 0 : (int)layout[0].size();
+  int words = walkableWordsPerRow(cols);
+  mask.assign(layout.size() * words, 0);
+  for (size_t i = 0; i < layout.size(); i++)
+    for (int j = 0; j < cols; j++)
+      if (layout[i][j] != 0)
+        mask[i * words + j / 64] |= 1ull << (j % 64);
+}
+
+// Best of three runs, in tiles per second
+template <typename Scan> static double scanRate(size_t tiles, Scan scan) {
+  double best = 0.0;
+  for (int run = 0; run < 3; run++) {
+    Clock::time_point start = Clock::now();
+    scan();
+    double seconds = secondsSince(start);
+    if (run == 0 || seconds < best)
+      best = seconds;
+  }
+  return tiles / best;
+}
+
+static int benchGrid(int size) {
+  // Tile generated 128 x 128 levels over the whole area
+  TileGrid grid, piece;
+  resizeGrid(grid, size, size);
+  for (int top = 0; top < size; top += 128) {
+    for (int left = 0; left < size; left += 128) {
+      int rows = std::min(128, size - top), cols = std::min(128, size - left);
+      generateLevel(top * 7919 + left, 128, 128, piece);
+      for (int i = 0; i < rows; i++)
+        memcpy(grid.row(top + i) + left, piece.row(i), cols);
+    }
+  }
+  std::vector<std::vector<int> > layout;
+  gridToLayout(grid, layout);
+  PackedTileGrid packed;
+  packGrid(grid, packed);
+  size_t tiles = grid.tiles.size();
+  printf("Tile grid: %d x %d, %.1f M tiles\n", size, size, tiles / 1e6);
+
+  size_t layoutBytes = layout.size() * (sizeof(layout[0]) + size * sizeof(int));
+  printf("  memory        int layout %.1f MB, bytes %.1f MB, packed %.1f MB\n",
+         layoutBytes / 1e6, grid.tiles.size() / 1e6,
+         packed.nibbles.size() / 1e6);
+
+  // Every representation must agree before timing them
+  TileGrid roundTrip;
+  unpackGrid(packed, roundTrip);
+  std::vector<int> cellsA, cellsB, cellsC;
+  std::vector<unsigned long long> maskA, maskB, maskC;
+  layoutFindTiles(layout, 3, cellsA);
+  findTiles(grid, 3, cellsB);
+  findTiles(packed, 3, cellsC);
+  layoutWalkableMask(layout, maskA);
+  walkableMask(grid, maskB);
+  walkableMask(packed, maskC);
+  size_t count = layoutCountNonEmpty(layout);
+  if (roundTrip.tiles != grid.tiles || countNonEmpty(grid) != count ||
+      countNonEmpty(packed) != count || cellsA != cellsB || cellsA != cellsC ||
+      maskA != maskB || maskA != maskC) {
+    printf("  verify FAILED\n");
+    return 1;
+  }
+  printf("  verify        ok (%zu non-empty, %zu fragile)\n", count,
+         cellsA.size());
+
+  volatile size_t sink = 0;
+  printf("  %-12s  %10s %10s %10s  (G tiles/s)\n", "", "int layout", "bytes",
+         "packed");
+  printf("  %-12s  %10.2f %10.2f %10.2f\n", "count",
+         scanRate(tiles, [&] { sink = layoutCountNonEmpty(layout); }) / 1e9,
+         scanRate(tiles, [&] { sink = countNonEmpty(grid); }) / 1e9,
+         scanRate(tiles, [&] { sink = countNonEmpty(packed); }) / 1e9);
+  printf("  %-12s  %10.2f %10.2f %10.2f\n", "find",
+         scanRate(tiles, [&] { layoutFindTiles(layout, 3, cellsA); }) / 1e9,
+         scanRate(tiles, [&] { findTiles(grid, 3, cellsA); }) / 1e9,
+         scanRate(tiles, [&] { findTiles(packed, 3, cellsA); }) / 1e9);
+  printf("  %-12s  %10.2f %10.2f %10.2f\n", "walkable",
+         scanRate(tiles, [&] { layoutWalkableMask(layout, maskA); }) / 1e9,
+         scanRate(tiles, [&] { walkableMask(grid, maskA); }) / 1e9,
+         scanRate(tiles, [&] { walkableMask(packed, maskA); }) / 1e9);
+  (void)sink;
+  return 0;
+}
+
+// Random play on one level, logging every applied input
+static void recordSession(unsigned int seed, SimState &sim, InputLog &log) {
+  unsigned int state = seed * 2246822519u + 3;
+  int moves = randomRange(state, 200, 5000);
+  beginInputLog(log, "generated", -1, sim);
+  while (moves > 0) {
+    SimInput input = INPUT_NONE;
+    if (simIdle(sim)) {
+      input = sim.won ? INPUT_RESET
+                      : (SimInput)(INPUT_LEFT + nextRandom(state) % 4);
+      // Players pause between moves now and then
+      if (nextRandom(state) % 8 == 0)
+        input = INPUT_NONE;
+    }
+    unsigned int tick = sim.tick;
+    if (simStep(sim, input)) {
+      logInput(log, tick, input);
+      moves--;
+    }
+  }
+  endInputLog(log, sim);
+}
+
+static int benchReplay(int sessions) {
+  // Sessions share a set of generated levels, as players share real ones
+  const int LEVELS = 100;
+  std::vector<SimState> levels(LEVELS);
+  TileGrid grid;
+  SwitchDef def;
+  std::vector<std::vector<int> > layout;
+  for (int n = 0; n < LEVELS; n++) {
+    int rows, cols;
+    levelSize(n, rows, cols);
+    generateLevel(n, rows, cols, grid, &def);
+    gridToLayout(grid, layout);
+    simLoadLevel(levels[n], layout, std::vector<SwitchDef>(1, def));
+  }
+
+  std::vector<std::vector<unsigned char> > logs(sessions);
+  size_t logBytes = 0;
+  long long inputs = 0;
+  for (int n = 0; n < sessions; n++) {
+    SimState sim = levels[n % LEVELS];
+    InputLog log;
+    recordSession(n, sim, log);
+    encodeInputLog(log, logs[n]);
+    logBytes += logs[n].size();
+    for (size_t e = 0; e < log.events.size(); e++)
+      inputs += !(log.events[e] & 0x80); // Last byte of each varint
+  }
+  printf("Replay: %d sessions, %lld inputs, %.2f MB of logs (%.2f bytes per "
+         "input)\n",
+         sessions, inputs, logBytes / 1e6, (double)logBytes / inputs);
+
+  // Workers take sessions off a shared counter
+  int maxThreads = std::max(1u, std::thread::hardware_concurrency());
+  for (int threads = 1;; threads *= 2) {
+    if (threads > maxThreads)
+      threads = maxThreads;
+    std::atomic<int> next(0), failed(0);
+    Clock::time_point start = Clock::now();
+    std::vector<std::thread> workers;
+    for (int t = 0; t < threads; t++) {
+      workers.push_back(std::thread([&] {
+        for (int n; (n = next++) < sessions;) {
+          InputLog log;
+          SimState sim = levels[n % LEVELS];
+          long long moves;
+          if (!decodeInputLog(logs[n].data(), logs[n].size(), log) ||
+              !replayInputLog(log, sim, moves))
+            failed++;
+        }
+      }));
+    }
+    for (int t = 0; t < threads; t++)
+      workers[t].join();
+    double seconds = secondsSince(start);
+    if (failed) {
+      printf("  verify FAILED for %d sessions\n", (int)failed);
+      return 1;
+    }
+    printf("  %2d threads    %.3f s, %.2f M inputs/s\n", threads, seconds,
+           inputs / seconds / 1e6);
+    if (threads == maxThreads)
+      break;
+  }
+
+  // A changed input must be caught
+  InputLog log;
+  decodeInputLog(logs[0].data(), logs[0].size(), log);
+  log.events[log.events.size() / 2] ^= 1;
+  SimState sim = levels[0];
+  long long moves;
+  bool caught = !replayInputLog(log, sim, moves);
+  printf("  tampered log  %s\n", caught ? "rejected" : "NOT DETECTED");
+  return caught ? 0 : 1;
+}
+
+// What one batch step does to a game, played out tick by tick on the rules
+static void referenceStep(SimState &sim, SimInput input) {
+  simStep(sim, input);
+  while (!simIdle(sim))
+    simStep(sim, INPUT_NONE);
+  if (sim.won)
+    simStep(sim, INPUT_RESET);
+}
+
+// Mostly moves, with some waits and restarts
+static unsigned char randomAction(unsigned int &state) {
+  unsigned int r = nextRandom(state) % 64;
+  if (r == 0)
+    return INPUT_RESET;
+  return r < 4 ? (unsigned char)INPUT_NONE
+               : (unsigned char)(INPUT_LEFT + r % 4);
+}
+
+// Every game of a batch must match its own SimState after every step. With
+// a solution, every fourth game plays it over and over.
+static bool checkBatch(const SimState &level, int games, int steps,
+                       unsigned int seed, const char *solution,
+                       long long counts[3]) {
+  BatchSim batch, gathered;
+  if (!batchLoadLevel(batch, level, games))
+    return false;
+  gathered = batch;
+  std::vector<SimState> sims(games, level);
+  std::vector<unsigned char> actions(games), events(games), expected(games);
+  for (int s = 0; s < steps; s++) {
+    for (int g = 0; g < games; g++) {
+      actions[g] = randomAction(seed);
+      if (solution && g % 4 == 0) {
+        char move = solution[s % strlen(solution)];
+        actions[g] = INPUT_LEFT + (strchr("LRUD", move) - "LRUD");
+      }
+    }
+    batchStepScalar(batch, actions.data(), expected.data(), 0, games);
+    batchStep(gathered, actions.data(), events.data(), 0, games);
+    for (int g = 0; g < games; g++) {
+      counts[events[g]]++;
+      SimState &sim = sims[g];
+      referenceStep(sim, (SimInput)actions[g]);
+      unsigned int mask = 0;
+      for (size_t t = 0; t < sim.toggleGroups.size(); t++)
+        mask |= (unsigned int)sim.toggleGroups[t].visible << t;
+      if (batchRow(batch, g) != sim.block.row ||
+          batchCol(batch, g) != sim.block.col ||
+          batchOrientation(batch, g) != sim.block.orientation ||
+          batch.mask[g] != mask || batch.ticks[g] != sim.tick ||
+          gathered.state[g] != batch.state[g] ||
+          gathered.mask[g] != batch.mask[g] ||
+          gathered.ticks[g] != batch.ticks[g] || events[g] != expected[g]) {
+        printf("  game %d differs from the rules at step %d\n", g, s);
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+static int benchBatch(int games, int steps) {
+  games = (games + 7) & ~7;
+  SimState level;
+  simLoadLevel(level, getLevelLayout(3), std::vector<SwitchDef>());
+
+  // Built-in level 3 and generated ones with a switch each
+  long long counts[3] = {0, 0, 0};
+  bool same = checkBatch(level, 256, 500, 1, "URDRRRRUDRRRUURDLU", counts);
+  TileGrid grid;
+  SwitchDef def;
+  std::vector<std::vector<int> > layout;
+  for (int n = 0; n < 20 && same; n++) {
+    int rows, cols;
+    levelSize(n, rows, cols);
+    generateLevel(n, rows, cols, grid, &def);
+    gridToLayout(grid, layout);
+    SimState generated;
+    simLoadLevel(generated, layout, std::vector<SwitchDef>(1, def));
+    same = checkBatch(generated, 64, 300, n + 2, NULL, counts);
+  }
+  printf("Batch: %d games of level 3, %d steps (each a whole move)\n", games,
+         steps);
+  printf("  against rules %s (%lld steps, %lld falls, %lld wins)\n",
+         same ? "identical" : "MISMATCH", counts[0] + counts[1] + counts[2],
+         counts[BATCH_FELL], counts[BATCH_WON]);
+  if (!same)
+    return 1;
+
+  // A few pages of random actions, cycled through
+  const int PAGES = 16;
+  std::vector<std::vector<unsigned char> > actions(
+      PAGES, std::vector<unsigned char>(games));
+  unsigned int seed = 99;
+  for (int p = 0; p < PAGES; p++)
+    for (int g = 0; g < games; g++)
+      actions[p][g] = randomAction(seed);
+  std::vector<unsigned char> events(games);
+
+  BatchSim batch;
+  batchLoadLevel(batch, level, games);
+  double total = (double)games * steps;
+  Clock::time_point start = Clock::now();
+  for (int s = 0; s < steps; s++)
+    batchStepScalar(batch, actions[s % PAGES].data(), events.data(), 0, games);
+  double seconds = secondsSince(start);
+  printf("  scalar         1 thread   %.3f s, %.1f M steps/s\n", seconds,
+         total / seconds / 1e6);
+
+  // Each thread steps its own slice of the games
+  int maxThreads = std::max(1u, std::thread::hardware_concurrency());
+  for (int threads = 1;; threads *= 2) {
+    if (threads > maxThreads)
+      threads = maxThreads;
+    batchReset(batch);
+    start = Clock::now();
+    std::vector<std::thread> workers;
+    for (int t = 0; t < threads; t++) {
+      int first = (int)((long long)games * t / threads) & ~7;
+      int end = t + 1 == threads
+                    ? games
+                    : (int)((long long)games * (t + 1) / threads) & ~7;
+      workers.push_back(std::thread([&, first, end] {
+        for (int s = 0; s < steps; s++)
+          batchStep(batch, actions[s % PAGES].data(), events.data(), first,
+                    end - first);
+      }));
+    }
+    for (int t = 0; t < threads; t++)
+      workers[t].join();
+    seconds = secondsSince(start);
+    printf("  batch      %2d threads   %.3f s, %.1f M steps/s\n", threads,
+           seconds, total / seconds / 1e6);
+    if (threads == maxThreads)
+      break;
+  }
+  long long ticks = 0;
+  for (int g = 0; g < games; g++)
+    ticks += batch.ticks[g];
+  printf("  %.0f game ticks per step on average (%.1f s of play)\n",
+         (double)ticks / total, ticks * SIM_TICK_SECONDS / total);
+  return 0;
+}
+
+// The window an environment should see, drawn from its SimState
+static bool sameObservation(const SimState &sim, const unsigned char *obs,
+                            int window) {
+  int row2, col2;
+  simSecondCell(sim.block, row2, col2);
+  for (int i = 0; i < window; i++) {
+    for (int j = 0; j < window; j++) {
+      int row = sim.block.row - window / 2 + i;
+      int col = sim.block.col - window / 2 + j;
+      bool under = (row == sim.block.row && col == sim.block.col) ||
+                   (row == row2 && col == col2);
+      if (obs[i * window + j] !=
+          (simTileAt(sim, row, col) | (under ? ENV_OBS_BLOCK : 0)))
+        return false;
+    }
+  }
+  return true;
+}
+
+static int benchEnvs(int envs, int steps) {
+  const int WINDOW = 9;
+  SimState level;
+  simLoadLevel(level, getLevelLayout(3), std::vector<SwitchDef>());
+
+  // Observations and rewards against one SimState per environment; an
+  // ended episode restarts the level. Three uneven shards.
+  {
+    const int CHECK = 64;
+    EnvPool pool;
+    envPoolCreate(pool, level, CHECK, WINDOW, 3, 50);
+    std::vector<SimState> sims(CHECK, level);
+    std::vector<unsigned char> actions(CHECK);
+    unsigned int seed = 5;
+    int bad = 0, episodes = 0;
+    for (int s = 0; s < 2000 && !bad; s++) {
+      for (int e = 0; e < CHECK; e++) {
+        actions[e] = randomAction(seed);
+        if (e % 4 == 0) {
+          char move = "URDRRRRUDRRRUURDLU"[s % 18];
+          actions[e] = INPUT_LEFT + (strchr("LRUD", move) - "LRUD");
+        }
+      }
+      envPoolStep(pool, actions.data());
+      for (int e = 0; e < CHECK; e++) {
+        SimState &sim = sims[e];
+        // A win costs the roll and a restart tick, a fall the roll and the
+        // drop
+        unsigned int tick = sim.tick;
+        referenceStep(sim, (SimInput)actions[e]);
+        bool fell = sim.tick - tick > BLOCK_ANIMATION_TICKS + 1;
+        bool won = sim.tick - tick == BLOCK_ANIMATION_TICKS + 1;
+        float reward = ENV_REWARD_STEP + (won    ? ENV_REWARD_WIN
+                                          : fell ? ENV_REWARD_FALL
+                                                 : 0.0f);
+        if (pool.dones[e]) {
+          simStep(sim, INPUT_RESET);
+          episodes++;
+        }
+        if (pool.rewards[e] != reward || (pool.dones[e] == ENV_TERMINATED) !=
+                                             (won || fell) ||
+            !sameObservation(sim, envObservation(pool, e), WINDOW))
+          bad++;
+      }
+    }
+    envPoolDestroy(pool);
+    printf("Envs: level 3, %dx%d observations\n", WINDOW, WINDOW);
+    printf("  against rules %s (%d episodes)\n", bad ? "MISMATCH" : "identical",
+           episodes);
+    if (bad)
+      return 1;
+  }
+
+  const int PAGES = 16;
+  std::vector<std::vector<unsigned char> > actions(
+      PAGES, std::vector<unsigned char>(envs));
+  unsigned int seed = 99;
+  for (int p = 0; p < PAGES; p++)
+    for (int e = 0; e < envs; e++)
+      actions[p][e] = randomAction(seed);
+
+  printf("  %d environments, %d steps\n", envs, steps);
+  int maxThreads = std::max(1u, std::thread::hardware_concurrency());
+  for (int threads = 1;; threads *= 2) {
+    if (threads > maxThreads)
+      threads = maxThreads;
+    EnvPool pool;
+    envPoolCreate(pool, level, envs, WINDOW, threads, 200);
+    Clock::time_point start = Clock::now();
+    double reward = 0.0;
+    for (int s = 0; s < steps; s++) {
+      envPoolStep(pool, actions[s % PAGES].data());
+      reward += pool.rewards[s % envs];
+    }
+    double seconds = secondsSince(start);
+    envPoolDestroy(pool);
+    printf("  %2d threads    %.3f s, %.1f M env steps/s\n", threads, seconds,
+           (double)envs * steps / seconds / 1e6);
+    (void)reward;
+    if (threads == maxThreads)
+      break;
+  }
+  return 0;
+}
+
+// Triangles as drawn before culling (a whole cube per tile) and after
+static void meshRow(const char *name, const SimState &level, double &worst) {
+  PlatformMesh mesh;
+  // The game's light; the counts do not depend on it
+  MeshLight light = {
+      {4.0f, 11.2f, 3.1f}, {0.4f, 0.4f, 0.48f}, {0.8f, 0.8f, 1.0f}};
+  Clock::time_point start = Clock::now();
+  meshBuild(mesh, level, light);
+  double ms = secondsSince(start) * 1000.0;
+  long long before = 12LL * level.tileCount;
+  long long after = 0;
+  for (size_t c = 0; c < mesh.chunks.size(); c++)
+    after += mesh.chunks[c].faces.size() / 2; // 2 triangles per 4-vertex quad
+  double ratio = (double)before / after;
+  worst = std::min(worst, ratio);
+  printf("  %-16s %9d %11lld %11lld %7.1fx %9.2f\n", name, level.tileCount,
+         before, after, ratio, ms);
+}
+
+static int benchMesh(int size) {
+  printf("Platform mesh\n");
+  printf("  %-16s %9s %11s %11s %8s %9s\n", "level", "tiles", "cube tris",
+         "mesh tris", "fewer", "build ms");
+  double worst = 1e9;
+  SimState level;
+  char name[32];
+  for (int n = 1; n <= 3; n++) {
+    simLoadLevel(level, getLevelLayout(n), std::vector<SwitchDef>());
+    snprintf(name, sizeof(name), "level %d", n);
+    meshRow(name, level, worst);
+  }
+  TileGrid grid;
+  SwitchDef def;
+  std::vector<std::vector<int> > layout;
+  for (int n = 0; n < 4; n++) {
+    int rows, cols;
+    levelSize(n, rows, cols);
+    generateLevel(n, rows, cols, grid, &def);
+    gridToLayout(grid, layout);
+    simLoadLevel(level, layout, std::vector<SwitchDef>(1, def));
+    snprintf(name, sizeof(name), "generated %dx%d", rows, cols);
+    meshRow(name, level, worst);
+  }
+  generateLevel(99, size, size, grid, &def);
+  gridToLayout(grid, layout);
+  simLoadLevel(level, layout, std::vector<SwitchDef>(1, def));
+  snprintf(name, sizeof(name), "generated %dx%d", size, size);
+  meshRow(name, level, worst);
+  printf("  at least %.1fx fewer triangles\n", worst);
+  return 0;
+}
+
+static int benchRewind(double seconds) {
+  SimState sim;
+  simLoadLevel(sim, getLevelLayout(3), std::vector<SwitchDef>());
+  RewindHistory history;
+  rewindInit(history, seconds);
+
+  // Twice as long as the history keeps, so the ring wraps. Players move
+  // the camera now and then.
+  int ticks = (int)(2 * seconds / SIM_TICK_SECONDS);
+  std::vector<std::vector<int> > frames(ticks + 1);
+  float camera[3] = {30.0f, -45.0f, 15.0f};
+  unsigned int seed = 17;
+  Clock::time_point start = Clock::now();
+  rewindCapture(sim, camera, frames[0]);
+  rewindRecord(history, sim.tick, frames[0]);
+  for (int t = 1; t <= ticks; t++) {
+    SimInput input = INPUT_NONE;
+    if (simIdle(sim) && nextRandom(seed) % 4 == 0)
+      input = sim.won ? INPUT_RESET : (SimInput)randomAction(seed);
+    if (nextRandom(seed) % 64 == 0)
+      camera[nextRandom(seed) % 2] += nextRandom(seed) % 2 ? 5.0f : -5.0f;
+    simStep(sim, input);
+    rewindCapture(sim, camera, frames[t]);
+    rewindRecord(history, sim.tick, frames[t]);
+  }
+  double recordSeconds = secondsSince(start);
+  unsigned int kept = rewindTicks(history);
+  printf("Rewind: %.0f s kept, level 3 with random play\n", seconds);
+  printf("  %u ticks in %.1f KB (%.2f bytes per tick), record %.0f ns per "
+         "tick\n",
+         kept, rewindBytes(history) / 1024.0,
+         (double)rewindBytes(history) / kept, recordSeconds / ticks * 1e9);
+
+  // Every kept tick must decode to what was recorded
+  std::vector<int> fields;
+  int bad = 0;
+  for (unsigned int t = sim.tick - kept + 1; t <= sim.tick; t++)
+    bad += !rewindSeek(history, t, fields) || fields != frames[t];
+  start = Clock::now();
+  for (int n = 0; n < 100000; n++)
+    rewindSeek(history, sim.tick - nextRandom(seed) % kept, fields);
+  printf("  seek %s, %.0f ns per random seek\n", bad ? "MISMATCH" : "exact",
+         secondsSince(start) / 100000 * 1e9);
+
+  // Rewinding all the way back restores each tick in turn, level included
+  SimState rewound = sim;
+  unsigned int tick;
+  int steps = 0;
+  start = Clock::now();
+  while (rewindPop(history, fields, tick)) {
+    std::vector<int> check;
+    rewindRestore(rewound, camera, fields);
+    rewindCapture(rewound, camera, check);
+    bad += fields != frames[tick] || check != fields;
+    steps++;
+  }
+  printf("  rewind %d ticks %s, %.0f ns per tick\n", steps,
+         bad ? "MISMATCH" : "exact", secondsSince(start) / steps * 1e9);
+  return bad ? 1 : 0;
+}
+
+static bool sameBlock(const Block &a, const Block &b) {
+  return a.row == b.row && a.col == b.col && a.orientation == b.orientation;
+}
+
+// Every roll that falls, from every cell and orientation of the built-in
+// levels, must undo back to where it started and redo into the same fall
+static int benchUndo() {
+  printf("Undo and redo of falls\n");
+  int falls = 0, bad = 0;
+  for (int n = 1; n <= 3; n++) {
+    SimState level;
+    simLoadLevel(level, getLevelLayout(n), std::vector<SwitchDef>());
+    int edges[4] = {0, 0, 0, 0};
+    for (int row = 0; row < level.rows; row++) {
+      for (int col = 0; col < level.cols; col++) {
+        for (int o = STANDING; o <= LYING_Z; o++) {
+          for (int d = 0; d < 4; d++) {
+            SimState sim = level;
+            sim.block.row = sim.block.fromRow = row;
+            sim.block.col = sim.block.fromCol = col;
+            sim.block.orientation = sim.block.fromOrientation =
+                (BlockOrientation)o;
+            if (simBlockShouldFall(sim))
+              continue;
+            Block start = sim.block;
+            simStep(sim, (SimInput)(INPUT_LEFT + d));
+            while (sim.block.isAnimating)
+              simStep(sim, INPUT_NONE);
+            if (!sim.block.isFalling)
+              continue;
+            Block landed = sim.block;
+            falls++;
+            int row2, col2;
+            simSecondCell(landed, row2, col2);
+            edges[d] += landed.row < 0 || landed.col < 0 ||
+                        row2 >= level.rows || col2 >= level.cols;
+            bool ok = simStep(sim, INPUT_UNDO) &&
+                      sameBlock(sim.block, start) && !sim.block.isFalling;
+            ok = ok && simStep(sim, INPUT_REDO) &&
+                 sameBlock(sim.block, landed) && sim.block.isFalling;
+            ok = ok && simStep(sim, INPUT_UNDO) &&
+                 sameBlock(sim.block, start);
+            if (!ok) {
+              printf("  level %d: row %d col %d %d input %d MISMATCH\n", n,
+                     row, col, o, INPUT_LEFT + d);
+              bad++;
+            }
+          }
+        }
+      }
+    }
+    printf("  level %d: off the grid left %d, right %d, up %d, down %d\n", n,
+           edges[0], edges[1], edges[2], edges[3]);
+  }
+  printf("  %d falls %s\n", falls, bad ? "MISMATCH" : "undone and redone");
+  return bad || falls == 0 ? 1 : 0;
+}
+
+int main(int argc, char **argv) {
+  const char *mode = argc > 1 ? argv[1] : "";
+  if (strcmp(mode, "pack") == 0) {
+    return benchPack(argc > 2 ? atoi(argv[2]) : 100000,
+                     argc > 3 ? argv[3] : NULL);
+  }
+  if (strcmp(mode, "import") == 0) {
+    return benchImport(argc > 2 ? atoi(argv[2]) : 60000);
+  }
+  if (strcmp(mode, "grid") == 0) {
+    return benchGrid(argc > 2 ? atoi(argv[2]) : 8192);
+  }
+  if (strcmp(mode, "replay") == 0) {
+    return benchReplay(argc > 2 ? atoi(argv[2]) : 5000);
+  }
+  if (strcmp(mode, "batch") == 0) {
+    return benchBatch(argc > 2 ? atoi(argv[2]) : 65536,
+                      argc > 3 ? atoi(argv[3]) : 2000);
+  }
+  if (strcmp(mode, "envs") == 0) {
+    return benchEnvs(argc > 2 ? atoi(argv[2]) : 16384,
+                     argc > 3 ? atoi(argv[3]) : 500);
+  }
+  if (strcmp(mode, "mesh") == 0) {
+    return benchMesh(argc > 2 ? atoi(argv[2]) : 1000);
+  }
+  if (strcmp(mode, "rewind") == 0) {
+    return benchRewind(argc > 2 ? atof(argv[2]) : 60.0);
+  }
+  if (strcmp(mode, "undo") == 0) {
+    return benchUndo();
+  }
+  printf("Usage: %s pack [levels] [out.blxp]\n", argv[0]);
+  printf("       %s import [levels]\n", argv[0]);
+  printf("       %s grid [size]\n", argv[0]);
+  printf("       %s replay [sessions]\n", argv[0]);
+  printf("       %s batch [games] [steps]\n", argv[0]);
+  printf("       %s envs [envs] [steps]\n", argv[0]);
+  printf("       %s mesh [size]\n", argv[0]);
+  printf("       %s rewind [seconds]\n", argv[0]);
+  printf("       %s undo\n", argv[0]);
+  return 1;
+}
@@ -0,0 +1,171 @@
+#include "headers/envpool.h"
+#include <algorithm>
+#include <cstring>
+
+// Draw one environment's window: rows of the padded level, then the visible
+// bridges and the block on top
+static void observe(EnvPool &pool, int env) {
+  const BatchSim &batch = pool.batch;
+  const int window = pool.window;
+  unsigned char *obs = &pool.observations[(size_t)env * window * window];
+  int row = batchRow(batch, env), col = batchCol(batch, env);
+  int top = row - window / 2, left = col - window / 2;
+  for (int i = 0; i < window; i++)
+    memcpy(obs + i * window,
+           &pool.padded[(size_t)(top + i + pool.pad) * pool.paddedCols +
+                        left + pool.pad],
+           window);
+
+  for (unsigned int mask = batch.mask[env]; mask; mask &= mask - 1) {
+    const std::vector<std::pair<int, int> > &tiles =
+        pool.groupTiles[__builtin_ctz(mask)];
+    for (size_t t = 0; t < tiles.size(); t++) {
+      unsigned int i = tiles[t].first - top, j = tiles[t].second - left;
+      if (i < (unsigned int)window && j < (unsigned int)window)
+        obs[i * window + j] = 4;
+    }
+  }
+
+  Block block;
+  block.row = row;
+  block.col = col;
+  block.orientation = batchOrientation(batch, env);
+  int row2, col2;
+  simSecondCell(block, row2, col2);
+  obs[(window / 2) * window + window / 2] |= ENV_OBS_BLOCK;
+  obs[(row2 - top) * window + col2 - left] |= ENV_OBS_BLOCK;
+}
+
+static void restart(EnvPool &pool, int env) {
+  pool.batch.state[env] = pool.batch.startState;
+  pool.batch.mask[env] = 0;
+  pool.episodeSteps[env] = 0;
+}
+
+// Step (or reset) this shard's environments
+static void runShard(EnvPool &pool, int shard) {
+  int shards = pool.workers.size() + 1;
+  // Shards start on multiples of 8 for the batch step's gathers
+  int first = (int)((long long)pool.count * shard / shards) & ~7;
+  int end = shard + 1 == shards
+                ? pool.count
+                : (int)((long long)pool.count * (shard + 1) / shards) & ~7;
+  if (!pool.actions) {
+    for (int env = first; env < end; env++) {
+      restart(pool, env);
+      pool.rewards[env] = 0.0f;
+      pool.dones[env] = ENV_RUNNING;
+      observe(pool, env);
+    }
+    return;
+  }
+
+  batchStep(pool.batch, pool.actions, pool.events.data(), first, end - first);
+  for (int env = first; env < end; env++) {
+    unsigned char event = pool.events[env];
+    pool.rewards[env] = ENV_REWARD_STEP +
+                        (event == BATCH_WON    ? ENV_REWARD_WIN
+                         : event == BATCH_FELL ? ENV_REWARD_FALL
+                                               : 0.0f);
+    pool.dones[env] = event != BATCH_NONE ? ENV_TERMINATED : ENV_RUNNING;
+    if (++pool.episodeSteps[env] >= pool.maxSteps && pool.maxSteps > 0 &&
+        !pool.dones[env])
+      pool.dones[env] = ENV_TRUNCATED;
+    if (pool.dones[env])
+      restart(pool, env);
+    observe(pool, env);
+  }
+}
+
+static void workerLoop(EnvPool *pool, int shard) {
+  unsigned int seen = 0;
+  for (;;) {
+    {
+      std::unique_lock<std::mutex> lock(pool->mutex);
+      pool->wake.wait(lock,
+                      [&] { return pool->quit || pool->generation != seen; });
+      if (pool->quit)
+        return;
+      seen = pool->generation;
+    }
+    runShard(*pool, shard);
+    std::lock_guard<std::mutex> lock(pool->mutex);
+    if (--pool->pending == 0)
+      pool->finished.notify_one();
+  }
+}
+
+// Run every shard and wait for all of them
+static void runAll(EnvPool &pool, const unsigned char *actions) {
+  {
+    std::lock_guard<std::mutex> lock(pool.mutex);
+    pool.actions = actions;
+    pool.pending = pool.workers.size();
+    pool.generation++;
+  }
+  pool.wake.notify_all();
+  runShard(pool, 0);
+  std::unique_lock<std::mutex> lock(pool.mutex);
+  pool.finished.wait(lock, [&] { return pool.pending == 0; });
+}
+
+bool envPoolCreate(EnvPool &pool, const SimState &level, int envs, int window,
+                   int threads, int maxSteps) {
+  if (!batchLoadLevel(pool.batch, level, envs))
+    return false;
+  pool.count = envs;
+  pool.window = std::max(3, window | 1); // Room for a lying block
+  pool.maxSteps = maxSteps;
+
+  pool.pad = pool.window / 2;
+  pool.paddedCols = level.cols + 2 * pool.pad;
+  pool.padded.assign((size_t)(level.rows + 2 * pool.pad) * pool.paddedCols, 0);
+  for (int i = 0; i < level.rows; i++)
+    for (int j = 0; j < level.cols; j++)
+      pool.padded[(size_t)(i + pool.pad) * pool.paddedCols + j + pool.pad] =
+          level.layout[i][j];
+  pool.groupTiles.clear();
+  for (size_t g = 0; g < level.toggleGroups.size(); g++) {
+    pool.groupTiles.push_back(level.toggleGroups[g].tiles);
+    for (size_t t = 0; t < level.toggleGroups[g].tiles.size(); t++) {
+      const std::pair<int, int> &tile = level.toggleGroups[g].tiles[t];
+      pool.padded[(size_t)(tile.first + pool.pad) * pool.paddedCols +
+                  tile.second + pool.pad] = 0;
+    }
+  }
+
+  pool.observations.assign((size_t)envs * pool.window * pool.window, 0);
+  pool.rewards.assign(envs, 0.0f);
+  pool.dones.assign(envs, ENV_RUNNING);
+  pool.events.assign(envs, BATCH_NONE);
+  pool.episodeSteps.assign(envs, 0);
+
+  if (threads <= 0)
+    threads = std::max(1u, std::thread::hardware_concurrency());
+  threads = std::max(1, std::min(threads, (envs + 7) / 8));
+  pool.actions = NULL;
+  pool.generation = 0;
+  pool.pending = 0;
+  pool.quit = false;
+  for (int t = 1; t < threads; t++)
+    pool.workers.push_back(std::thread(workerLoop, &pool, t));
+  envPoolReset(pool);
+  return true;
+}
+
+void envPoolDestroy(EnvPool &pool) {
+  {
+    std::lock_guard<std::mutex> lock(pool.mutex);
+    pool.quit = true;
+  }
+  pool.wake.notify_all();
+  for (size_t t = 0; t < pool.workers.size(); t++)
+    pool.workers[t].join();
+  pool.workers.clear();
+}
+
+void envPoolReset(EnvPool &pool) { runAll(pool, NULL); }
+
+void envPoolStep(EnvPool &pool, const unsigned char *actions) {
+  runAll(pool, actions);
+}
@@ -0,0 +1,117 @@
+#include "headers/frameclock.h"
+#include <algorithm>
+#include <cstdio>
+#include <thread>
+
+typedef std::chrono::steady_clock Clock;
+
+static std::chrono::nanoseconds interval(const FrameClock &clock) {
+  return std::chrono::nanoseconds((long long)(clock.intervalMs * 1e6));
+}
+
+void frameClockInit(FrameClock &clock, double hz) {
+  clock.intervalMs = hz > 0.0 ? 1000.0 / hz : 0.0;
+  clock.nextDue = clock.lastUpdate = clock.lastPresent = Clock::now();
+  clock.presented = false;
+  clock.resyncs = 0;
+  clock.frames = 0;
+  clock.frameMsSum = 0.0;
+  clock.frameMsMax = 0.0f;
+  clock.idle = false;
+  clock.idleSeconds = clock.idleCpuSeconds = 0.0;
+  clock.idleFrames = 0;
+}
+
+double frameClockUpdate(FrameClock &clock) {
+  FrameTime now = Clock::now();
+  double seconds =
+      std::chrono::duration<double>(now - clock.lastUpdate).count();
+  clock.lastUpdate = now;
+  return std::min(seconds, MAX_FRAME_SECONDS);
+}
+
+int frameClockNextDelayMs(FrameClock &clock) {
+  FrameTime now = Clock::now();
+  if (clock.intervalMs <= 0.0) {
+    clock.nextDue = now;
+    return 0;
+  }
+  clock.nextDue += std::chrono::duration_cast<Clock::duration>(interval(clock));
+  if (now - clock.nextDue > interval(clock)) {
+    clock.nextDue = now;
+    clock.resyncs++;
+  }
+  if (clock.nextDue <= now)
+    return 0;
+  return (int)std::chrono::duration_cast<std::chrono::milliseconds>(
+             clock.nextDue - now)
+      .count();
+}
+
+void frameClockWaitForDue(const FrameClock &clock) {
+  if (clock.intervalMs > 0.0)
+    std::this_thread::sleep_until(clock.nextDue);
+}
+
+void frameClockPresented(FrameClock &clock) {
+  FrameTime now = Clock::now();
+  if (clock.idle)
+    clock.idleFrames++;
+  else if (clock.presented) {
+    float ms = std::chrono::duration<float, std::milli>(now - clock.lastPresent)
+                   .count();
+    clock.frameMs[clock.frames++ % FRAME_SAMPLES] = ms;
+    clock.frameMsSum += ms;
+    clock.frameMsMax = std::max(clock.frameMsMax, ms);
+  }
+  clock.lastPresent = now;
+  clock.presented = true;
+}
+
+void frameClockSetIdle(FrameClock &clock, bool idle) {
+  if (idle == clock.idle)
+    return;
+  clock.idle = idle;
+  if (idle) {
+    clock.idleSince = Clock::now();
+    clock.idleCpuStart = std::clock();
+  } else {
+    clock.idleSeconds +=
+        std::chrono::duration<double>(Clock::now() - clock.idleSince).count();
+    clock.idleCpuSeconds +=
+        (double)(std::clock() - clock.idleCpuStart) / CLOCKS_PER_SEC;
+  }
+}
+
+int frameClockIdleDelayMs(FrameClock &clock, int ms) {
+  clock.nextDue = Clock::now() + std::chrono::milliseconds(ms);
+  clock.presented = false; // The gap is not a frame time
+  return ms;
+}
+
+void frameClockWake(FrameClock &clock) {
+  clock.nextDue = Clock::now();
+  clock.presented = false;
+}
+
+void printFrameStats(const FrameClock &clock) {
+  FrameClock total = clock;
+  frameClockSetIdle(total, false); // Count an idle span still open
+  if (total.idleSeconds > 0.0)
+    printf("Idle: %.1f s, %.2f%% CPU, %u frames drawn\n", total.idleSeconds,
+           100.0 * total.idleCpuSeconds / total.idleSeconds, total.idleFrames);
+  if (clock.frames == 0)
+    return;
+  unsigned int kept = std::min(clock.frames, (unsigned int)FRAME_SAMPLES);
+  std::vector<float> sorted(clock.frameMs, clock.frameMs + kept);
+  std::sort(sorted.begin(), sorted.end());
+  if (clock.intervalMs > 0.0)
+    printf("Frames: %u at %.0f Hz (%.2f ms)", clock.frames,
+           1000.0 / clock.intervalMs, clock.intervalMs);
+  else
+    printf("Frames: %u uncapped", clock.frames);
+  printf(", mean %.2f ms, p99 %.2f ms%s, max %.2f ms, %u resyncs\n",
+         clock.frameMsSum / clock.frames, sorted[kept * 99 / 100],
+         kept < clock.frames ? " (recent frames)" : "", clock.frameMsMax,
+         clock.resyncs);
+}
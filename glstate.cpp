@@ -0,0 +1,171 @@
+#define GL_SILENCE_DEPRECATION // Ignore deprecation errors
+#include "headers/glstate.h"
+#include <GLUT/glut.h>
+#include <cstdio>
+#include <cstring>
+
+GlStateStats glStateStats;
+
+static const GLenum CAPS[] = {GL_LIGHTING,            GL_LIGHT0,
+                              GL_DEPTH_TEST,          GL_BLEND,
+                              GL_TEXTURE_2D,          GL_COLOR_MATERIAL,
+                              GL_POLYGON_OFFSET_FILL, GL_CULL_FACE};
+const int CAP_COUNT = sizeof(CAPS) / sizeof(CAPS[0]);
+
+static const GLenum MATERIALS[] = {GL_AMBIENT, GL_DIFFUSE, GL_SPECULAR,
+                                   GL_EMISSION, GL_SHININESS};
+const int MATERIAL_COUNT = sizeof(MATERIALS) / sizeof(MATERIALS[0]);
+
+// What was last set; all zero is all unknown
+static struct {
+  unsigned char caps[CAP_COUNT]; // 0 unknown, 1 off, 2 on
+  bool blendKnown;
+  GLenum blendSource, blendDestination;
+  bool cullKnown;
+  GLenum cullMode;
+  bool matrixKnown;
+  GLenum matrixMode;
+  bool materialKnown[MATERIAL_COUNT];
+  GLfloat material[MATERIAL_COUNT][4];
+  bool lineKnown, pointKnown;
+  GLfloat lineWidth, pointSize;
+  bool textureKnown, programKnown;
+  GLuint texture, program;
+} cache;
+
+// False, and counted as elided, when the call would change nothing
+static bool changes(bool same) {
+  if (same) {
+    glStateStats.frame.elided++;
+    return false;
+  }
+  glStateStats.frame.issued++;
+  return true;
+}
+
+static int capIndex(GLenum cap) {
+  for (int i = 0; i < CAP_COUNT; i++)
+    if (CAPS[i] == cap)
+      return i;
+  return -1;
+}
+
+static void forgetMaterial() {
+  for (int i = 0; i < MATERIAL_COUNT; i++)
+    cache.materialKnown[i] = false;
+}
+
+static void setCap(GLenum cap, bool on) {
+  int i = capIndex(cap);
+  unsigned char value = on ? 2 : 1;
+  if (!changes(i >= 0 && cache.caps[i] == value))
+    return;
+  if (on)
+    glEnable(cap);
+  else
+    glDisable(cap);
+  if (i >= 0)
+    cache.caps[i] = value;
+  if (cap == GL_COLOR_MATERIAL)
+    forgetMaterial();
+}
+
+void stateEnable(unsigned int cap) { setCap(cap, true); }
+
+void stateDisable(unsigned int cap) { setCap(cap, false); }
+
+void stateBlendFunc(unsigned int source, unsigned int destination) {
+  if (!changes(cache.blendKnown && cache.blendSource == source &&
+               cache.blendDestination == destination))
+    return;
+  glBlendFunc(source, destination);
+  cache.blendKnown = true;
+  cache.blendSource = source;
+  cache.blendDestination = destination;
+}
+
+void stateCullFace(unsigned int mode) {
+  if (!changes(cache.cullKnown && cache.cullMode == mode))
+    return;
+  glCullFace(mode);
+  cache.cullKnown = true;
+  cache.cullMode = mode;
+}
+
+void stateMatrixMode(unsigned int mode) {
+  if (!changes(cache.matrixKnown && cache.matrixMode == mode))
+    return;
+  glMatrixMode(mode);
+  cache.matrixKnown = true;
+  cache.matrixMode = mode;
+}
+
+void stateMaterial(unsigned int name, const float *values) {
+  int i = 0;
+  while (i < MATERIAL_COUNT && MATERIALS[i] != name)
+    i++;
+  size_t bytes = (name == GL_SHININESS ? 1 : 4) * sizeof(GLfloat);
+  if (!changes(i < MATERIAL_COUNT && cache.materialKnown[i] &&
+               memcmp(cache.material[i], values, bytes) == 0))
+    return;
+  glMaterialfv(GL_FRONT, name, values);
+  if (i < MATERIAL_COUNT) {
+    cache.materialKnown[i] = true;
+    memcpy(cache.material[i], values, bytes);
+  }
+}
+
+void stateLineWidth(float width) {
+  if (!changes(cache.lineKnown && cache.lineWidth == width))
+    return;
+  glLineWidth(width);
+  cache.lineKnown = true;
+  cache.lineWidth = width;
+}
+
+void statePointSize(float size) {
+  if (!changes(cache.pointKnown && cache.pointSize == size))
+    return;
+  glPointSize(size);
+  cache.pointKnown = true;
+  cache.pointSize = size;
+}
+
+void stateBindTexture(unsigned int texture) {
+  if (!changes(cache.textureKnown && cache.texture == texture))
+    return;
+  glBindTexture(GL_TEXTURE_2D, texture);
+  cache.textureKnown = true;
+  cache.texture = texture;
+}
+
+void stateUseProgram(unsigned int program) {
+  if (!changes(cache.programKnown && cache.program == program))
+    return;
+  glUseProgram(program);
+  cache.programKnown = true;
+  cache.program = program;
+}
+
+void stateInvalidate() { memset(&cache, 0, sizeof(cache)); }
+
+void stateFrameDone() {
+  glStateStats.lastFrame = glStateStats.frame;
+  glStateStats.total.issued += glStateStats.frame.issued;
+  glStateStats.total.elided += glStateStats.frame.elided;
+  glStateStats.frames++;
+  glStateStats.frame.issued = glStateStats.frame.elided = 0;
+}
+
+void printGlStateStats() {
+  const GlStateStats &stats = glStateStats;
+  if (stats.frames == 0)
+    return;
+  unsigned int calls = stats.total.issued + stats.total.elided;
+  printf("GL state calls: %.1f a frame, %.1f issued and %.1f elided (%.0f%%) "
+         "over %u frames\n",
+         (double)calls / stats.frames,
+         (double)stats.total.issued / stats.frames,
+         (double)stats.total.elided / stats.frames,
+         calls ? 100.0 * stats.total.elided / calls : 0.0, stats.frames);
+}
@@ -0,0 +1,312 @@
+#include "headers/grid.h"
+#include <cstring>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+void resizeGrid(TileGrid &grid, int rows, int cols) {
+  grid.rows = rows;
+  grid.cols = cols;
+  grid.tiles.resize((size_t)rows * cols);
+}
+
+void gridToLayout(const TileGrid &grid,
+                  std::vector<std::vector<int> > &layout) {
+  layout.resize(grid.rows);
+  for (int i = 0; i < grid.rows; i++) {
+    const unsigned char *row = grid.row(i);
+    layout[i].assign(row, row + grid.cols);
+  }
+}
+
+void layoutToGrid(const std::vector<std::vector<int> > &layout,
+                  TileGrid &grid) {
+  resizeGrid(grid, layout.size(), layout.empty() ? 0 : layout[0].size());
+  for (int i = 0; i < grid.rows; i++) {
+    unsigned char *row = grid.row(i);
+    for (int j = 0; j < grid.cols; j++)
+      row[j] = (unsigned char)layout[i][j];
+  }
+}
+
+void packGrid(const TileGrid &grid, PackedTileGrid &packed) {
+  packed.rows = grid.rows;
+  packed.cols = grid.cols;
+  packed.stride = (grid.cols + 1) / 2;
+  packed.nibbles.assign((size_t)packed.rows * packed.stride, 0);
+  for (int i = 0; i < grid.rows; i++) {
+    const unsigned char *row = grid.row(i);
+    unsigned char *out = &packed.nibbles[(size_t)i * packed.stride];
+    for (int j = 0; j < grid.cols; j++)
+      out[j >> 1] |= (row[j] & 0x0F) << ((j & 1) * 4);
+  }
+}
+
+void unpackGrid(const PackedTileGrid &packed, TileGrid &grid) {
+  resizeGrid(grid, packed.rows, packed.cols);
+  for (int i = 0; i < packed.rows; i++) {
+    unsigned char *row = grid.row(i);
+    const unsigned char *in = &packed.nibbles[(size_t)i * packed.stride];
+    for (int j = 0; j < packed.cols; j++)
+      row[j] = (in[j >> 1] >> ((j & 1) * 4)) & 0x0F;
+  }
+}
+
+unsigned char packedTileAt(const PackedTileGrid &packed, int row, int col) {
+  unsigned char byte = packed.nibbles[(size_t)row * packed.stride + (col >> 1)];
+  return (byte >> ((col & 1) * 4)) & 0x0F;
+}
+
+void setPackedTile(PackedTileGrid &packed, int row, int col,
+                   unsigned char tile) {
+  unsigned char &byte =
+      packed.nibbles[(size_t)row * packed.stride + (col >> 1)];
+  int shift = (col & 1) * 4;
+  byte = (byte & ~(0x0F << shift)) | ((tile & 0x0F) << shift);
+}
+
+// Zero counting over a byte buffer. 'nibbles' counts both halves of each
+// byte. Per-lane counters are flushed before they can overflow.
+static size_t countZeros(const unsigned char *p, size_t n, bool nibbles) {
+  size_t zeros = 0, i = 0;
+#if defined(__SSE2__)
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i low = _mm_set1_epi8(0x0F);
+  while (i + 16 <= n) {
+    __m128i acc = zero;
+    for (int k = 0; k < 127 && i + 16 <= n; k++, i += 16) {
+      __m128i v = _mm_loadu_si128((const __m128i *)(p + i));
+      if (nibbles) {
+        __m128i lo = _mm_and_si128(v, low);
+        __m128i hi = _mm_and_si128(_mm_srli_epi16(v, 4), low);
+        acc = _mm_sub_epi8(acc, _mm_cmpeq_epi8(lo, zero));
+        acc = _mm_sub_epi8(acc, _mm_cmpeq_epi8(hi, zero));
+      } else {
+        acc = _mm_sub_epi8(acc, _mm_cmpeq_epi8(v, zero));
+      }
+    }
+    __m128i sums = _mm_sad_epu8(acc, zero);
+    zeros += _mm_cvtsi128_si32(sums) + _mm_extract_epi16(sums, 4);
+  }
+#elif defined(__ARM_NEON)
+  const uint8x16_t zero = vdupq_n_u8(0);
+  const uint8x16_t low = vdupq_n_u8(0x0F);
+  while (i + 16 <= n) {
+    uint8x16_t acc = zero;
+    for (int k = 0; k < 127 && i + 16 <= n; k++, i += 16) {
+      uint8x16_t v = vld1q_u8(p + i);
+      if (nibbles) {
+        acc = vsubq_u8(acc, vceqq_u8(vandq_u8(v, low), zero));
+        acc = vsubq_u8(acc, vceqq_u8(vshrq_n_u8(v, 4), zero));
+      } else {
+        acc = vsubq_u8(acc, vceqq_u8(v, zero));
+      }
+    }
+    zeros += vaddlvq_u8(acc);
+  }
+#endif
+  for (; i < n; i++) {
+    if (nibbles)
+      zeros += ((p[i] & 0x0F) == 0) + ((p[i] >> 4) == 0);
+    else
+      zeros += p[i] == 0;
+  }
+  return zeros;
+}
+
+size_t countNonEmpty(const TileGrid &grid) {
+  return grid.tiles.size() - countZeros(grid.tiles.data(), grid.tiles.size(),
+                                        false);
+}
+
+size_t countNonEmpty(const PackedTileGrid &packed) {
+  // Row padding nibbles are zero, so they drop out with the empty tiles
+  size_t n = packed.nibbles.size();
+  return 2 * n - countZeros(packed.nibbles.data(), n, true);
+}
+
+// Match masks for 16 bytes: bit k set if byte k (or its low / high nibble)
+// equals 'type'. Scalar builds compute the same masks bit by bit.
+static void matchBlock(const unsigned char *p, unsigned char type,
+                       bool nibbles, unsigned int &lowMask,
+                       unsigned int &highMask) {
+#if defined(__SSE2__)
+  __m128i v = _mm_loadu_si128((const __m128i *)p);
+  __m128i t = _mm_set1_epi8(type);
+  if (nibbles) {
+    __m128i low = _mm_set1_epi8(0x0F);
+    lowMask = _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_and_si128(v, low), t));
+    highMask = _mm_movemask_epi8(
+        _mm_cmpeq_epi8(_mm_and_si128(_mm_srli_epi16(v, 4), low), t));
+  } else {
+    lowMask = _mm_movemask_epi8(_mm_cmpeq_epi8(v, t));
+    highMask = 0;
+  }
+#else
+  lowMask = highMask = 0;
+#if defined(__ARM_NEON)
+  // Skip blocks without a match before doing any per-byte work
+  uint8x16_t v = vld1q_u8(p);
+  uint8x16_t t = vdupq_n_u8(type);
+  uint8x16_t hit =
+      nibbles ? vorrq_u8(vceqq_u8(vandq_u8(v, vdupq_n_u8(0x0F)), t),
+                         vceqq_u8(vshrq_n_u8(v, 4), t))
+              : vceqq_u8(v, t);
+  if (vmaxvq_u8(hit) == 0)
+    return;
+#endif
+  for (int k = 0; k < 16; k++) {
+    if (nibbles) {
+      lowMask |= (unsigned int)((p[k] & 0x0F) == type) << k;
+      highMask |= (unsigned int)((p[k] >> 4) == type) << k;
+    } else {
+      lowMask |= (unsigned int)(p[k] == type) << k;
+    }
+  }
+#endif
+}
+
+static int lowestBit(unsigned int mask) {
+  int bit = 0;
+  while (!(mask & 1)) {
+    mask >>= 1;
+    bit++;
+  }
+  return bit;
+}
+
+void findTiles(const TileGrid &grid, unsigned char type,
+               std::vector<int> &cells) {
+  cells.clear();
+  const unsigned char *p = grid.tiles.data();
+  size_t n = grid.tiles.size(), i = 0;
+  for (; i + 16 <= n; i += 16) {
+    unsigned int mask, unused;
+    matchBlock(p + i, type, false, mask, unused);
+    for (; mask; mask &= mask - 1)
+      cells.push_back((int)(i + lowestBit(mask)));
+  }
+  for (; i < n; i++) {
+    if (p[i] == type)
+      cells.push_back((int)i);
+  }
+}
+
+void findTiles(const PackedTileGrid &packed, unsigned char type,
+               std::vector<int> &cells) {
+  cells.clear();
+  const unsigned char *p = packed.nibbles.data();
+  size_t n = packed.nibbles.size(), i = 0;
+  for (; i < n; i += 16) {
+    unsigned int lowMask, highMask;
+    if (i + 16 <= n) {
+      matchBlock(p + i, type, true, lowMask, highMask);
+    } else {
+      unsigned char tail[16] = {0};
+      memcpy(tail, p + i, n - i);
+      matchBlock(tail, type, true, lowMask, highMask);
+    }
+    // Byte order first, low nibble before high, keeps cells row-major
+    for (unsigned int mask = lowMask | highMask; mask; mask &= mask - 1) {
+      int k = lowestBit(mask);
+      size_t byte = i + k;
+      int row = (int)(byte / packed.stride);
+      int col = (int)(byte % packed.stride) * 2;
+      if (lowMask & (1u << k))
+        cells.push_back(row * packed.cols + col);
+      if (highMask & (1u << k))
+        cells.push_back(row * packed.cols + col + 1);
+    }
+  }
+}
+
+int walkableWordsPerRow(int cols) { return (cols + 63) / 64; }
+
+// Non-empty bits for 16 tiles in column order
+static unsigned int walkableBits16(const unsigned char *tiles) {
+#if defined(__SSE2__)
+  __m128i v = _mm_loadu_si128((const __m128i *)tiles);
+  return ~_mm_movemask_epi8(_mm_cmpeq_epi8(v, _mm_setzero_si128())) & 0xFFFF;
+#elif defined(__ARM_NEON)
+  static const uint8_t weights[16] = {1, 2, 4, 8, 16, 32, 64, 128,
+                                      1, 2, 4, 8, 16, 32, 64, 128};
+  uint8x16_t set = vtstq_u8(vld1q_u8(tiles), vld1q_u8(tiles));
+  uint8x16_t bits = vandq_u8(set, vld1q_u8(weights));
+  return vaddv_u8(vget_low_u8(bits)) | (vaddv_u8(vget_high_u8(bits)) << 8);
+#else
+  unsigned int bits = 0;
+  for (int k = 0; k < 16; k++)
+    bits |= (unsigned int)(tiles[k] != 0) << k;
+  return bits;
+#endif
+}
+
+// Same for 16 tiles packed into 8 bytes: spread the nibbles out to one byte
+// per tile, then reuse the byte kernel
+static unsigned int walkableBitsPacked16(const unsigned char *bytes) {
+#if defined(__SSE2__)
+  __m128i v = _mm_loadl_epi64((const __m128i *)bytes);
+  __m128i low = _mm_set1_epi8(0x0F);
+  __m128i lo = _mm_and_si128(v, low);
+  __m128i hi = _mm_and_si128(_mm_srli_epi16(v, 4), low);
+  __m128i tiles = _mm_unpacklo_epi8(lo, hi);
+  return ~_mm_movemask_epi8(_mm_cmpeq_epi8(tiles, _mm_setzero_si128())) &
+         0xFFFF;
+#elif defined(__ARM_NEON)
+  uint8x8_t v = vld1_u8(bytes);
+  uint8x8x2_t spread = vzip_u8(vand_u8(v, vdup_n_u8(0x0F)), vshr_n_u8(v, 4));
+  unsigned char tiles[16];
+  vst1q_u8(tiles, vcombine_u8(spread.val[0], spread.val[1]));
+  return walkableBits16(tiles);
+#else
+  unsigned int bits = 0;
+  for (int k = 0; k < 8; k++) {
+    bits |= (unsigned int)((bytes[k] & 0x0F) != 0) << (2 * k);
+    bits |= (unsigned int)((bytes[k] >> 4) != 0) << (2 * k + 1);
+  }
+  return bits;
+#endif
+}
+
+void walkableMask(const TileGrid &grid, std::vector<unsigned long long> &mask) {
+  int words = walkableWordsPerRow(grid.cols);
+  mask.assign((size_t)grid.rows * words, 0);
+  for (int i = 0; i < grid.rows; i++) {
+    const unsigned char *row = grid.row(i);
+    unsigned long long *out = &mask[(size_t)i * words];
+    for (int j = 0; j < grid.cols; j += 16) {
+      unsigned int bits;
+      if (j + 16 <= grid.cols) {
+        bits = walkableBits16(row + j);
+      } else {
+        unsigned char tail[16] = {0};
+        memcpy(tail, row + j, grid.cols - j);
+        bits = walkableBits16(tail);
+      }
+      out[j / 64] |= (unsigned long long)bits << (j % 64);
+    }
+  }
+}
+
+void walkableMask(const PackedTileGrid &packed,
+                  std::vector<unsigned long long> &mask) {
+  int words = walkableWordsPerRow(packed.cols);
+  mask.assign((size_t)packed.rows * words, 0);
+  for (int i = 0; i < packed.rows; i++) {
+    const unsigned char *row = &packed.nibbles[(size_t)i * packed.stride];
+    unsigned long long *out = &mask[(size_t)i * words];
+    for (int b = 0; b < packed.stride; b += 8) {
+      unsigned int bits;
+      if (b + 8 <= packed.stride) {
+        bits = walkableBitsPacked16(row + b);
+      } else {
+        unsigned char tail[8] = {0};
+        memcpy(tail, row + b, packed.stride - b);
+        bits = walkableBitsPacked16(tail);
+      }
+      out[b / 32] |= (unsigned long long)bits << ((2 * b) % 64);
+    }
+  }
+}
@@ -0,0 +1,66 @@
+#ifndef BATCH_H
+#define BATCH_H
+
+#include "sim.h"
+#include <vector>
+
+// Many games of one level stepped together, for bots and fuzzing. Each call
+// applies one input per game and plays it out: a move runs its whole roll
+// (and fall), as if the block were left to settle before the next input.
+// A win restarts the game the way INPUT_RESET does. Undo and redo are not
+// tracked here; they wait a tick like INPUT_NONE.
+//
+// The rules are baked into a transition table with one entry per block
+// state and input, so a step is a table lookup plus a few mask operations
+// on the game's visible toggle groups. Games are kept as arrays of states,
+// masks and tick counts (structure of arrays), which lets the step gather
+// 8 games at a time with AVX2 where the CPU has it.
+
+// Outcome of a step, per game
+enum BatchEvent { BATCH_NONE = 0, BATCH_FELL = 1, BATCH_WON = 2 };
+
+struct BatchSim {
+  int rows, cols;
+  int startState;
+  int groupCount;
+  // 4 ints per (state, input): next state, groups that must be visible to
+  // stand there, groups toggled on landing, info bits (BATCH_INFO_* in
+  // batch.cpp) and ticks taken
+  std::vector<int> table;
+
+  // Per game: cell * 4 + orientation, visible toggle groups (bit per group)
+  // and ticks run, as simStep() counts them
+  int count;
+  std::vector<int> state;
+  std::vector<unsigned int> mask;
+  std::vector<unsigned int> ticks;
+};
+
+// Build the table from a loaded level and start 'games' games on it.
+// Fails if the level has more than 32 toggle groups, or a tile shared by two
+// groups or by a group and an action tile (the table has no order of
+// toggles to resolve those).
+bool batchLoadLevel(BatchSim &batch, const SimState &level, int games);
+// Put every game back on the start with all bridges hidden
+void batchReset(BatchSim &batch);
+
+// Apply actions[i] (a SimInput; INPUT_NONE waits one tick) to games
+// first .. first + count - 1. 'events' gets a BatchEvent per game, or may be
+// NULL. Ranges that do not overlap can be stepped from different threads.
+void batchStep(BatchSim &batch, const unsigned char *actions,
+               unsigned char *events, int first, int count);
+// Same, one game at a time (the reference, and the path without AVX2)
+void batchStepScalar(BatchSim &batch, const unsigned char *actions,
+                     unsigned char *events, int first, int count);
+
+inline int batchRow(const BatchSim &batch, int game) {
+  return (batch.state[game] >> 2) / batch.cols;
+}
+inline int batchCol(const BatchSim &batch, int game) {
+  return (batch.state[game] >> 2) % batch.cols;
+}
+inline BlockOrientation batchOrientation(const BatchSim &batch, int game) {
+  return (BlockOrientation)(batch.state[game] & 3);
+}
+
+#endif
@@ -0,0 +1,75 @@
+#ifndef ENVPOOL_H
+#define ENVPOOL_H
+
+#include "batch.h"
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// reset() / step(actions) over many environments of one level, for training
+// agents. Games run on the batch simulator (the same rules as simStep()),
+// sharded over a pool of worker threads that write observations, rewards
+// and done flags straight into the pool's buffers: callers read them in
+// place after each call, nothing is copied out.
+//
+// An observation is a window x window tile patch centred on the block's
+// first cell, one byte per tile: the tile code as currently shown (hidden
+// bridges are 0, out of bounds is 0), with ENV_OBS_BLOCK set under the
+// block. An episode ends on a win or a fall, or after maxSteps steps;
+// the environment then restarts and its observation is the new episode's.
+
+const unsigned char ENV_OBS_BLOCK = 0x10;
+
+const float ENV_REWARD_STEP = -0.01f;
+const float ENV_REWARD_FALL = -1.0f;
+const float ENV_REWARD_WIN = 1.0f;
+
+enum EnvDone { ENV_RUNNING = 0, ENV_TERMINATED = 1, ENV_TRUNCATED = 2 };
+
+struct EnvPool {
+  BatchSim batch;
+  int count;
+  int window;
+  int maxSteps; // 0 for no limit
+
+  // Level tiles as they start (bridges hidden), padded by window / 2 on
+  // every side so a window never needs bounds checks
+  int pad, paddedCols;
+  std::vector<unsigned char> padded;
+  std::vector<std::vector<std::pair<int, int> > > groupTiles;
+
+  // Outputs of the last reset or step, per environment
+  std::vector<unsigned char> observations; // count * window * window
+  std::vector<float> rewards;
+  std::vector<unsigned char> dones; // EnvDone
+  std::vector<unsigned char> events;
+  std::vector<int> episodeSteps;
+
+  // Worker pool: shard 0 runs on the caller, shard n on workers[n - 1]
+  std::vector<std::thread> workers;
+  std::mutex mutex;
+  std::condition_variable wake, finished;
+  const unsigned char *actions; // NULL for a reset
+  unsigned int generation;
+  int pending;
+  bool quit;
+};
+
+// Set up 'envs' environments of a loaded level on 'threads' threads (0 for
+// one per core). 'window' is rounded up to an odd size of at least 3. Fails
+// for levels the batch simulator cannot take.
+bool envPoolCreate(EnvPool &pool, const SimState &level, int envs, int window,
+                   int threads, int maxSteps);
+void envPoolDestroy(EnvPool &pool);
+
+// Restart every environment
+void envPoolReset(EnvPool &pool);
+// One action (a SimInput) per environment
+void envPoolStep(EnvPool &pool, const unsigned char *actions);
+
+inline const unsigned char *envObservation(const EnvPool &pool, int env) {
+  return &pool.observations[(size_t)env * pool.window * pool.window];
+}
+
+#endif
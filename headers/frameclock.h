@@ -0,0 +1,67 @@
+#ifndef FRAMECLOCK_H
+#define FRAMECLOCK_H
+
+#include <chrono>
+#include <ctime>
+#include <vector>
+
+// Frame pacing on the monotonic clock. Frames are due at fixed deadlines
+// (one interval after the previous deadline, not after the previous frame),
+// so timer rounding and slow frames do not add up to drift. A frame that
+// falls more than an interval behind resyncs to now instead of bursting.
+//
+// When nothing on screen moves the caller can go idle: the timer waits
+// longer, the gap is not counted as a frame time, and the wall and CPU time
+// spent idle are added up to show what idling saves.
+
+typedef std::chrono::steady_clock::time_point FrameTime;
+
+const double MAX_FRAME_SECONDS = 0.25; // Longer stalls are not caught up
+const int FRAME_SAMPLES = 4096; // Recent frame times kept for the p99
+
+struct FrameClock {
+  double intervalMs; // 0 when uncapped
+  FrameTime nextDue;
+  FrameTime lastUpdate;
+  FrameTime lastPresent;
+  bool presented;
+  unsigned int resyncs;
+  // Time between presented frames: the last FRAME_SAMPLES (a ring), and
+  // the count, sum and worst of the session
+  float frameMs[FRAME_SAMPLES];
+  unsigned int frames;
+  double frameMsSum;
+  float frameMsMax;
+
+  // Idle accounting
+  bool idle;
+  FrameTime idleSince;
+  std::clock_t idleCpuStart;
+  double idleSeconds, idleCpuSeconds;
+  unsigned int idleFrames; // Frames drawn while idle
+};
+
+// hz <= 0 runs uncapped: a new frame as soon as the last one is done
+void frameClockInit(FrameClock &clock, double hz);
+// Seconds since the previous call, clamped to MAX_FRAME_SECONDS
+double frameClockUpdate(FrameClock &clock);
+// Advance to the next deadline and return the whole ms to wait for it (for
+// glutTimerFunc, which rounds down)
+int frameClockNextDelayMs(FrameClock &clock);
+// Sleep off the part of the wait below timer resolution
+void frameClockWaitForDue(const FrameClock &clock);
+// Call once a frame is on screen
+void frameClockPresented(FrameClock &clock);
+
+// Enter or leave idle (no-op if unchanged)
+void frameClockSetIdle(FrameClock &clock, bool idle);
+// Wait 'ms' for the next timer while idle; returns the delay to pass on
+int frameClockIdleDelayMs(FrameClock &clock, int ms);
+// Make the next frame due now (input arrived while idle)
+void frameClockWake(FrameClock &clock);
+
+// Frame time mean, p99 (of the recent frames) and max against the target,
+// and the idle time and its CPU use (run at exit)
+void printFrameStats(const FrameClock &clock);
+
+#endif
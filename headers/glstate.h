@@ -0,0 +1,56 @@
+#ifndef GLSTATE_H
+#define GLSTATE_H
+
+// A cache of the GL state the draw code sets each frame. Each call compares
+// the value with what was last set and only calls GL when it differs. State
+// not set through here yet is unknown, so the first call always goes
+// through. All code that changes this state has to go through the cache,
+// or the cache no longer matches GL.
+//
+// Tracked: GL_LIGHTING, GL_LIGHT0, GL_DEPTH_TEST, GL_BLEND, GL_TEXTURE_2D,
+// GL_COLOR_MATERIAL, GL_POLYGON_OFFSET_FILL and GL_CULL_FACE, the blend
+// function, the cull face, the matrix mode, front material colours and
+// shininess, line width, point size, the bound 2D texture and the current
+// program. Other capabilities go straight to GL (and are counted as
+// issued). While GL_COLOR_MATERIAL is on, glColor writes the material, so
+// turning it on or off forgets the material.
+//
+// Calls are counted per frame, issued against elided, to show what the
+// cache saves.
+
+struct GlStateCounts {
+  unsigned int issued, elided;
+};
+
+struct GlStateStats {
+  GlStateCounts frame;     // So far this frame
+  GlStateCounts lastFrame; // The last whole frame
+  GlStateCounts total;     // Whole frames only
+  unsigned int frames;
+};
+
+extern GlStateStats glStateStats;
+
+// GL enums and names as unsigned int, so this header needs no GL
+void stateEnable(unsigned int cap);
+void stateDisable(unsigned int cap);
+void stateBlendFunc(unsigned int source, unsigned int destination);
+void stateCullFace(unsigned int mode);
+void stateMatrixMode(unsigned int mode);
+// GL_FRONT material: GL_AMBIENT, GL_DIFFUSE, GL_SPECULAR, GL_EMISSION (4
+// values) or GL_SHININESS (1)
+void stateMaterial(unsigned int name, const float *values);
+void stateLineWidth(float width);
+void statePointSize(float size);
+// Unbind a texture or program through here before deleting it
+void stateBindTexture(unsigned int texture);
+void stateUseProgram(unsigned int program);
+
+// Forget everything (GL state changed behind the cache's back)
+void stateInvalidate();
+// Close the frame's counts (call once a frame is drawn)
+void stateFrameDone();
+// Calls per frame, issued and elided (run at exit)
+void printGlStateStats();
+
+#endif
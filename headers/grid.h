@@ -0,0 +1,54 @@
+#ifndef GRID_H
+#define GRID_H
+
+#include <cstddef>
+#include <vector>
+
+// Compact level grid: one byte per tile, rows stored back to back.
+// platformLayout spends an int per tile; this is the form used for packing,
+// bulk import and scans.
+struct TileGrid {
+  int rows, cols;
+  std::vector<unsigned char> tiles; // rows * cols tile codes
+
+  unsigned char *row(int r) { return &tiles[(size_t)r * cols]; }
+  const unsigned char *row(int r) const { return &tiles[(size_t)r * cols]; }
+};
+
+// Nibble-packed grid for huge levels: tile codes fit in 4 bits, so two tiles
+// share a byte (even columns in the low nibble). Every row starts on a byte
+// boundary; an odd width leaves a zero high nibble at the end of each row.
+struct PackedTileGrid {
+  int rows, cols;
+  int stride; // Bytes per row
+  std::vector<unsigned char> nibbles;
+};
+
+void resizeGrid(TileGrid &grid, int rows, int cols);
+void gridToLayout(const TileGrid &grid, std::vector<std::vector<int> > &layout);
+void layoutToGrid(const std::vector<std::vector<int> > &layout, TileGrid &grid);
+
+void packGrid(const TileGrid &grid, PackedTileGrid &packed);
+void unpackGrid(const PackedTileGrid &packed, TileGrid &grid);
+unsigned char packedTileAt(const PackedTileGrid &packed, int row, int col);
+void setPackedTile(PackedTileGrid &packed, int row, int col,
+                   unsigned char tile);
+
+// Bulk queries, vectorised with SSE2 or NEON where available. Cells come
+// back as row * cols + col in row-major order; 'type' must not be 0.
+// Walkable masks hold one bit per tile (set for non-empty tiles) with each
+// row padded to whole 64-bit words. The game keeps one of the shown tiles
+// for the light streaks; the rules (sim.h) scan their int layout once per
+// load and the packed grid is for packs and ./bench grid.
+size_t countNonEmpty(const TileGrid &grid);
+size_t countNonEmpty(const PackedTileGrid &packed);
+void findTiles(const TileGrid &grid, unsigned char type,
+               std::vector<int> &cells);
+void findTiles(const PackedTileGrid &packed, unsigned char type,
+               std::vector<int> &cells);
+int walkableWordsPerRow(int cols);
+void walkableMask(const TileGrid &grid, std::vector<unsigned long long> &mask);
+void walkableMask(const PackedTileGrid &packed,
+                  std::vector<unsigned long long> &mask);
+
+#endif
@@ -0,0 +1,61 @@
+#ifndef INPUTQUEUE_H
+#define INPUTQUEUE_H
+
+#include "sim.h"
+#include <atomic>
+#include <chrono>
+#include <vector>
+
+// Moves pressed while the block is still rolling wait here and start on the
+// first tick the block can take them. Single producer (key callbacks), single
+// consumer (the game tick), no locks.
+//
+// Coalescing: a press of the same move as the newest waiting one, within
+// coalesceMs of the previous press, is merged into it. This soaks up key
+// auto-repeat so a held key keeps one move queued instead of a full queue
+// that keeps rolling after release.
+
+typedef std::chrono::steady_clock::time_point InputTime;
+
+const int INPUT_QUEUE_CAPACITY = 16;
+const int INPUT_LATENCY_SAMPLES = 1024; // Recent moves kept for percentiles
+
+struct QueuedInput {
+  SimInput input;
+  InputTime pressed;
+};
+
+struct InputQueue {
+  QueuedInput entries[INPUT_QUEUE_CAPACITY];
+  std::atomic<unsigned int> head; // Next entry to take (consumer)
+  std::atomic<unsigned int> tail; // Next free entry (producer)
+  int depth;                      // Most presses waiting at once
+  int coalesceMs;                 // 0 to queue every press
+
+  // Producer only
+  SimInput lastInput;
+  InputTime lastPressed;
+  unsigned int dropped, coalesced;
+
+  // Consumer only: press to move start, in ms, for the last
+  // INPUT_LATENCY_SAMPLES moves (a ring) and the worst of the session
+  float latencies[INPUT_LATENCY_SAMPLES];
+  unsigned int moves;
+  float maxLatencyMs;
+  unsigned int cleared;
+};
+
+void inputQueueInit(InputQueue &queue, int depth, int coalesceMs);
+// Producer: false if the queue was full and the press was dropped
+bool inputQueuePush(InputQueue &queue, SimInput input, InputTime pressed);
+// Consumer: the oldest waiting press, left in the queue
+bool inputQueuePeek(const InputQueue &queue, QueuedInput &entry);
+// Consumer: the oldest press started its move now; remove it
+void inputQueueMoveStarted(InputQueue &queue);
+// Consumer: drop every waiting press (the block fell, the level was won)
+void inputQueueClear(InputQueue &queue);
+
+// Moves, dropped and merged presses and press-to-move latency percentiles
+void printInputQueueStats(const InputQueue &queue);
+
+#endif
@@ -0,0 +1,52 @@
+#ifndef LEVELFILE_H
+#define LEVELFILE_H
+
+#include "grid.h"
+#include <cstddef>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Level text format: one row per line, one digit per tile (codes as in the
+// README table). A file holds one level or a whole pack.
+//
+//   # comment
+//   @level Stage 3          Starts a new level (needed between the levels
+//                           of a pack, optional otherwise)
+//   @switch 1 2 : 3 4 3 5   Action tile (1,2) toggles bridges (3,4) (3,5)
+//   111100111100111
+//   ...
+//
+// Blank lines are ignored and every row of a level must be the same width.
+
+struct SwitchDef {
+  int actionRow, actionCol;
+  std::vector<std::pair<int, int> > tiles; // {row, col} of each bridge tile
+};
+
+struct LevelData {
+  std::string name;
+  TileGrid grid;
+  std::vector<SwitchDef> switches;
+};
+
+struct LevelParseError {
+  size_t line, column; // 1-based position of the first error
+  std::string message;
+};
+
+// Parse a buffer holding one or more levels. Levels are parsed on 'threads'
+// worker threads (0 = one per core). On failure 'error' holds the first
+// error in file order.
+bool parseLevelText(const char *text, size_t size,
+                    std::vector<LevelData> &levels, int threads,
+                    LevelParseError &error);
+
+// Map a file and parse every level in it. Prints the reason on failure.
+bool importLevelText(const char *path, std::vector<LevelData> &levels,
+                     int threads);
+
+// Load the first level of a file. Prints the reason on failure.
+bool loadLevelFile(const char *path, LevelData &level);
+
+#endif
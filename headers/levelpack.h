@@ -0,0 +1,62 @@
+#ifndef LEVELPACK_H
+#define LEVELPACK_H
+
+#include "grid.h"
+#include <cstddef>
+#include <vector>
+
+// Level packs: many levels in one buffer or file.
+//
+// Each tile is split into bit-planes: an occupancy plane (tile != 0, coded as
+// the change from the row above) over every cell, and four planes holding the
+// bits of (tile - 1) over occupied cells only. Every plane is run-length coded
+// and the run lengths go through an adaptive binary range coder (Exp-Golomb
+// bins, one context set per plane and run colour). Mostly empty levels with
+// long runs of 1s become a handful of runs per row. Runs are pulled on demand,
+// so levels decode one row at a time straight into the destination buffer.
+//
+// Layout: "BLXP", u32 level count, then per level varint rows, varint cols,
+// varint payload bytes and the payload.
+
+const size_t LEVEL_PACK_HEADER_BYTES = 8;
+
+// Adaptive probabilities for run lengths: 5 planes x 2 run colours
+const int RUN_CONTEXTS = 10;
+const int RUN_PREFIX_BINS = 33;
+
+struct RunModel {
+  unsigned short prefix[RUN_CONTEXTS][RUN_PREFIX_BINS];
+  unsigned short suffix[RUN_CONTEXTS][RUN_PREFIX_BINS][3];
+};
+
+// Streaming decoder for one level
+struct LevelDecoder {
+  const unsigned char *in, *end;
+  unsigned int range, code;
+  int rows, cols;
+  unsigned char bit[5];       // Colour of the current run for each plane
+  unsigned int remain[5];     // Tiles left in the current run
+  bool started[5];            // First run of a plane may be empty
+  RunModel model;
+};
+
+// Writing
+void beginLevelPack(std::vector<unsigned char> &pack);
+void appendPackedLevel(std::vector<unsigned char> &pack, const TileGrid &grid);
+bool saveLevelPack(const char *path, const std::vector<unsigned char> &pack);
+
+// Reading. Offsets start at LEVEL_PACK_HEADER_BYTES and are advanced past
+// each level as it is opened.
+bool loadLevelPack(const char *path, std::vector<unsigned char> &pack);
+int levelPackCount(const std::vector<unsigned char> &pack);
+bool beginPackedLevel(LevelDecoder &dec, const std::vector<unsigned char> &pack,
+                      size_t &offset);
+// Decode the next row. 'above' is the previously decoded row (NULL for the
+// first) and may be the same buffer as 'row' when streaming through one row.
+void decodePackedRow(LevelDecoder &dec, unsigned char *row,
+                     const unsigned char *above);
+bool unpackLevel(const std::vector<unsigned char> &pack, size_t &offset,
+                 TileGrid &grid);
+bool loadLevelFromPack(const char *path, int index, TileGrid &grid);
+
+#endif
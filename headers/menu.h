@@ -11,6 +11,7 @@ extern int windowHeight;
 
 // Menu functions
 void drawMenu();
+void drawMenuCore(); // With the core renderer (render.h)
 void mouseClick(int button, int state, int x, int y);
 void renderText(float x, float y, const char *text, void *font);
 
@@ -0,0 +1,131 @@
+#ifndef PLATFORM_H
+#define PLATFORM_H
+
+#include "platformmesh.h"
+#include "render.h"
+#include <vector>
+
+// The platform drawn from vertex buffers: one draw per chunk for the tile
+// faces, instead of a matrix, material and cube per tile. A fragment
+// shader draws the cyan edges in the same pass, shading the pixels along
+// the tile boundaries, so no lines are drawn and the lighting is never
+// switched off for them. Without GLSL the edges are drawn as lines after
+// the faces. Chunks whose bounds fall outside the view frustum (taken from
+// the current projection and modelview) are skipped. Needs the GL context.
+//
+// Chunks further away draw with less detail, picked by how many pixels a
+// tile covers there: full cubes, then tops only (no sides), then one quad
+// over the chunk textured with a texel per tile. A chunk goes
+// back to more detail only once comfortably past the threshold, so one
+// near the boundary does not flicker between levels.
+//
+// The tiles are translucent, so with PLATFORM_SORT they are drawn back to
+// front: coarser levels of detail (further away) first, chunks in an order
+// that only changes when the view turns into another octant (45 degrees
+// around the vertical), and each full chunk's faces from an element buffer
+// radix sorted by distance from the eye. A chunk is only sorted again once
+// the eye has moved or the chunk was rebuilt, so a still camera sorts
+// nothing. The instanced path gets the chunk order only.
+//
+// Baked faces and the tile map hold their lighting already (see
+// platformmesh.h) and draw unlit, so the light must stay put in the world.
+// The shaders are GLSL 1.20 so they run on legacy contexts. The instanced
+// path (which also needs ARB_instanced_arrays) draws one unit cube per
+// slot, placed from the slot's cell, coloured from a uniform table by tile
+// type and lit as the fixed pipeline would from GL_LIGHT0 and the current
+// material.
+//
+// With the core renderer (render.h) the baked path is drawn by
+// platformDrawView() instead: the same chunks and fragment shaders, the
+// camera read from the Scene block, and quads drawn as indexed triangles.
+// Instanced is legacy only.
+
+// Per chunk, baked: buffer names (0 while the chunk is empty, edges only
+// without the face shader) and vertices in each, and with PLATFORM_SORT
+// the faces' indices back to front from the eye they were sorted for
+struct ChunkBuffers {
+  unsigned int faces, edges;
+  int faceVertices, topVertices, edgeVertices;
+  unsigned int order; // 0 until first sorted
+  bool sorted;        // 'order' matches the faces
+  float sortEye[3];
+};
+
+enum PlatformLod { LOD_FULL, LOD_TOPS, LOD_FLAT, LOD_LEVELS };
+
+// What the last draw did
+struct PlatformStats {
+  int drawCalls;
+  int chunksDrawn, chunksCulled; // Chunks with tiles only
+  int chunksAt[LOD_LEVELS];      // Drawn chunks by detail
+  int bakedVertices; // Drawn with their lighting baked, none worked out
+  int chunksSorted;  // Chunks whose faces were sorted again
+};
+
+// platformDraw() options
+enum {
+  PLATFORM_CULL = 1, // Skip chunks out of view
+  PLATFORM_LOD = 2,  // Less detail far away (else all full)
+  PLATFORM_SORT = 4  // Back to front, for the translucent tiles
+};
+
+struct PlatformBuffers {
+  bool core; // Set before uploading for a core context; kept on release
+  bool instanced;
+  int slots; // Slots the buffers hold
+
+  std::vector<ChunkBuffers> chunks; // Baked
+  std::vector<unsigned char> lods;  // Per chunk, as last drawn
+  std::vector<int> chunkOrder;      // Back to front for 'octant'
+  int octant;
+  unsigned int faceProgram;         // 0 without GLSL
+
+  // Far chunks: the tile map texture (0 if they cannot be drawn flat), a
+  // quad over each chunk's bounds, and their shader
+  unsigned int map, flat;
+  size_t mapBytes;
+  unsigned int flatProgram;
+
+  // Instanced: the unit cube's faces, the slots' cells and types, their
+  // visibility bytes, and the shader
+  unsigned int cube, instances, visible;
+  unsigned int program;
+
+  // Core: triangle indices for the largest chunk's quads (or every flat
+  // quad)
+  unsigned int quadIndices;
+  int quadIndexCount; // Quads
+};
+
+// The transform platformDrawView() draws with, instead of GL's matrices
+struct PlatformView {
+  Mat4 projection, view;
+  Mat4 model; // Grid units to world
+  int viewportHeight;
+};
+
+// True if the context can draw instanced (checked once, with the reason
+// printed when it cannot)
+bool platformInstancingSupported();
+
+// Upload the whole mesh (after meshBuild() or meshBuildInstances())
+void platformUpload(PlatformBuffers &buffers, const PlatformMesh &mesh);
+// Upload what meshSyncToggles() or meshSyncCells() changed: baked, the
+// rebuilt chunks; instanced, the slots' instances and visibility bytes,
+// adjacent slots as one range
+void platformUpdate(PlatformBuffers &buffers, const PlatformMesh &mesh,
+                    std::vector<int> &changed);
+// Draw in grid units (see platformmesh.h) with the current transform and
+// the given PLATFORM_ options. 'stats' may be NULL.
+void platformDraw(PlatformBuffers &buffers, const PlatformMesh &mesh,
+                  int options, PlatformStats *stats);
+// The same with the core renderer, after renderBeginFrame()
+void platformDrawView(PlatformBuffers &buffers, const PlatformMesh &mesh,
+                      const PlatformView &view, int options,
+                      PlatformStats *stats);
+// Bytes of buffer memory in use
+size_t platformBufferBytes(const PlatformBuffers &buffers);
+// Delete every buffer and shader
+void platformRelease(PlatformBuffers &buffers);
+
+#endif
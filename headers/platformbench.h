@@ -0,0 +1,22 @@
+#ifndef PLATFORMBENCH_H
+#define PLATFORMBENCH_H
+
+#include "platform.h"
+
+// --platform-bench: build, upload, draw and toggle times of the baked and
+// instanced platform on generated levels, printed as tables. Draws into the
+// current GL context with its own camera, so only the platform shows.
+
+// What the bench draws with, as the game would
+struct PlatformBenchSetup {
+  bool core;         // The core renderer is up (render.h)
+  int width, height; // Window size
+  float cameraAngleX, cameraAngleY, cameraDistance; // Starting camera
+  MeshLight meshLight; // Baked into the faces
+  RenderLight light;   // GL_LIGHT0, or the Scene block
+};
+
+// Run every table (takes a while on large levels)
+void platformBench(const PlatformBenchSetup &setup);
+
+#endif
@@ -0,0 +1,123 @@
+#ifndef PLATFORMMESH_H
+#define PLATFORMMESH_H
+
+#include "sim.h"
+#include <utility>
+#include <vector>
+
+// Platform geometry, built once per level for the vertex buffers (see
+// platform.h). No GL here. Positions are whole grid units (x = column,
+// z = row, tile tops at y = 0 and bottoms at y = -1), so they fit in shorts
+// and the draw centres the whole platform with one translation.
+//
+// The level is cut into CHUNK_TILES x CHUNK_TILES chunks, each with the
+// bounds of its tiles so the draw can skip chunks out of view. The mesh is
+// built one of two ways:
+//   baked      each chunk holds its own faces and edges. Faces between two
+//              shown tiles are dropped and runs of one type share a quad
+//              (rectangles on top, strips on the sides); edges are each
+//              boundary line once, merged into runs, leaving out the ones
+//              buried inside the platform. A toggle or an edited cell
+//              rebuilds the chunks holding the tiles and their neighbours.
+//   instanced  every tile gets a slot holding its cell and type (8 bytes)
+//              and a visibility byte. Slots are numbered chunk by chunk, so
+//              a chunk is one range of instances; a toggle rewrites just the
+//              bridges' bytes.
+// Bottom faces are never built: the camera pitch stays above the platform.
+//
+// For chunks far enough away that only their colours matter, 'map' holds
+// the colour of each cell's shown tile, lit as its top (alpha 0 for none).
+//
+// The platform never moves and neither does the light, so the baked faces
+// carry their lighting: each vertex colour is worked out once here, as the
+// fixed pipeline would light it, and drawn unlit. Side corners next to a
+// tile diagonally in front of them (a concave corner) get less ambient
+// light, and strips are split there so the darkening stays within one
+// tile. The instanced path still lights its cubes in the shader.
+
+const int CHUNK_TILES = 32;
+const int TILE_FACE_VERTICES = 20; // 5 quads
+const int TILE_EDGE_VERTICES = 24; // 12 lines
+const int TILE_TOP_VERTEX = 8;     // First vertex of the top face
+
+struct MeshPoint {
+  short x, y, z, w;
+};
+
+struct MeshVertex {
+  MeshPoint position;
+  signed char normal[4];   // 127 = 1.0, last byte unused
+  unsigned char color[4];  // RGBA, lit (meshWriteCube(): the tile colour)
+};
+
+struct TileInstance {
+  short col, row;
+  unsigned char type; // Tile type as authored (the start tile as 1)
+  unsigned char pad[3];
+};
+
+struct MeshChunk {
+  int row0, col0, rows, cols; // Cells covered
+  int tiles;                  // Cells with a tile in the authored level
+  int minRow, minCol, maxRow, maxCol; // Bounds of those tiles (max is one
+                                      // past the last), y from -1 to 0
+
+  // Baked: tops first, then sides
+  std::vector<MeshVertex> faces;
+  int topVertices;
+  std::vector<MeshPoint> edges; // Drawn only without the face shader
+
+  // Instanced: slots firstSlot .. firstSlot + tiles - 1
+  int firstSlot;
+};
+
+// A directional light as it falls on the tiles
+struct MeshLight {
+  float direction[3]; // Towards the light, along the grid axes
+  float ambient[3];   // Light reaching every face (times the material's)
+  float diffuse[3];   // Times the tile colour and the cosine
+};
+
+struct PlatformMesh {
+  bool instanced;
+  MeshLight light; // Baked into the faces and the map
+  int rows, cols;
+  int chunkRows, chunkCols;
+  std::vector<MeshChunk> chunks; // Row-major
+  std::vector<bool> groupVisible; // Toggle state the mesh was built with
+  std::vector<bool> dirty;        // Per chunk, while syncing
+  std::vector<unsigned char> map; // RGBA per cell, row-major
+
+  // Instanced
+  int slotCount;
+  std::vector<int> slots; // Per cell (row * cols + col), -1 for none
+  std::vector<TileInstance> instances;
+  std::vector<unsigned char> visible; // 1 while the tile is shown
+};
+
+// Build the mesh from the level, baked or instanced, lit by 'light'
+void meshBuild(PlatformMesh &mesh, const SimState &sim,
+               const MeshLight &light);
+void meshBuildInstances(PlatformMesh &mesh, const SimState &sim,
+                        const MeshLight &light);
+// Bring the mesh up to date with toggle groups flipped since the last build
+// or sync. Appends to 'changed' the chunks rebuilt (baked) or the slots
+// rewritten (instanced).
+void meshSyncToggles(PlatformMesh &mesh, const SimState &sim,
+                     std::vector<int> &changed);
+// Bring the mesh up to date with cells edited in place ({row, col}, the
+// toggle table possibly rebuilt). Appends to 'changed' as above. False if
+// only a full build can: the size changed, or an instanced tile appeared or
+// went away.
+bool meshSyncCells(PlatformMesh &mesh, const SimState &sim,
+                   const std::vector<std::pair<int, int> > &cells,
+                   std::vector<int> &changed);
+
+// Diffuse colour (RGBA) of a tile type; types past the table draw as 1
+const int MESH_TILE_TYPES = 6;
+const unsigned char *meshTileColor(int tile);
+// Faces and edges of one whole tile, as the instanced path draws it
+void meshWriteCube(MeshVertex *faces, MeshPoint *edges, int row, int col,
+                   int tile);
+
+#endif
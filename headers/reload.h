@@ -0,0 +1,12 @@
+#ifndef RELOAD_H
+#define RELOAD_H
+
+// Level file hot-reload. On Linux the file's directory is watched with
+// inotify (editors often save by renaming a temp file over the original);
+// elsewhere the modification time is polled instead.
+bool startLevelWatch(const char *path); // Begin watching a level file
+bool pollLevelWatch();                  // Non-blocking, true if file changed
+double levelFileAgeMs(); // Milliseconds since the file was last written
+void stopLevelWatch();
+
+#endif
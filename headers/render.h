@@ -0,0 +1,101 @@
+#ifndef RENDER_H
+#define RENDER_H
+
+#include <vector>
+
+// The core-profile renderer (--renderer core): GL 3.3 core, everything drawn
+// from vertex buffers with shaders, so frame times can be compared against
+// the legacy fixed-function path. Nothing here touches the matrix stacks,
+// GL_LIGHT0 or the material; the camera and the light live in one uniform
+// buffer (the Scene block below) that every 3D shader reads, and the
+// shaders light as the fixed pipeline did (Gouraud, one directional light,
+// no normalising) so both paths look the same. GLUT's fonts need the legacy
+// pipeline, so text is drawn from a built-in 5x7 pixel font instead.
+//
+// The platform draws itself (platformDrawView() in platform.h) with
+// programs from renderProgram().
+
+// Column-major, as GL
+struct Mat4 {
+  float m[16];
+};
+
+Mat4 mat4Identity();
+Mat4 mat4Multiply(const Mat4 &a, const Mat4 &b); // a * b
+Mat4 mat4Perspective(float fovYDegrees, float aspect, float zNear, float zFar);
+Mat4 mat4LookAt(const float eye[3], const float centre[3], const float up[3]);
+Mat4 mat4Translate(float x, float y, float z);
+Mat4 mat4Rotate(float degrees, float x, float y, float z); // Unit axis
+Mat4 mat4Scale(float x, float y, float z);
+
+// The light as the legacy path sets up GL_LIGHT0 and the light model
+struct RenderLight {
+  float direction[4]; // Towards the light, world space (w 0)
+  float ambient[4], diffuse[4], specular[4];
+  float sceneAmbient[4];
+};
+
+struct RenderMaterial {
+  float ambient[4], diffuse[4], specular[4];
+  float shininess;
+};
+
+// A vertex of the block's unit cube (also drawn by the legacy path)
+struct RenderVertex {
+  float position[3], normal[3], uv[2];
+};
+const int RENDER_CUBE_VERTICES = 24; // 6 quads
+extern const RenderVertex RENDER_CUBE[RENDER_CUBE_VERTICES];
+
+struct RenderPoint {
+  float position[3];
+  float size; // Pixels
+  float color[4];
+};
+
+// The uniform block every 3D shader from renderProgram() gets, at binding
+// RENDER_SCENE_BINDING. std140; matches the buffer renderBeginFrame() fills.
+#define RENDER_SCENE_GLSL                                                    \
+  "layout(std140) uniform Scene {\n"                                       \
+  "  mat4 projection;\n"                                                   \
+  "  mat4 view;\n"                                                         \
+  "  vec4 lightDirection;\n"                                               \
+  "  vec4 lightAmbient;\n"                                                 \
+  "  vec4 lightDiffuse;\n"                                                 \
+  "  vec4 lightSpecular;\n"                                                \
+  "  vec4 sceneAmbient;\n"                                                 \
+  "};\n"
+const unsigned int RENDER_SCENE_BINDING = 0;
+
+// Build the shaders, buffers and font once the context is up. False, with
+// the reason printed, if the context cannot run them.
+bool renderInit();
+// Link a program from GLSL written with the 1.20 names (attribute, varying,
+// texture2D, writing fragColor), compiled as 3.30 core with the Scene block
+// declared in the vertex shader. Attribute i is bound to location i. 0 on
+// errors, which are printed.
+unsigned int renderProgram(const char *vertexBody, const char *fragmentBody,
+                           const char *const *attributes, int attributeCount);
+
+// Start a 3D pass: upload the camera and light (its direction taken to eye
+// space, as GL does with GL_POSITION)
+void renderBeginFrame(const Mat4 &projection, const Mat4 &view,
+                      const RenderLight &light);
+// The unit cube, lit, textured if 'texture' is not 0, its far faces drawn
+// before its near ones
+void renderBlock(const Mat4 &model, const RenderMaterial &material,
+                 unsigned int texture);
+// Unlit square points in world space
+void renderPoints(const std::vector<RenderPoint> &points);
+
+// 2D in window pixels from the bottom left. Rectangles and text are queued
+// and drawn in one call by render2DFlush(). Text sits on the baseline at y,
+// each font pixel 'scale' window pixels.
+void render2DRect(float x, float y, float width, float height,
+                  const float color[4]);
+void render2DText(float x, float y, const char *text, float scale,
+                  const float color[4]);
+float render2DTextWidth(const char *text, float scale);
+void render2DFlush(int width, int height);
+
+#endif
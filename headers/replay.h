@@ -0,0 +1,51 @@
+#ifndef REPLAY_H
+#define REPLAY_H
+
+#include "sim.h"
+#include <string>
+#include <vector>
+
+// Input logs: every move and restart of a session with the tick it was
+// applied on, and the state hash the session ended with. The rules are
+// deterministic, so replaying the inputs on the same level must end on the
+// same hash.
+//
+// Layout: "BLXR", version byte, varint name length, level name (file path or
+// built-in level number), varint pack index + 1 (0 when not a pack), u64
+// level hash, varint event bytes, events, varint final tick delta, u64 final
+// state hash. Each event is one varint: tick delta << 3 | input.
+
+struct InputLog {
+  std::string levelName;
+  int packIndex; // -1 unless the level came from a .blxp pack
+  unsigned long long levelHash;
+  std::vector<unsigned char> events;
+  unsigned int lastTick;  // Tick of the last event written
+  unsigned int finalTick; // Set by endInputLog()
+  unsigned long long finalHash;
+};
+
+// Load a level by the name a log stores: a built-in level number, a text
+// level file, or a .blxp pack and index
+bool loadNamedLevel(const char *name, int packIndex,
+                    std::vector<std::vector<int> > &layout,
+                    std::vector<SwitchDef> &switches);
+
+// Recording. Begin right after simLoadLevel() and log each applied input
+// with the tick it was applied on (sim.tick before the step).
+void beginInputLog(InputLog &log, const char *levelName, int packIndex,
+                   const SimState &sim);
+void logInput(InputLog &log, unsigned int tick, SimInput input);
+void endInputLog(InputLog &log, const SimState &sim);
+
+void encodeInputLog(const InputLog &log, std::vector<unsigned char> &out);
+bool decodeInputLog(const unsigned char *data, size_t size, InputLog &log);
+bool saveInputLog(const char *path, const InputLog &log);
+bool loadInputLog(const char *path, InputLog &log);
+
+// Replay onto 'sim', which must hold the freshly loaded level. Returns true
+// if every input applied on its tick and the final hash matches. 'moves'
+// gets the number of inputs replayed.
+bool replayInputLog(const InputLog &log, SimState &sim, long long &moves);
+
+#endif
@@ -0,0 +1,64 @@
+#ifndef REWIND_H
+#define REWIND_H
+
+#include "sim.h"
+#include <vector>
+
+// Rewind history: one frame per game tick, holding the block, the win flag,
+// the camera targets and the toggle groups' visibility, so holding the
+// rewind key can play recent ticks backwards.
+//
+// A frame is a list of ints (see rewindCapture()). Every keyframeTicks-th
+// frame is stored whole, as a keyframe; the frames after it store only the
+// fields that changed, a (field gap, zigzag difference) varint pair each.
+// A tick where the block just rolls on costs 3 bytes, an idle tick 1.
+// Frames live in a fixed ring of segments, each a keyframe and the deltas up
+// to the next one. A full ring drops its oldest segment and reuses its
+// buffer, so memory stops growing once the ring has wrapped, and reaching
+// any kept tick decodes at most one segment.
+
+const int REWIND_KEYFRAME_TICKS = 64;
+
+struct RewindSegment {
+  unsigned int firstTick;
+  int frames;
+  std::vector<unsigned char> bytes; // A keyframe, then a delta per frame
+};
+
+struct RewindHistory {
+  int keyframeTicks;
+  std::vector<RewindSegment> segments; // Ring
+  int first, count;                    // Oldest segment, segments in use
+  std::vector<int> newest;             // Fields of the newest frame
+  unsigned int newestTick;
+  std::vector<int> scratch;            // Changed fields, while encoding
+};
+
+// Keep at least 'seconds' of ticks
+void rewindInit(RewindHistory &history, double seconds,
+                int keyframeTicks = REWIND_KEYFRAME_TICKS);
+void rewindClear(RewindHistory &history);
+// Add the frame for 'tick'. A tick that does not follow the newest frame, or
+// a different number of fields (another level), starts the history over.
+void rewindRecord(RewindHistory &history, unsigned int tick,
+                  const std::vector<int> &fields);
+// Decode the frame for 'tick'; false if it is not kept
+bool rewindSeek(const RewindHistory &history, unsigned int tick,
+                std::vector<int> &fields);
+// Drop the newest frame and return the one before it (now the newest). False
+// once only the oldest kept frame is left.
+bool rewindPop(RewindHistory &history, std::vector<int> &fields,
+               unsigned int &tick);
+
+unsigned int rewindTicks(const RewindHistory &history); // Frames kept
+size_t rewindBytes(const RewindHistory &history);       // Buffers allocated
+
+// The game state a frame holds. camera[] is the camera targets (angle X,
+// angle Y, distance).
+void rewindCapture(const SimState &sim, const float camera[3],
+                   std::vector<int> &fields);
+// Put a captured frame back; false if it was taken on another level
+bool rewindRestore(SimState &sim, float camera[3],
+                   const std::vector<int> &fields);
+
+#endif
@@ -0,0 +1,118 @@
+#ifndef SIM_H
+#define SIM_H
+
+#include "levelfile.h"
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+// Game rules with no GL or GLUT: block rolling and its animation, falling,
+// switches and the win check. Everything lives in a SimState, so any number
+// of games can run side by side, with or without a window.
+
+const double SIM_TICK_SECONDS = 0.016; // One tick of the 60 FPS timer
+
+// Timing in ticks. Floats here are only for drawing: a roll is at
+// animationTick * BLOCK_ANIMATION_SPEED of the way, and a falling block has
+// dropped FALL_GRAVITY * n * (n + 1) / 2 after n ticks.
+const float BLOCK_ANIMATION_SPEED = 0.08f;
+const int BLOCK_ANIMATION_TICKS = 13; // First tick at which the roll is done
+const float FALL_GRAVITY = 0.02f;
+const int FALL_RESET_TICKS = 33;      // About 10 units down
+
+enum BlockOrientation { STANDING, LYING_X, LYING_Z };
+
+// Logical block state only; drawBlock() derives the pivot, rotation and
+// height from it
+struct Block {
+  // Top-left cell of the footprint: STANDING covers (row, col), LYING_X
+  // also (row, col + 1) and LYING_Z also (row + 1, col)
+  int row, col;
+  BlockOrientation orientation;
+
+  // Roll in progress from the previous cell and orientation
+  bool isAnimating;
+  int animationTick; // Ticks since the roll started
+  int fromRow, fromCol;
+  BlockOrientation fromOrientation;
+  int moveDx, moveDz; // Direction of the roll (-1, 0 or 1)
+
+  // Fall state
+  bool isFalling;
+  int fallTick; // Ticks since the fall started
+};
+
+// Toggle groups: each action tile (5) flips a set of bridge tiles (4). Taken
+// from the level file's @switch lines, or else each action tile gets the
+// bridge run nearest to it.
+struct ToggleGroup {
+  int actionRow, actionCol;
+  std::vector<std::pair<int, int> > tiles; // {row, col} of each bridge tile
+  bool visible;                            // Bridges start hidden
+};
+
+enum SimInput { INPUT_NONE, INPUT_LEFT, INPUT_RIGHT, INPUT_UP, INPUT_DOWN,
+                INPUT_RESET, INPUT_UNDO, INPUT_REDO };
+
+struct SimState {
+  std::vector<std::vector<int> > layout; // Live tiles (hidden bridges are 0)
+  std::vector<std::vector<int> > source; // Level exactly as authored
+  std::vector<SwitchDef> switches;       // @switch lines of the level file
+  int rows, cols;
+  int startRow, startCol;
+  int tileCount; // Non-empty tiles in layout, kept current as tiles change
+  std::vector<ToggleGroup> toggleGroups;
+  Block block;
+  bool won;
+  unsigned int tick;  // Ticks run since the level was loaded
+  double pendingTime; // Time not yet consumed by simUpdate()
+
+  // Undo and redo stacks. Each landed move pushes a delta: the block's
+  // cell and orientation before the move and the toggle groups the landing
+  // flipped, a varint each, followed by the delta's length (a varint
+  // written backwards, so the stack pops from the end). Undo restores the
+  // block, flips the groups back and pushes the state it replaced onto the
+  // redo stack; redo does the reverse. A new move clears the redo stack
+  // and a restart clears both.
+  std::vector<unsigned char> undoBytes, redoBytes;
+  int undoCount, redoCount;
+  int moveFrom; // Packed state the roll in progress started from
+};
+
+// Load a level (tile 9 marks the start) and place the block on it
+void simLoadLevel(SimState &sim, const std::vector<std::vector<int> > &layout,
+                  const std::vector<SwitchDef> &switches);
+
+// Run one fixed tick. Moves are ignored while the block is animating or
+// falling; reset restarts the level. Undo and redo apply when the block is
+// at rest or falling (undo stops the fall at once), as long as there is a
+// step to take. Returns true if the input was applied.
+bool simStep(SimState &sim, SimInput input);
+// Run as many whole ticks as fit in 'dt' seconds (carrying the remainder),
+// applying 'input' on the first one. Returns the number of ticks run;
+// 'applied' is set if the input was applied.
+int simUpdate(SimState &sim, double dt, SimInput input, bool *applied = NULL);
+
+// True when the block can take a move input
+bool simIdle(const SimState &sim);
+
+// FNV-1a hashes: the authored level (tiles and switches), and the game state
+// that replays must reproduce (tick, block, bridges, win)
+unsigned long long simLevelHash(const SimState &sim);
+unsigned long long simStateHash(const SimState &sim);
+
+// Rules helpers, also used when a level is edited in place
+int simTileAt(const SimState &sim, int row, int col); // 0 when out of bounds
+// Second cell of the footprint (the block's own cell when standing)
+void simSecondCell(const Block &block, int &row, int &col);
+void simMoveBlock(SimState &sim, SimInput direction);
+bool simBlockShouldFall(const SimState &sim);
+void simResetBlock(SimState &sim);
+void simFindStart(SimState &sim);
+void simBuildToggleGroups(SimState &sim);
+void simHideBridges(SimState &sim);
+void simSetGroupVisible(SimState &sim, ToggleGroup &group, bool visible);
+int simCountTiles(const SimState &sim);
+void simClearHistory(SimState &sim); // Drop every undo and redo step
+
+#endif
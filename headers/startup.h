@@ -0,0 +1,17 @@
+#ifndef STARTUP_H
+#define STARTUP_H
+
+#include <chrono>
+
+// Startup trace: when each phase ran, measured from process start (the
+// earliest static constructor). Phases may run on background threads.
+typedef std::chrono::steady_clock::time_point StartupTime;
+
+StartupTime startupProcessStart();
+void startupRecord(const char *phase, StartupTime begin,
+                   bool background = false); // Phase ran from 'begin' to now
+void startupFirstFrame(); // Call once the first frame is on screen
+bool startupFrameShown();
+void printStartupTrace(); // Phases and time-to-first-frame (run at exit)
+
+#endif
@@ -0,0 +1,23 @@
+#ifndef TEXTURE_H
+#define TEXTURE_H
+
+#include <string>
+#include <vector>
+
+// Texture loading split so the slow parts can run off the GL thread: decode
+// and mipmap generation need no GL context, only the upload does.
+struct TextureImage {
+  int width, height, channels;              // Of the base level (3 or 4)
+  std::vector<std::vector<unsigned char> > levels; // Base level first
+  std::string error;
+};
+
+// Decode, flip for GL, expand grey to RGB(A) and scale to a power of two
+// (thread-safe as long as SOIL is not used elsewhere at the same time)
+bool decodeTexture(const char *path, TextureImage &image);
+// Box-filter the rest of the mip chain down to 1x1
+void generateMipmaps(TextureImage &image);
+// Upload every level to a new repeating texture. Needs the GL context.
+unsigned int uploadTexture(const TextureImage &image);
+
+#endif
@@ -1,12 +1,12 @@
 #ifndef WIN_H
 #define WIN_H
 
-// Win state
+// Win state (copied from the game each tick)
 extern bool hasWon;
 
 // Win functions
-void checkWinCondition(); // Check if block is standing on goal tile
 void drawWinScreen();     // Draw the "You Won" overlay
+void drawWinScreenCore(); // The same with the core renderer (render.h)
 void resetWinState();     // Reset win state for new game
 
 #endif
@@ -0,0 +1,202 @@
+// Headless driver for the game rules. No window or GL needed, so it runs on
+// build machines and as fast as the CPU allows.
+//
+//   ./headless <level> [moves] [--record out.blxr]
+//       Play moves (L R U D, X = restart, Z = undo, Y = redo) and print
+//       where the block ends up
+//   ./headless <level> --random [ticks] [--record out.blxr]
+//       Random play: ticks per second and speed-up over real time
+//   ./headless --verify <log.blxr>...
+//       Replay input logs at full speed and check their final state hashes
+//
+// <level> is a level file (text, or a .blxp pack followed by the index) or
+// the number of a built-in level.
+#include "headers/replay.h"
+#include "headers/sim.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <string>
+#include <vector>
+
+typedef std::chrono::steady_clock Clock;
+
+static const char *orientationNames[3] = {"standing", "lying x", "lying z"};
+
+static void printState(const SimState &sim) {
+  const Block &block = sim.block;
+  printf("tick %u (%.2f s of play): row %d col %d, %s%s%s\n", sim.tick,
+         sim.tick * SIM_TICK_SECONDS, block.row, block.col,
+         orientationNames[block.orientation],
+         block.isFalling ? ", falling" : "", sim.won ? ", WON" : "");
+}
+
+// Feed each move as soon as the block can take it
+static int playMoves(SimState &sim, const char *moves, InputLog *log) {
+  int falls = 0;
+  for (const char *m = moves; *m; m++) {
+    SimInput input;
+    switch (*m) {
+    case 'L': input = INPUT_LEFT; break;
+    case 'R': input = INPUT_RIGHT; break;
+    case 'U': input = INPUT_UP; break;
+    case 'D': input = INPUT_DOWN; break;
+    case 'X': input = INPUT_RESET; break;
+    case 'Z': input = INPUT_UNDO; break;
+    case 'Y': input = INPUT_REDO; break;
+    default: continue;
+    }
+    // The block is at rest, so only an undo or redo with nothing to take
+    // is not applied
+    unsigned int tick = sim.tick;
+    if (simStep(sim, input) && log)
+      logInput(*log, tick, input);
+    while (!simIdle(sim)) {
+      bool falling = sim.block.isFalling;
+      simStep(sim, INPUT_NONE);
+      falls += falling && !sim.block.isFalling;
+    }
+  }
+  printState(sim);
+  printf("falls %d, undo history %d steps in %d bytes (%d to redo)\n", falls,
+         sim.undoCount, (int)sim.undoBytes.size(), sim.redoCount);
+  return sim.won ? 0 : 2;
+}
+
+static int playRandom(SimState &sim, long long ticks, InputLog *log) {
+  unsigned int state = 12345;
+  long long moves = 0, wins = 0, falls = 0;
+  Clock::time_point start = Clock::now();
+  for (long long t = 0; t < ticks; t++) {
+    SimInput input = INPUT_NONE;
+    if (simIdle(sim)) {
+      state ^= state << 13;
+      state ^= state >> 17;
+      state ^= state << 5;
+      input = (SimInput)(INPUT_LEFT + state % 4);
+      if (sim.won) {
+        input = INPUT_RESET;
+        wins++;
+      }
+    }
+    bool falling = sim.block.isFalling;
+    unsigned int tick = sim.tick;
+    if (simStep(sim, input)) {
+      moves += input != INPUT_RESET;
+      if (log)
+        logInput(*log, tick, input);
+    }
+    falls += falling && !sim.block.isFalling;
+  }
+  double seconds =
+      std::chrono::duration<double>(Clock::now() - start).count();
+  printf("%lld ticks in %.3f s: %.1f M ticks/s, %.0fx real time\n", ticks,
+         seconds, ticks / seconds / 1e6, ticks * SIM_TICK_SECONDS / seconds);
+  printf("%lld moves, %lld falls, %lld wins\n", moves, falls, wins);
+  return 0;
+}
+
+// Replay every log, loading each level once
+static int verifyLogs(int count, char **paths) {
+  std::map<std::string, SimState> levels;
+  long long moves = 0, ticks = 0;
+  int failed = 0;
+  double seconds = 0.0;
+  for (int n = 0; n < count; n++) {
+    InputLog log;
+    if (!loadInputLog(paths[n], log)) {
+      failed++;
+      continue;
+    }
+    char key[32];
+    snprintf(key, sizeof(key), "#%d", log.packIndex);
+    std::map<std::string, SimState>::iterator level =
+        levels.find(log.levelName + key);
+    if (level == levels.end()) {
+      std::vector<std::vector<int> > layout;
+      std::vector<SwitchDef> switches;
+      if (!loadNamedLevel(log.levelName.c_str(), log.packIndex, layout,
+                          switches)) {
+        printf("%s: cannot load level %s\n", paths[n], log.levelName.c_str());
+        failed++;
+        continue;
+      }
+      level = levels.insert(std::make_pair(log.levelName + key, SimState()))
+                  .first;
+      simLoadLevel(level->second, layout, switches);
+    }
+
+    SimState sim = level->second;
+    long long logMoves;
+    Clock::time_point start = Clock::now();
+    bool ok = replayInputLog(log, sim, logMoves);
+    seconds += std::chrono::duration<double>(Clock::now() - start).count();
+    moves += logMoves;
+    ticks += sim.tick;
+    if (!ok) {
+      printf("%s: MISMATCH at tick %u (%lld inputs replayed)\n", paths[n],
+             sim.tick, logMoves);
+      failed++;
+    }
+  }
+  printf("%d logs, %d failed: %lld inputs, %lld ticks in %.3f s", count,
+         failed, moves, ticks, seconds);
+  if (seconds > 0.0)
+    printf(" (%.2f M inputs/s, %.1f M ticks/s)", moves / seconds / 1e6,
+           ticks / seconds / 1e6);
+  printf("\n");
+  return failed ? 1 : 0;
+}
+
+int main(int argc, char **argv) {
+  if (argc > 1 && strcmp(argv[1], "--verify") == 0) {
+    return verifyLogs(argc - 2, argv + 2);
+  }
+  const char *recordPath = NULL;
+  if (argc > 3 && strcmp(argv[argc - 2], "--record") == 0) {
+    recordPath = argv[argc - 1];
+    argc -= 2;
+  }
+  if (argc < 2) {
+    printf("Usage: %s <level> [moves] [--record out.blxr]\n", argv[0]);
+    printf("       %s <level> --random [ticks] [--record out.blxr]\n",
+           argv[0]);
+    printf("       %s --verify <log.blxr>...\n", argv[0]);
+    return 1;
+  }
+
+  // A .blxp pack is followed by the level index
+  const char *levelName = argv[1];
+  int packIndex = -1, argi = 2;
+  size_t len = strlen(levelName);
+  if (len > 5 && strcmp(levelName + len - 5, ".blxp") == 0) {
+    packIndex = argi < argc ? atoi(argv[argi++]) : 0;
+  }
+  std::vector<std::vector<int> > layout;
+  std::vector<SwitchDef> switches;
+  if (!loadNamedLevel(levelName, packIndex, layout, switches)) {
+    printf("Could not load level %s\n", levelName);
+    return 1;
+  }
+  SimState sim;
+  simLoadLevel(sim, layout, switches);
+  InputLog log;
+  beginInputLog(log, levelName, packIndex, sim);
+
+  int result;
+  if (argi < argc && strcmp(argv[argi], "--random") == 0) {
+    result = playRandom(sim, argi + 1 < argc ? atoll(argv[argi + 1]) : 10000000,
+                        recordPath ? &log : NULL);
+  } else {
+    result = playMoves(sim, argi < argc ? argv[argi] : "",
+                       recordPath ? &log : NULL);
+  }
+  if (recordPath) {
+    endInputLog(log, sim);
+    if (!saveInputLog(recordPath, log))
+      return 1;
+  }
+  return result;
+}
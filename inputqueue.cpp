@@ -0,0 +1,87 @@
+#include "headers/inputqueue.h"
+#include <algorithm>
+#include <cstdio>
+
+void inputQueueInit(InputQueue &queue, int depth, int coalesceMs) {
+  queue.head = 0;
+  queue.tail = 0;
+  queue.depth = std::max(1, std::min(depth, INPUT_QUEUE_CAPACITY));
+  queue.coalesceMs = std::max(0, coalesceMs);
+  queue.lastInput = INPUT_NONE;
+  queue.dropped = queue.coalesced = queue.cleared = 0;
+  queue.moves = 0;
+  queue.maxLatencyMs = 0.0f;
+}
+
+bool inputQueuePush(InputQueue &queue, SimInput input, InputTime pressed) {
+  unsigned int tail = queue.tail.load(std::memory_order_relaxed);
+  unsigned int head = queue.head.load(std::memory_order_acquire);
+
+  // The newest entry is only read here, never written, so it does not
+  // matter if the consumer takes it meanwhile: the repeat is dropped either
+  // way
+  bool repeat = input == queue.lastInput &&
+                pressed - queue.lastPressed <
+                    std::chrono::milliseconds(queue.coalesceMs);
+  queue.lastInput = input;
+  queue.lastPressed = pressed;
+  if (repeat && tail != head &&
+      queue.entries[(tail - 1) % INPUT_QUEUE_CAPACITY].input == input) {
+    queue.coalesced++;
+    return true;
+  }
+
+  if (tail - head >= (unsigned int)queue.depth) {
+    queue.dropped++;
+    return false;
+  }
+  QueuedInput &entry = queue.entries[tail % INPUT_QUEUE_CAPACITY];
+  entry.input = input;
+  entry.pressed = pressed;
+  queue.tail.store(tail + 1, std::memory_order_release);
+  return true;
+}
+
+bool inputQueuePeek(const InputQueue &queue, QueuedInput &entry) {
+  unsigned int head = queue.head.load(std::memory_order_relaxed);
+  if (head == queue.tail.load(std::memory_order_acquire))
+    return false;
+  entry = queue.entries[head % INPUT_QUEUE_CAPACITY];
+  return true;
+}
+
+void inputQueueMoveStarted(InputQueue &queue) {
+  unsigned int head = queue.head.load(std::memory_order_relaxed);
+  if (head == queue.tail.load(std::memory_order_acquire))
+    return;
+  float ms = std::chrono::duration<float, std::milli>(
+                 std::chrono::steady_clock::now() -
+                 queue.entries[head % INPUT_QUEUE_CAPACITY].pressed)
+                 .count();
+  queue.latencies[queue.moves++ % INPUT_LATENCY_SAMPLES] = ms;
+  queue.maxLatencyMs = std::max(queue.maxLatencyMs, ms);
+  queue.head.store(head + 1, std::memory_order_release);
+}
+
+void inputQueueClear(InputQueue &queue) {
+  unsigned int tail = queue.tail.load(std::memory_order_acquire);
+  queue.cleared += tail - queue.head.load(std::memory_order_relaxed);
+  queue.head.store(tail, std::memory_order_release);
+}
+
+void printInputQueueStats(const InputQueue &queue) {
+  printf("Input queue (depth %d, coalescing %d ms): %u moves, %u dropped, "
+         "%u merged, %u cleared by falls and wins\n",
+         queue.depth, queue.coalesceMs, queue.moves, queue.dropped,
+         queue.coalesced, queue.cleared);
+  if (queue.moves == 0)
+    return;
+  unsigned int kept =
+      std::min(queue.moves, (unsigned int)INPUT_LATENCY_SAMPLES);
+  std::vector<float> sorted(queue.latencies, queue.latencies + kept);
+  std::sort(sorted.begin(), sorted.end());
+  printf("  key press to move start: median %.1f ms, p90 %.1f ms%s, max "
+         "%.1f ms\n",
+         sorted[kept / 2], sorted[kept * 9 / 10],
+         kept < queue.moves ? " (recent moves)" : "", queue.maxLatencyMs);
+}
@@ -0,0 +1,386 @@
+#include "headers/levelfile.h"
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <thread>
+#include <unistd.h>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+// Convert up to 'count' ASCII digits to tile codes. Returns the index of the
+// first non-digit, or 'count' if they were all digits. Sixteen characters
+// are classified per step and the ragged end of a row is covered by one
+// overlapping block; only a block holding a non-digit falls back to the
+// scalar loop to find it.
+static size_t convertDigits(const char *src, unsigned char *dst,
+                            size_t count) {
+  size_t i = 0;
+#if defined(__SSE2__)
+  const __m128i zero = _mm_set1_epi8('0');
+  const __m128i nine = _mm_set1_epi8(9);
+  for (; i + 16 <= count; i += 16) {
+    __m128i v =
+        _mm_sub_epi8(_mm_loadu_si128((const __m128i *)(src + i)), zero);
+    __m128i ok = _mm_cmpeq_epi8(_mm_max_epu8(v, nine), nine);
+    if (_mm_movemask_epi8(ok) != 0xFFFF)
+      break;
+    _mm_storeu_si128((__m128i *)(dst + i), v);
+  }
+  if (i < count && count >= 16 && i + 16 > count) {
+    size_t last = count - 16;
+    __m128i v =
+        _mm_sub_epi8(_mm_loadu_si128((const __m128i *)(src + last)), zero);
+    __m128i ok = _mm_cmpeq_epi8(_mm_max_epu8(v, nine), nine);
+    if (_mm_movemask_epi8(ok) == 0xFFFF) {
+      _mm_storeu_si128((__m128i *)(dst + last), v);
+      return count;
+    }
+  }
+#elif defined(__ARM_NEON)
+  const uint8x16_t zero = vdupq_n_u8('0');
+  const uint8x16_t nine = vdupq_n_u8(9);
+  for (; i + 16 <= count; i += 16) {
+    uint8x16_t v = vsubq_u8(vld1q_u8((const uint8_t *)(src + i)), zero);
+    if (vminvq_u8(vcleq_u8(v, nine)) != 0xFF)
+      break;
+    vst1q_u8(dst + i, v);
+  }
+  if (i < count && count >= 16 && i + 16 > count) {
+    size_t last = count - 16;
+    uint8x16_t v = vsubq_u8(vld1q_u8((const uint8_t *)(src + last)), zero);
+    if (vminvq_u8(vcleq_u8(v, nine)) == 0xFF) {
+      vst1q_u8(dst + last, v);
+      return count;
+    }
+  }
+#endif
+  for (; i < count; i++) {
+    unsigned char d = (unsigned char)(src[i] - '0');
+    if (d > 9)
+      return i;
+    dst[i] = d;
+  }
+  return count;
+}
+
+static size_t lineEnd(const char *text, size_t pos, size_t end) {
+  const char *nl = (const char *)memchr(text + pos, '\n', end - pos);
+  return nl ? nl - text : end;
+}
+
+// Length of a line without its line break
+static size_t lineLength(const char *text, size_t pos, size_t end) {
+  size_t stop = lineEnd(text, pos, end);
+  if (stop > pos && text[stop - 1] == '\r')
+    stop--;
+  return stop - pos;
+}
+
+// Per-level parse result. Errors keep their byte offset; line and column are
+// only worked out for the one error that gets reported.
+struct LevelJob {
+  size_t begin, end;
+  bool ok;
+  size_t errorOffset;
+  std::string message;
+};
+
+static bool fail(LevelJob &job, size_t offset, const std::string &message) {
+  job.ok = false;
+  job.errorOffset = offset;
+  job.message = message;
+  return false;
+}
+
+static bool parseSwitch(const std::string &line, SwitchDef &def) {
+  const char *p = line.c_str() + 7; // Past "@switch"
+  char *next;
+  def.actionRow = strtol(p, &next, 10);
+  if (next == p)
+    return false;
+  p = next;
+  def.actionCol = strtol(p, &next, 10);
+  if (next == p)
+    return false;
+  p = next;
+  while (*p == ' ' || *p == '\t')
+    p++;
+  if (*p++ != ':')
+    return false;
+  for (;;) {
+    int row = strtol(p, &next, 10);
+    if (next == p)
+      break;
+    p = next;
+    int col = strtol(p, &next, 10);
+    if (next == p)
+      return false;
+    p = next;
+    def.tiles.push_back(std::make_pair(row, col));
+  }
+  while (*p == ' ' || *p == '\t' || *p == '\r')
+    p++;
+  return *p == '\0' && !def.tiles.empty();
+}
+
+static bool parseLevel(const char *text, LevelJob &job, LevelData &level) {
+  TileGrid &grid = level.grid;
+  grid.rows = 0;
+  grid.cols = 0;
+  grid.tiles.clear();
+  std::vector<size_t> switchOffsets;
+  size_t cols = 0;
+  size_t pos = job.begin, end = job.end;
+
+  while (pos < end) {
+    char c = text[pos];
+    if (c == '\n') {
+      pos++;
+      continue;
+    }
+    if (c == '\r' && pos + 1 < end && text[pos + 1] == '\n') {
+      pos += 2;
+      continue;
+    }
+    if (c == '#') {
+      pos = lineEnd(text, pos, end) + 1;
+      continue;
+    }
+    if (c == '@') {
+      std::string line(text + pos, lineLength(text, pos, end));
+      if (line.compare(0, 6, "@level") == 0 &&
+          (line.size() == 6 || line[6] == ' ' || line[6] == '\t')) {
+        if (grid.rows > 0 || !level.switches.empty())
+          return fail(job, pos, "@level inside a level");
+        size_t first = line.find_first_not_of(" \t", 6);
+        level.name = first == std::string::npos ? "" : line.substr(first);
+      } else if (line.compare(0, 8, "@switch ") == 0) {
+        SwitchDef def;
+        if (!parseSwitch(line, def))
+          return fail(job, pos, "expected '@switch row col : row col ...'");
+        level.switches.push_back(def);
+        switchOffsets.push_back(pos);
+      } else {
+        return fail(job, pos, "unknown directive '" + line + "'");
+      }
+      pos = lineEnd(text, pos, end) + 1;
+      continue;
+    }
+
+    // Grid row. The first row sets the width and sizes the grid for the
+    // most rows the rest of the level could hold.
+    if (cols == 0) {
+      cols = lineLength(text, pos, end);
+      grid.cols = cols;
+      grid.tiles.resize(((end - pos) / (cols + 1) + 1) * cols);
+    }
+    size_t avail = std::min(cols, end - pos);
+    size_t good =
+        convertDigits(text + pos, &grid.tiles[grid.rows * cols], avail);
+    if (good < cols) {
+      // Slow path: say whether the row was short or held a bad character
+      size_t at = pos + good;
+      if (at == end || text[at] == '\n' || text[at] == '\r') {
+        char message[64];
+        snprintf(message, sizeof(message), "row has %d tiles, expected %d",
+                 (int)good, (int)cols);
+        return fail(job, at, message);
+      }
+      return fail(job, at, std::string("unexpected '") + text[at] + "'");
+    }
+    size_t after = pos + cols;
+    if (after < end && text[after] != '\n' &&
+        !(text[after] == '\r' &&
+          (after + 1 == end || text[after + 1] == '\n'))) {
+      char message[64];
+      snprintf(message, sizeof(message), "row has %d tiles, expected %d",
+               (int)lineLength(text, pos, end), (int)cols);
+      return fail(job, after, message);
+    }
+    grid.rows++;
+    pos = after + (after < end && text[after] == '\r' ? 2 : 1);
+  }
+  grid.tiles.resize((size_t)grid.rows * cols);
+
+  if (grid.rows == 0) {
+    if (!level.switches.empty() || !level.name.empty())
+      return fail(job, job.begin, "level has no rows");
+    return true; // Only comments: not a level
+  }
+
+  // Switch tiles must be on the grid, an action tile toggling bridges
+  for (size_t s = 0; s < level.switches.size(); s++) {
+    const SwitchDef &def = level.switches[s];
+    bool inside = def.actionRow >= 0 && def.actionRow < grid.rows &&
+                  def.actionCol >= 0 && def.actionCol < grid.cols;
+    for (size_t t = 0; t < def.tiles.size(); t++) {
+      inside = inside && def.tiles[t].first >= 0 &&
+               def.tiles[t].first < grid.rows && def.tiles[t].second >= 0 &&
+               def.tiles[t].second < grid.cols;
+    }
+    if (!inside)
+      return fail(job, switchOffsets[s], "switch tile outside the grid");
+    if (grid.row(def.actionRow)[def.actionCol] != 5)
+      return fail(job, switchOffsets[s], "switch action tile is not a 5");
+    for (size_t t = 0; t < def.tiles.size(); t++) {
+      if (grid.row(def.tiles[t].first)[def.tiles[t].second] != 4)
+        return fail(job, switchOffsets[s],
+                    "switch target is not a bridge (4)");
+    }
+  }
+  return true;
+}
+
+// Byte offsets of every "@level" line in [begin, end). Grid rows never hold
+// '@', so memchr skips straight from one header to the next.
+static void findLevelStarts(const char *text, size_t size, size_t begin,
+                            size_t end, std::vector<size_t> &starts) {
+  size_t pos = begin;
+  while (pos < end) {
+    const char *at = (const char *)memchr(text + pos, '@', end - pos);
+    if (!at)
+      break;
+    size_t i = at - text;
+    if ((i == 0 || text[i - 1] == '\n') && size - i >= 6 &&
+        memcmp(at, "@level", 6) == 0 &&
+        (size - i == 6 || at[6] == ' ' || at[6] == '\t' || at[6] == '\r' ||
+         at[6] == '\n'))
+      starts.push_back(i);
+    pos = i + 1;
+  }
+}
+
+bool parseLevelText(const char *text, size_t size,
+                    std::vector<LevelData> &levels, int threads,
+                    LevelParseError &error) {
+  if (threads <= 0)
+    threads = std::max(1u, std::thread::hardware_concurrency());
+
+  // Find level boundaries, each thread scanning a newline-aligned chunk
+  std::vector<size_t> cuts(threads + 1, size);
+  cuts[0] = 0;
+  for (int t = 1; t < threads; t++) {
+    size_t cut = std::max(cuts[t - 1], size * t / threads);
+    cuts[t] = cut < size ? std::min(size, lineEnd(text, cut, size) + 1) : size;
+  }
+  std::vector<std::vector<size_t> > found(threads);
+  std::vector<std::thread> workers;
+  for (int t = 1; t < threads; t++)
+    workers.push_back(std::thread(findLevelStarts, text, size, cuts[t],
+                                  cuts[t + 1], std::ref(found[t])));
+  findLevelStarts(text, size, cuts[0], cuts[1], found[0]);
+  for (size_t w = 0; w < workers.size(); w++)
+    workers[w].join();
+  workers.clear();
+
+  std::vector<LevelJob> jobs;
+  LevelJob job = {0, size, true, 0, ""};
+  for (int t = 0; t < threads; t++) {
+    for (size_t i = 0; i < found[t].size(); i++) {
+      job.end = found[t][i];
+      if (job.end > job.begin)
+        jobs.push_back(job);
+      job.begin = job.end;
+    }
+  }
+  job.end = size;
+  if (job.end > job.begin || jobs.empty())
+    jobs.push_back(job);
+
+  // Parse whole levels in parallel, straight into their grids
+  std::vector<LevelData> parsed(jobs.size());
+  std::atomic<size_t> nextJob(0);
+  struct Worker {
+    static void run(const char *text, std::vector<LevelJob> *jobs,
+                    std::vector<LevelData> *parsed, std::atomic<size_t> *next) {
+      for (size_t j; (j = (*next)++) < jobs->size();)
+        parseLevel(text, (*jobs)[j], (*parsed)[j]);
+    }
+  };
+  int levelThreads = std::min<size_t>(threads, jobs.size());
+  for (int t = 1; t < levelThreads; t++)
+    workers.push_back(
+        std::thread(Worker::run, text, &jobs, &parsed, &nextJob));
+  Worker::run(text, &jobs, &parsed, &nextJob);
+  for (size_t w = 0; w < workers.size(); w++)
+    workers[w].join();
+
+  // Report the earliest error with its line and column
+  for (size_t j = 0; j < jobs.size(); j++) {
+    if (!jobs[j].ok) {
+      size_t offset = jobs[j].errorOffset;
+      error.line = 1 + std::count(text, text + offset, '\n');
+      const char *lineStart = text + offset;
+      while (lineStart > text && lineStart[-1] != '\n')
+        lineStart--;
+      error.column = text + offset - lineStart + 1;
+      error.message = jobs[j].message;
+      return false;
+    }
+  }
+
+  levels.clear();
+  levels.reserve(parsed.size());
+  for (size_t j = 0; j < parsed.size(); j++) {
+    if (parsed[j].grid.rows > 0) {
+      levels.push_back(LevelData());
+      std::swap(levels.back(), parsed[j]);
+    }
+  }
+  if (levels.empty()) {
+    error.line = 1;
+    error.column = 1;
+    error.message = "no levels";
+    return false;
+  }
+  return true;
+}
+
+bool importLevelText(const char *path, std::vector<LevelData> &levels,
+                     int threads) {
+  int fd = open(path, O_RDONLY);
+  if (fd < 0) {
+    printf("Level file error: cannot open '%s'\n", path);
+    return false;
+  }
+  struct stat st;
+  size_t size = fstat(fd, &st) == 0 ? st.st_size : 0;
+  const char *text = "";
+  void *mapped = MAP_FAILED;
+  if (size > 0) {
+    mapped = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (mapped == MAP_FAILED) {
+      printf("Level file error: cannot map '%s'\n", path);
+      close(fd);
+      return false;
+    }
+    text = (const char *)mapped;
+  }
+
+  LevelParseError error;
+  bool ok = parseLevelText(text, size, levels, threads, error);
+  if (!ok) {
+    printf("Level file error: %s:%d:%d: %s\n", path, (int)error.line,
+           (int)error.column, error.message.c_str());
+  }
+  if (mapped != MAP_FAILED)
+    munmap(mapped, size);
+  close(fd);
+  return ok;
+}
+
+bool loadLevelFile(const char *path, LevelData &level) {
+  std::vector<LevelData> levels;
+  if (!importLevelText(path, levels, 1))
+    return false;
+  std::swap(level, levels[0]);
+  return true;
+}
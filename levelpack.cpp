@@ -0,0 +1,469 @@
+#include "headers/levelpack.h"
+#include <cstdio>
+#include <cstring>
+
+// Range coder constants (LZMA style: 11-bit probabilities)
+const unsigned int PROB_BITS = 11;
+const unsigned int PROB_INIT = 1 << (PROB_BITS - 1);
+const unsigned int MOVE_BITS = 5;
+const unsigned int TOP_VALUE = 1 << 24;
+
+static void initRunModel(RunModel &model) {
+  unsigned short *p = &model.prefix[0][0];
+  for (size_t i = 0; i < sizeof(RunModel) / sizeof(unsigned short); i++)
+    p[i] = PROB_INIT;
+}
+
+// Encoder
+
+struct RangeEncoder {
+  unsigned long long low;
+  unsigned int range;
+  unsigned char cache;
+  unsigned long long cacheSize;
+  std::vector<unsigned char> *out;
+};
+
+static void shiftLow(RangeEncoder &enc) {
+  if ((unsigned int)enc.low < 0xFF000000u || (enc.low >> 32) != 0) {
+    unsigned char carry = (unsigned char)(enc.low >> 32);
+    unsigned char temp = enc.cache;
+    do {
+      enc.out->push_back((unsigned char)(temp + carry));
+      temp = 0xFF;
+    } while (--enc.cacheSize != 0);
+    enc.cache = (unsigned char)(enc.low >> 24);
+  }
+  enc.cacheSize++;
+  enc.low = (enc.low & 0x00FFFFFFu) << 8;
+}
+
+static void encodeBit(RangeEncoder &enc, unsigned short &prob, int bit) {
+  unsigned int bound = (enc.range >> PROB_BITS) * prob;
+  if (bit == 0) {
+    enc.range = bound;
+    prob += ((1 << PROB_BITS) - prob) >> MOVE_BITS;
+  } else {
+    enc.low += bound;
+    enc.range -= bound;
+    prob -= prob >> MOVE_BITS;
+  }
+  while (enc.range < TOP_VALUE) {
+    enc.range <<= 8;
+    shiftLow(enc);
+  }
+}
+
+static void encodeDirectBit(RangeEncoder &enc, int bit) {
+  enc.range >>= 1;
+  if (bit)
+    enc.low += enc.range;
+  while (enc.range < TOP_VALUE) {
+    enc.range <<= 8;
+    shiftLow(enc);
+  }
+}
+
+// Exp-Golomb binarisation of a run length: unary bit count with adaptive
+// bins, the two bits under the leading one modelled, the rest bypassed
+static void encodeRun(RangeEncoder &enc, RunModel &model, int ctx,
+                      unsigned int value) {
+  unsigned long long n = (unsigned long long)value + 1;
+  int k = 0;
+  while ((n >> (k + 1)) != 0)
+    k++;
+  for (int i = 0; i < k; i++)
+    encodeBit(enc, model.prefix[ctx][i], 1);
+  encodeBit(enc, model.prefix[ctx][k], 0);
+
+  int node = 0;
+  for (int b = k - 1; b >= 0; b--) {
+    int bit = (int)((n >> b) & 1);
+    int pos = k - 1 - b;
+    if (pos < 2) {
+      encodeBit(enc, model.suffix[ctx][k][node], bit);
+      node = 1 + bit;
+    } else {
+      encodeDirectBit(enc, bit);
+    }
+  }
+}
+
+static void putVarint(std::vector<unsigned char> &out, unsigned int value) {
+  while (value >= 0x80) {
+    out.push_back((unsigned char)(value | 0x80));
+    value >>= 7;
+  }
+  out.push_back((unsigned char)value);
+}
+
+static bool getVarint(const std::vector<unsigned char> &in, size_t &offset,
+                      unsigned int &value) {
+  value = 0;
+  for (int shift = 0; shift < 35 && offset < in.size(); shift += 7) {
+    unsigned char byte = in[offset++];
+    value |= (unsigned int)(byte & 0x7F) << shift;
+    if (!(byte & 0x80))
+      return true;
+  }
+  return false;
+}
+
+// Encoder-side plane state. Mirrors the decoder step for step so runs land
+// in the stream in exactly the order decodePackedRow() asks for them.
+struct PlaneEncoder {
+  RangeEncoder enc;
+  RunModel model;
+  const TileGrid *grid;
+  std::vector<unsigned char> values; // tile - 1 for each occupied cell
+  size_t index[5];                   // Symbols consumed per plane
+  unsigned char bit[5];
+  unsigned int remain[5];
+  bool started[5];
+};
+
+// Occupancy is coded as the difference from the row above
+static int planeSymbol(const PlaneEncoder &pe, int plane, size_t i) {
+  if (plane == 0) {
+    const std::vector<unsigned char> &tiles = pe.grid->tiles;
+    size_t cols = pe.grid->cols;
+    return (tiles[i] != 0) ^ (i >= cols && tiles[i - cols] != 0);
+  }
+  return (pe.values[i] >> (plane - 1)) & 1;
+}
+
+static void nextRunEncode(PlaneEncoder &pe, int plane) {
+  size_t count = plane == 0 ? pe.grid->tiles.size() : pe.values.size();
+  do {
+    int colour = pe.started[plane] ? !pe.bit[plane] : 0;
+    size_t i = pe.index[plane];
+    size_t j = i;
+    while (j < count && planeSymbol(pe, plane, j) == colour)
+      j++;
+    unsigned int length = (unsigned int)(j - i);
+    encodeRun(pe.enc, pe.model, plane * 2 + colour,
+              pe.started[plane] ? length - 1 : length);
+    pe.bit[plane] = colour;
+    pe.remain[plane] = length;
+    pe.started[plane] = true;
+  } while (pe.remain[plane] == 0);
+}
+
+static void consume(PlaneEncoder &pe, int plane, unsigned int n) {
+  pe.remain[plane] -= n;
+  pe.index[plane] += n;
+}
+
+void beginLevelPack(std::vector<unsigned char> &pack) {
+  const unsigned char header[LEVEL_PACK_HEADER_BYTES] = {'B', 'L', 'X', 'P',
+                                                         0,   0,   0,   0};
+  pack.assign(header, header + LEVEL_PACK_HEADER_BYTES);
+}
+
+void appendPackedLevel(std::vector<unsigned char> &pack, const TileGrid &grid) {
+  PlaneEncoder pe;
+  std::vector<unsigned char> payload;
+  pe.enc.low = 0;
+  pe.enc.range = 0xFFFFFFFFu;
+  pe.enc.cache = 0;
+  pe.enc.cacheSize = 1;
+  pe.enc.out = &payload;
+  pe.grid = &grid;
+  initRunModel(pe.model);
+  for (size_t i = 0; i < grid.tiles.size(); i++) {
+    if (grid.tiles[i] != 0)
+      pe.values.push_back(grid.tiles[i] - 1);
+  }
+  for (int p = 0; p < 5; p++) {
+    pe.index[p] = 0;
+    pe.bit[p] = 0;
+    pe.remain[p] = 0;
+    pe.started[p] = false;
+  }
+
+  // Same control flow as decodePackedRow()
+  for (int r = 0; r < grid.rows; r++) {
+    const unsigned char *above = r > 0 ? grid.row(r - 1) : NULL;
+    int pos = 0;
+    while (pos < grid.cols) {
+      if (pe.remain[0] == 0)
+        nextRunEncode(pe, 0);
+      unsigned int n = pe.remain[0];
+      if (n > (unsigned int)(grid.cols - pos))
+        n = grid.cols - pos;
+      for (int j = pos, end = pos + n; j < end;) {
+        int occupied = (above && above[j] != 0) ^ pe.bit[0];
+        int k = j + 1;
+        while (k < end && ((above && above[k] != 0) ^ pe.bit[0]) == occupied)
+          k++;
+        for (unsigned int done = 0; occupied && done < (unsigned int)(k - j);) {
+          unsigned int m = k - j - done;
+          for (int p = 1; p < 5; p++) {
+            if (pe.remain[p] == 0)
+              nextRunEncode(pe, p);
+            if (pe.remain[p] < m)
+              m = pe.remain[p];
+          }
+          for (int p = 1; p < 5; p++)
+            consume(pe, p, m);
+          done += m;
+        }
+        j = k;
+      }
+      consume(pe, 0, n);
+      pos += n;
+    }
+  }
+  for (int i = 0; i < 5; i++)
+    shiftLow(pe.enc);
+
+  putVarint(pack, grid.rows);
+  putVarint(pack, grid.cols);
+  putVarint(pack, payload.size());
+  pack.insert(pack.end(), payload.begin(), payload.end());
+
+  // Bump the level count in the header
+  unsigned int count = levelPackCount(pack) + 1;
+  for (int i = 0; i < 4; i++)
+    pack[4 + i] = (unsigned char)(count >> (8 * i));
+}
+
+bool saveLevelPack(const char *path, const std::vector<unsigned char> &pack) {
+  FILE *file = fopen(path, "wb");
+  if (!file) {
+    printf("Level pack error: cannot write '%s'\n", path);
+    return false;
+  }
+  bool ok = fwrite(pack.data(), 1, pack.size(), file) == pack.size();
+  fclose(file);
+  return ok;
+}
+
+// Decoder
+
+static unsigned int nextByte(LevelDecoder &dec) {
+  return dec.in < dec.end ? *dec.in++ : 0;
+}
+
+static int decodeBit(LevelDecoder &dec, unsigned short &prob) {
+  unsigned int bound = (dec.range >> PROB_BITS) * prob;
+  int bit;
+  if (dec.code < bound) {
+    dec.range = bound;
+    prob += ((1 << PROB_BITS) - prob) >> MOVE_BITS;
+    bit = 0;
+  } else {
+    dec.code -= bound;
+    dec.range -= bound;
+    prob -= prob >> MOVE_BITS;
+    bit = 1;
+  }
+  if (dec.range < TOP_VALUE) {
+    dec.range <<= 8;
+    dec.code = (dec.code << 8) | nextByte(dec);
+  }
+  return bit;
+}
+
+static int decodeDirectBit(LevelDecoder &dec) {
+  dec.range >>= 1;
+  int bit = 0;
+  if (dec.code >= dec.range) {
+    dec.code -= dec.range;
+    bit = 1;
+  }
+  if (dec.range < TOP_VALUE) {
+    dec.range <<= 8;
+    dec.code = (dec.code << 8) | nextByte(dec);
+  }
+  return bit;
+}
+
+static unsigned int decodeRun(LevelDecoder &dec, int ctx) {
+  RunModel &model = dec.model;
+  int k = 0;
+  while (k < RUN_PREFIX_BINS - 1 && decodeBit(dec, model.prefix[ctx][k]))
+    k++;
+
+  unsigned long long n = 1;
+  int node = 0;
+  for (int pos = 0; pos < k; pos++) {
+    int bit;
+    if (pos < 2) {
+      bit = decodeBit(dec, model.suffix[ctx][k][node]);
+      node = 1 + bit;
+    } else {
+      bit = decodeDirectBit(dec);
+    }
+    n = (n << 1) | bit;
+  }
+  return (unsigned int)(n - 1);
+}
+
+static void nextRunDecode(LevelDecoder &dec, int plane) {
+  do {
+    int colour = dec.started[plane] ? !dec.bit[plane] : 0;
+    unsigned int length = decodeRun(dec, plane * 2 + colour);
+    dec.remain[plane] = dec.started[plane] ? length + 1 : length;
+    dec.bit[plane] = colour;
+    dec.started[plane] = true;
+  } while (dec.remain[plane] == 0);
+}
+
+bool loadLevelPack(const char *path, std::vector<unsigned char> &pack) {
+  FILE *file = fopen(path, "rb");
+  if (!file) {
+    printf("Level pack error: cannot open '%s'\n", path);
+    return false;
+  }
+  fseek(file, 0, SEEK_END);
+  long size = ftell(file);
+  fseek(file, 0, SEEK_SET);
+  pack.resize(size > 0 ? size : 0);
+  bool ok = fread(pack.data(), 1, pack.size(), file) == pack.size();
+  fclose(file);
+
+  if (!ok || pack.size() < LEVEL_PACK_HEADER_BYTES ||
+      memcmp(pack.data(), "BLXP", 4) != 0) {
+    printf("Level pack error: '%s' is not a level pack\n", path);
+    return false;
+  }
+  return true;
+}
+
+int levelPackCount(const std::vector<unsigned char> &pack) {
+  if (pack.size() < LEVEL_PACK_HEADER_BYTES)
+    return 0;
+  return pack[4] | (pack[5] << 8) | (pack[6] << 16) | (pack[7] << 24);
+}
+
+bool beginPackedLevel(LevelDecoder &dec, const std::vector<unsigned char> &pack,
+                      size_t &offset) {
+  unsigned int rows, cols, bytes;
+  if (!getVarint(pack, offset, rows) || !getVarint(pack, offset, cols) ||
+      !getVarint(pack, offset, bytes) || bytes > pack.size() - offset)
+    return false;
+
+  dec.in = pack.data() + offset;
+  dec.end = dec.in + bytes;
+  offset += bytes;
+  dec.rows = rows;
+  dec.cols = cols;
+  dec.range = 0xFFFFFFFFu;
+  dec.code = 0;
+  for (int i = 0; i < 5; i++)
+    dec.code = (dec.code << 8) | nextByte(dec);
+  for (int p = 0; p < 5; p++) {
+    dec.bit[p] = 0;
+    dec.remain[p] = 0;
+    dec.started[p] = false;
+  }
+  initRunModel(dec.model);
+  return true;
+}
+
+// Fill an occupied span, splitting it where any value plane changes colour
+static void fillOccupied(LevelDecoder &dec, unsigned char *out,
+                         unsigned int count) {
+  for (unsigned int done = 0; done < count;) {
+    unsigned int m = count - done;
+    int value = 1;
+    for (int p = 1; p < 5; p++) {
+      if (dec.remain[p] == 0)
+        nextRunDecode(dec, p);
+      if (dec.remain[p] < m)
+        m = dec.remain[p];
+      value += dec.bit[p] << (p - 1);
+    }
+    memset(out + done, value, m);
+    for (int p = 1; p < 5; p++)
+      dec.remain[p] -= m;
+    done += m;
+  }
+}
+
+// End of the span starting at 'start' where tiles stay empty (or stay
+// non-empty), checked eight tiles at a time
+static int sameOccupancyEnd(const unsigned char *tiles, int start, int end) {
+  const unsigned long long ones = 0x0101010101010101ull;
+  const unsigned long long highs = 0x8080808080808080ull;
+  bool occupied = tiles[start] != 0;
+  int k = start + 1;
+  for (; k + 8 <= end; k += 8) {
+    unsigned long long v;
+    memcpy(&v, tiles + k, 8);
+    bool stop = occupied ? ((v - ones) & ~v & highs) != 0 : v != 0;
+    if (stop)
+      break;
+  }
+  while (k < end && (tiles[k] != 0) == occupied)
+    k++;
+  return k;
+}
+
+void decodePackedRow(LevelDecoder &dec, unsigned char *row,
+                     const unsigned char *above) {
+  int pos = 0;
+  while (pos < dec.cols) {
+    if (dec.remain[0] == 0)
+      nextRunDecode(dec, 0);
+    unsigned int n = dec.remain[0];
+    if (n > (unsigned int)(dec.cols - pos))
+      n = dec.cols - pos;
+
+    if (!above) {
+      // First row: occupancy runs are literal
+      if (dec.bit[0])
+        fillOccupied(dec, row + pos, n);
+      else
+        memset(row + pos, 0, n);
+    } else {
+      // Occupancy flips relative to the row above where the run colour is 1.
+      // Each span is read from 'above' before it is written, so 'row' may
+      // alias 'above'.
+      for (int j = pos, end = pos + n; j < end;) {
+        int occupied = (above[j] != 0) ^ dec.bit[0];
+        int k = sameOccupancyEnd(above, j, end);
+        if (occupied)
+          fillOccupied(dec, row + j, k - j);
+        else
+          memset(row + j, 0, k - j);
+        j = k;
+      }
+    }
+    dec.remain[0] -= n;
+    pos += n;
+  }
+}
+
+bool unpackLevel(const std::vector<unsigned char> &pack, size_t &offset,
+                 TileGrid &grid) {
+  LevelDecoder dec;
+  if (!beginPackedLevel(dec, pack, offset))
+    return false;
+  resizeGrid(grid, dec.rows, dec.cols);
+  for (int r = 0; r < dec.rows; r++)
+    decodePackedRow(dec, grid.row(r), r > 0 ? grid.row(r - 1) : NULL);
+  return true;
+}
+
+bool loadLevelFromPack(const char *path, int index, TileGrid &grid) {
+  std::vector<unsigned char> pack;
+  if (!loadLevelPack(path, pack))
+    return false;
+  if (index < 0 || index >= levelPackCount(pack)) {
+    printf("Level pack error: '%s' has no level %d\n", path, index);
+    return false;
+  }
+
+  // Skip earlier levels without decoding them
+  size_t offset = LEVEL_PACK_HEADER_BYTES;
+  for (int i = 0; i < index; i++) {
+    unsigned int rows, cols, bytes;
+    if (!getVarint(pack, offset, rows) || !getVarint(pack, offset, cols) ||
+        !getVarint(pack, offset, bytes))
+      return false;
+    offset += bytes;
+  }
+  return unpackLevel(pack, offset, grid);
+}
@@ -1,50 +1,157 @@
 #define GL_SILENCE_DEPRECATION // Ignore deprecation errors
-#include "dependencies/include/SOIL2/SOIL2.h"
+#include "headers/levelfile.h"
+#include "headers/frameclock.h"
+#include "headers/glstate.h"
+#include "headers/inputqueue.h"
 #include "headers/levels.h"
 #include "headers/menu.h"
+#include "headers/platform.h"
+#include "headers/platformbench.h"
+#include "headers/reload.h"
+#include "headers/render.h"
+#include "headers/replay.h"
+#include "headers/rewind.h"
+#include "headers/sim.h"
+#include "headers/startup.h"
+#include "headers/texture.h"
 #include "headers/win.h"
 #include <GLUT/glut.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
 #include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+#include <utility>
 #include <vector>
 
+GLuint glassTextureID;
+
+// The glass texture is decoded on a background thread and uploaded from the
+// timer once ready; the block is drawn untextured until then
+TextureImage glassImage;
+std::atomic<bool> glassImageReady(false);
+std::thread glassDecoder; // Joined at exit, before glassImage is destroyed
+
 struct Vec3 {
   float x, y, z;
 };
 
-GLuint glassTextureID;
-
 const float PI = 3.14159f;
-const float CAMERA_SMOOTH_FACTOR = 0.05f; // How quickly the camera moves
-const int TIMER_INTERVAL_MS = 16;         // 60 FPS
-const float BLOCK_ANIMATION_SPEED = 0.08f;
-const float FALL_SPEED = 0.15f;
+const float TILE_SIZE = 1.0f;
+const float CAMERA_SMOOTH_FACTOR = 0.05f; // Share of the way per 16 ms tick
+const double DEFAULT_FPS = 60.0;          // --fps, 0 for uncapped
+
+// Frame pacing; the game itself steps in fixed SIM_TICK_SECONDS ticks and
+// frames in between draw the block part way into the next tick
+FrameClock frameClock;
+
+// Idle detection: a frame is drawn only when something on screen changed.
+// With nothing moving the timer drops to IDLE_POLL_MS (for the level file
+// watch) and the streaks, the only thing still moving, are drawn at
+// --idle-streaks Hz (0 freezes them). --no-idle draws every frame.
+const int IDLE_POLL_MS = 50;
+bool idleEnabled = true;
+double idleStreakHz = 10.0;
+bool redrawRequested = true; // Something changed outside the animations
+bool timerSleeping = false;  // The timer is on an idle wait
+int timerChain = 0;          // Timers of an older chain stop re-arming
+FrameTime lastFramePosted;
+
+// --renderer core draws everything with the GL 3.3 core renderer
+// (render.h) instead of the fixed-function pipeline, so the two can be
+// compared by frame time. Its camera matrices are set by reshape() and
+// applyCameraTransform().
+bool coreRenderer = false;
+Mat4 cameraProjection, cameraView;
+
+// The light, as set on GL_LIGHT0 (specular and the scene ambient are GL's
+// defaults there). It stays put in the world, as the platform's lighting is
+// baked from it; from the starting camera it falls as a light fixed to the
+// camera at (5, 10, 5) would.
+const RenderLight SCENE_LIGHT = {{4.0f, 11.2f, 3.1f, 0.0f},
+                                 {0.3f, 0.3f, 0.4f, 1.0f},
+                                 {0.8f, 0.8f, 1.0f, 1.0f},
+                                 {1.0f, 1.0f, 1.0f, 1.0f},
+                                 {0.2f, 0.2f, 0.2f, 1.0f}};
 
 // Animation time for light streaks
 float animationTime = 5.0f;
 
 // Light streak data - position along perimeter (0.0 to 1.0)
 const int NUM_STREAKS = 6;
+const int STREAK_STEPS = 8; // Points along each streak
 float streakPositions[NUM_STREAKS] = {0.0f, 0.17f, 0.33f, 0.5f, 0.67f, 0.83f};
 float streakSpeeds[NUM_STREAKS] = {0.008f, 0.012f, 0.006f, 0.01f, 0.007f, 0.011f};
 
-// a vector of vectors from a 2D C-style array.
-std::vector<std::vector<int>> platformLayout = getLevelLayout(3); // CHANGE LEVEL
-
-const int PLATFORM_ROWS = platformLayout.size();
-const int PLATFORM_COLS = platformLayout[0].size();
-const float TILE_SIZE = 1.0f;
-
-// Toggle tile state (initially hidden)
-bool toggleGroup1Visible = false; // Bridge at columns 4-5 (row 3)
-bool toggleGroup2Visible = false; // Bridge at columns 10-11 (row 3)
-
-// Toggle tile positions: {row, col} pairs for toggle tiles controlled by each
-// action tile Action tile at (1,2) controls tiles at (3,4) and (3,5) Action
-// tile at (1,8) controls tiles at (3,10) and (3,11)
-const int TOGGLE_GROUP_1_ACTION_ROW = 1, TOGGLE_GROUP_1_ACTION_COL = 2;
-const int TOGGLE_GROUP_2_ACTION_ROW = 1, TOGGLE_GROUP_2_ACTION_COL = 8;
-const int TOGGLE_TILES_1[][2] = {{3, 4}, {3, 5}};
-const int TOGGLE_TILES_2[][2] = {{3, 10}, {3, 11}};
+// The game being played. Its level is loaded by setupLevel() once the menu is
+// on screen; the names below are what the drawing code reads.
+SimState game;
+std::vector<std::vector<int>> &platformLayout = game.layout;
+int &PLATFORM_ROWS = game.rows;
+int &PLATFORM_COLS = game.cols;
+Block &block = game.block;
+const int DEFAULT_LEVEL = 3; // CHANGE LEVEL
+bool levelReady = false;
+
+// The platform's vertex buffers, rebuilt when the level is loaded or
+// resized and patched when bridges toggle or cells are edited.
+// --platform baked|instanced picks how; --platform-bench times both on
+// generated levels and exits.
+PlatformMesh platformMesh;
+PlatformBuffers platformBuffers;
+bool platformStale = true;
+std::vector<std::pair<int, int>> platformEdited; // Cells to patch
+bool platformInstanced = false;
+bool platformBenchRequested = false;
+std::vector<int> platformChanged;
+// Shown tiles as a walkable mask (grid.h) with the tiles before each row,
+// rebuilt when the platform changes, so a streak finds its tile without
+// scanning the layout every frame
+TileGrid streakGrid;
+std::vector<unsigned long long> streakMask;
+std::vector<int> streakRowTiles; // Shown tiles in the rows above, per row
+bool streakMaskStale = true;
+// The platform's material ambient (the block's, which the legacy path
+// leaves set), for its baked lighting
+const float PLATFORM_AMBIENT = 0.8f;
+// Platform vertices drawn with baked lighting, summed over frames
+double platformBakedVertices = 0.0;
+unsigned int platformFrames = 0;
+SimInput pendingInput = INPUT_NONE; // Restart waiting for the next tick
+
+// Arrow presses waiting for the block to land (--input-queue depth[:ms])
+InputQueue inputQueue;
+const int DEFAULT_INPUT_DEPTH = 2;
+const int DEFAULT_INPUT_COALESCE_MS = 50; // Longer than key auto-repeat
+
+// Holding R plays the game backwards a tick per tick, through the last
+// REWIND_SECONDS of block, switch and camera target states
+const double REWIND_SECONDS = 60.0;
+RewindHistory rewindHistory;
+bool rewindHeld = false;
+// Key auto-repeat sends R up and down again at once, so a release only
+// counts once no press followed it within REWIND_RELEASE_MS
+const double REWIND_RELEASE_MS = 30.0;
+bool rewindReleasing = false;
+std::chrono::steady_clock::time_point rewindReleasedAt;
+
+const char *levelFilePath = NULL; // Set when a level file is given on the CLI
+int levelPackIndex = -1;          // Level within a .blxp pack, -1 for text
+
+// Input recording (--record): saved at exit, or when a hot-reload changes
+// the level under the recording
+const char *recordPath = NULL;
+InputLog inputLog;
+bool recording = false;
+
+// Hot-reload latency tracking (measured from the file write to the swap)
+std::chrono::steady_clock::time_point reloadAppliedAt;
+double reloadDetectMs = 0.0, reloadParseMs = 0.0, reloadApplyMs = 0.0;
+int reloadChangedCells = 0;
+bool reloadAwaitingFrame = false;
 
 // Camera State
 float cameraAngleX = 30.0f;
@@ -56,87 +163,135 @@ float targetCameraAngleX = 30.0f;
 float targetCameraAngleY = -45.0f;
 float targetCameraDistance = 15.0f;
 
-// Define the block's starting position in grid coordinates (will be set by
-// findStartPosition)
-int START_ROW = 1;
-int START_COL = 1;
-
-// Block State
-enum BlockOrientation { STANDING, LYING_X, LYING_Z };
-
-struct Block {
-  // Current state
-  float x, y, z;
-  BlockOrientation orientation;
-
-  // Animation state
-  bool isAnimating;
-  float animationProgress; // 0.0 to 1.0
-  Vec3 startPos, targetPos;
-  Vec3 pivotPoint;             // Pivot point for natural rolling
-  float startRotZ, targetRotZ; // For rolling left/right
-  float startRotX, targetRotX; // For rolling forward/backward
-
-  // Fall state
-  bool isFalling;
-  float fallVelocity;
-};
-
-Block block = {
-    (-PLATFORM_COLS / 2.0f + START_COL + 0.5f) * TILE_SIZE, // x
-    1.0f,                                                   // y
-    (-PLATFORM_ROWS / 2.0f + START_ROW + 0.5f) * TILE_SIZE, // z
-    STANDING,                                               // orientation
-    false,                                                  // isAnimating
-    0.0f,                                                   // animationProgress
-    {0, 0, 0},
-    {0, 0, 0}, // startPos, targetPos
-    {0, 0, 0}, // pivotPoint
-    0.0f,
-    0.0f, // startRotZ, targetRotZ
-    0.0f,
-    0.0f,  // startRotX, targetRotX
-    false, // isFalling
-    0.0f   // fallVelocity
-};
-
 // Functions
 void init();
 void update();
 void display();
 void reshape(int w, int h);
 void keyboard(unsigned char key, int x, int y);
+void keyboardUp(unsigned char key, int x, int y);
 void timer(int value);
 void applyCameraTransform();
 void drawCube();
-void drawCubeBorders();
 void drawPlatform();
+void buildPlatform(PlatformMesh &mesh, PlatformBuffers &buffers,
+                   const SimState &sim, bool instanced);
 void drawLightStreaks();
-void drawBlock();
+Mat4 blockModel(); // The block's transform this frame
+void drawBlock(const Mat4 &model);
+Vec3 blockCenter(int row, int col, BlockOrientation orientation);
 void specialKeys(int key, int x, int y);
-void moveBlock(int dx, int dz);
-bool checkBlockFall();    // Returns true if block should fall
-void resetBlock();        // Reset block to starting position
-void checkToggleTiles();  // Check and toggle tiles when block lands on action tile
-void initToggleTiles();   // Initialize toggle tiles to hidden
-void findStartPosition(); // Find starting position from tile 9 in level data
+void reloadLevelFile();   // Re-read the level file and apply what changed
+bool readLevelFile(std::vector<std::vector<int>> &layout,
+                   std::vector<SwitchDef> &switches); // Text level or pack
+void setupLevel();        // Load the level and place the block
+void decodeGlassTexture(); // Background thread body
+void joinGlassDecoder();   // Wait for it (run at exit)
+void finishRecording();   // Save the input log, if recording
+void printInputStats();   // Input queue counters and latency (run at exit)
+void printFrameTimes();   // Frame time statistics (run at exit)
+void printPlatformLighting(); // Vertices a frame with baked light (at exit)
+MeshLight platformLight();    // SCENE_LIGHT as the platform bakes it
+void gameTick();          // One fixed tick of the game, with queued input
+void rewindTick();        // One tick back through the rewind history
+void recordRewindFrame(); // Add the current tick to the rewind history
+float tickFraction();     // How far the game is into its next tick (-1 to 1)
+bool sceneMoving();       // True while anything on screen animates
+void requestRedraw();     // Draw a frame soon, waking the timer if idle
+void mouse(int button, int state, int x, int y);
 
 // Main
 int main(int argc, char **argv) {
+  startupRecord("static init", startupProcessStart());
+  atexit(printStartupTrace);
+
+  StartupTime phaseStart = std::chrono::steady_clock::now();
   glutInit(&argc, argv);
-  glutInitDisplayMode(GLUT_DOUBLE | GLUT_RGB | GLUT_DEPTH);
+
+  // Options, then an optional level file (or pack and level index),
+  // hot-reloaded whenever it is saved. Read later by setupLevel().
+  int argi = 1;
+  int inputDepth = DEFAULT_INPUT_DEPTH;
+  int inputCoalesceMs = DEFAULT_INPUT_COALESCE_MS;
+  double fps = DEFAULT_FPS;
+  while (argi < argc && strncmp(argv[argi], "--", 2) == 0) {
+    const char *option = argv[argi++];
+    if (strcmp(option, "--no-idle") == 0) {
+      idleEnabled = false;
+      continue;
+    }
+    if (strcmp(option, "--platform-bench") == 0) {
+      platformBenchRequested = true;
+      continue;
+    }
+    if (argi >= argc) {
+      printf("Option %s needs a value\n", option);
+      break;
+    }
+    const char *value = argv[argi++];
+    if (strcmp(option, "--record") == 0) {
+      recordPath = value;
+      atexit(finishRecording);
+    } else if (strcmp(option, "--input-queue") == 0) {
+      sscanf(value, "%d:%d", &inputDepth, &inputCoalesceMs);
+    } else if (strcmp(option, "--fps") == 0) {
+      fps = atof(value);
+    } else if (strcmp(option, "--idle-streaks") == 0) {
+      idleStreakHz = atof(value);
+    } else if (strcmp(option, "--platform") == 0) {
+      platformInstanced = strcmp(value, "instanced") == 0;
+    } else if (strcmp(option, "--renderer") == 0) {
+      coreRenderer = strcmp(value, "core") == 0;
+    } else {
+      printf("Unknown option %s\n", option);
+    }
+  }
+
+  // The core renderer needs a core profile context, asked for before the
+  // window is made
+  unsigned int displayMode = GLUT_DOUBLE | GLUT_RGB | GLUT_DEPTH;
+  if (coreRenderer) {
+#if defined(GLUT_3_2_CORE_PROFILE) // macOS GLUT
+    displayMode |= GLUT_3_2_CORE_PROFILE;
+#elif defined(GLUT_CORE_PROFILE) // freeglut
+    glutInitContextVersion(3, 3);
+    glutInitContextProfile(GLUT_CORE_PROFILE);
+#endif
+  }
+  glutInitDisplayMode(displayMode);
   glutInitWindowSize(1280, 720);
   glutInitWindowPosition(100, 100);
   glutCreateWindow("Bloxorz-3D");
+  startupRecord("glut window", phaseStart);
+  if (coreRenderer && !renderInit()) {
+    exit(1);
+  }
+  platformBuffers.core = coreRenderer;
+
+  inputQueueInit(inputQueue, inputDepth, inputCoalesceMs);
+  atexit(printInputStats);
+  frameClockInit(frameClock, fps);
+  atexit(printFrameTimes);
+  atexit(printPlatformLighting);
+  atexit(printGlStateStats);
+  rewindInit(rewindHistory, REWIND_SECONDS);
+  if (argi < argc) {
+    levelFilePath = argv[argi];
+    size_t len = strlen(levelFilePath);
+    if (len > 5 && strcmp(levelFilePath + len - 5, ".blxp") == 0) {
+      levelPackIndex = argi + 1 < argc ? atoi(argv[argi + 1]) : 0;
+    }
+  }
 
   init();
 
   glutDisplayFunc(display);
   glutReshapeFunc(reshape);
   glutKeyboardFunc(keyboard);
+  glutKeyboardUpFunc(keyboardUp);
   glutSpecialFunc(specialKeys);
-  glutMouseFunc(mouseClick);
-  glutTimerFunc(TIMER_INTERVAL_MS, timer, 0);
+  glutMouseFunc(mouse);
+  glutTimerFunc(frameClockNextDelayMs(frameClock), timer, 0);
 
   glutMainLoop();
   return 0;
@@ -144,109 +299,197 @@ int main(int argc, char **argv) {
 
 void init() {
   glClearColor(0.05f, 0.0f, 0.1f, 1.0f); // Dark purple-blue background
-  glEnable(GL_DEPTH_TEST);
-  glEnable(GL_BLEND);
-  glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-
-  // Lighting
-  glEnable(GL_LIGHTING);
-  glEnable(GL_LIGHT0);
-
-  // Light source
-  GLfloat light_position[] = {5.0f, 10.0f, 5.0f, 0.0f};
-  GLfloat light_ambient[] = {0.3f, 0.3f, 0.4f, 1.0f};
-  GLfloat light_diffuse[] = {0.8f, 0.8f, 1.0f, 1.0f};
+  stateEnable(GL_DEPTH_TEST);
+  stateEnable(GL_BLEND);
+  stateBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+  // Lighting (the core renderer's shaders read SCENE_LIGHT instead). The
+  // position is set with the camera each frame (applyCameraTransform()).
+  if (!coreRenderer) {
+    stateEnable(GL_LIGHTING);
+    stateEnable(GL_LIGHT0);
+    glLightfv(GL_LIGHT0, GL_AMBIENT, SCENE_LIGHT.ambient);
+    glLightfv(GL_LIGHT0, GL_DIFFUSE, SCENE_LIGHT.diffuse);
+  }
 
-  glLightfv(GL_LIGHT0, GL_POSITION, light_position);
-  glLightfv(GL_LIGHT0, GL_AMBIENT, light_ambient);
-  glLightfv(GL_LIGHT0, GL_DIFFUSE, light_diffuse);
+  // Decode off the main thread so the menu shows straight away. The level
+  // is set up after the first frame (see timer).
+  glassDecoder = std::thread(decodeGlassTexture);
+  atexit(joinGlassDecoder);
+}
 
-  glassTextureID = SOIL_load_OGL_texture(
-      "textures/glass.jpg", SOIL_LOAD_AUTO, SOIL_CREATE_NEW_ID,
-      SOIL_FLAG_MIPMAPS | SOIL_FLAG_INVERT_Y | SOIL_FLAG_TEXTURE_REPEATS);
+// Exit can come (Esc) while the decode still writes glassImage and the
+// startup trace; handlers run before the statics built earlier are gone
+void joinGlassDecoder() {
+  if (glassDecoder.joinable())
+    glassDecoder.join();
+}
 
-  // Check for errors
-  if (glassTextureID == 0) {
-    printf("SOIL loading error: '%s'\n", SOIL_last_result());
+void decodeGlassTexture() {
+  StartupTime phaseStart = std::chrono::steady_clock::now();
+  if (!decodeTexture("textures/glass.jpg", glassImage)) {
+    printf("SOIL loading error: '%s'\n", glassImage.error.c_str());
+    return;
   }
+  startupRecord("texture decode", phaseStart, true);
 
-  // Find starting position from tile 9 in level data
-  findStartPosition();
-
-  // Initialize toggle tiles (hide them initially)
-  initToggleTiles();
+  phaseStart = std::chrono::steady_clock::now();
+  generateMipmaps(glassImage);
+  startupRecord("mip generation", phaseStart, true);
+  glassImageReady = true;
+}
 
-  // Reset block to found starting position
-  resetBlock();
+void setupLevel() {
+  StartupTime phaseStart = std::chrono::steady_clock::now();
+  std::vector<std::vector<int>> layout;
+  std::vector<SwitchDef> switches;
+  char levelName[16];
+  snprintf(levelName, sizeof(levelName), "%d", DEFAULT_LEVEL);
+  if (levelFilePath && readLevelFile(layout, switches)) {
+    startLevelWatch(levelFilePath);
+  } else {
+    levelFilePath = NULL;
+    layout = getLevelLayout(DEFAULT_LEVEL);
+  }
+  simLoadLevel(game, layout, switches);
+  platformStale = true;
+  recordRewindFrame();
+  levelReady = true;
+  requestRedraw();
+
+  if (recordPath) {
+    beginInputLog(inputLog, levelFilePath ? levelFilePath : levelName,
+                  levelPackIndex, game);
+    recording = true;
+  }
+  startupRecord("level setup", phaseStart);
 }
 
 void update() {
+  // Camera smoothing and streak speeds are per 16 ms tick; scale them by
+  // the real time since the last frame so any frame rate looks the same
+  double dt = frameClockUpdate(frameClock);
+  float ticks = dt / SIM_TICK_SECONDS;
+
   // Smooth camera movement
-  cameraAngleX += (targetCameraAngleX - cameraAngleX) * CAMERA_SMOOTH_FACTOR;
-  cameraAngleY += (targetCameraAngleY - cameraAngleY) * CAMERA_SMOOTH_FACTOR;
-  cameraDistance +=
-      (targetCameraDistance - cameraDistance) * CAMERA_SMOOTH_FACTOR;
+  float smooth = 1.0f - powf(1.0f - CAMERA_SMOOTH_FACTOR, ticks);
+  cameraAngleX += (targetCameraAngleX - cameraAngleX) * smooth;
+  cameraAngleY += (targetCameraAngleY - cameraAngleY) * smooth;
+  cameraDistance += (targetCameraDistance - cameraDistance) * smooth;
+  if (fabsf(targetCameraAngleX - cameraAngleX) < 0.01f &&
+      fabsf(targetCameraAngleY - cameraAngleY) < 0.01f &&
+      fabsf(targetCameraDistance - cameraDistance) < 0.001f) {
+    // Close enough to stop: snap so the camera counts as still
+    cameraAngleX = targetCameraAngleX;
+    cameraAngleY = targetCameraAngleY;
+    cameraDistance = targetCameraDistance;
+  }
 
   // Update light streak positions
   for (int i = 0; i < NUM_STREAKS; i++) {
-    streakPositions[i] += streakSpeeds[i];
-    if (streakPositions[i] > 1.0f) {
-      streakPositions[i] -= 1.0f;
-    }
+    streakPositions[i] += streakSpeeds[i] * ticks;
+    streakPositions[i] -= floorf(streakPositions[i]);
   }
 
-  // Handle falling
-  if (block.isFalling) {
-    block.fallVelocity += 0.02f; // Gravity acceleration
-    block.y -= block.fallVelocity;
+  if (rewindReleasing &&
+      std::chrono::duration<double, std::milli>(
+          std::chrono::steady_clock::now() - rewindReleasedAt)
+              .count() >= REWIND_RELEASE_MS) {
+    rewindHeld = rewindReleasing = false;
+  }
 
-    // Reset when fallen far enough
-    if (block.y < -10.0f) {
-      resetBlock();
+  // Run the game's fixed ticks that fell due during the frame
+  if (levelReady) {
+    game.pendingTime += dt;
+    while (game.pendingTime >= SIM_TICK_SECONDS) {
+      game.pendingTime -= SIM_TICK_SECONDS;
+      gameTick();
+    }
+    if (hasWon != game.won) {
+      requestRedraw(); // Win overlay
     }
+    hasWon = game.won;
+  }
+}
+
+// A queued move starts on the first tick the block is back on the ground
+void gameTick() {
+  if (rewindHeld) {
+    rewindTick();
     return;
   }
+  SimInput input = pendingInput;
+  QueuedInput queued;
+  bool fromQueue = false;
+  if (input == INPUT_NONE && simIdle(game) &&
+      inputQueuePeek(inputQueue, queued)) {
+    input = queued.input;
+    fromQueue = true;
+  }
+  unsigned int tick = game.tick;
+  bool applied = simStep(game, input);
+  if (applied && fromQueue) {
+    inputQueueMoveStarted(inputQueue);
+  }
+  if (applied && recording) {
+    logInput(inputLog, tick, input);
+  }
+  pendingInput = INPUT_NONE;
 
-  if (block.isAnimating) {
-    block.animationProgress += BLOCK_ANIMATION_SPEED;
-    if (block.animationProgress >= 1.0f) {
-      // Animation finished, snap to final state
-      block.isAnimating = false;
-      block.animationProgress = 1.0f;
-      block.x = block.targetPos.x;
-      block.y = block.targetPos.y;
-      block.z = block.targetPos.z;
-
-      // Check for toggle tile activation
-      checkToggleTiles();
-
-      // Check win condition (standing on goal tile)
-      checkWinCondition();
-
-      // Check if block should fall (only if not won)
-      if (!hasWon && checkBlockFall()) {
-        block.isFalling = true;
-        block.fallVelocity = 0.0f;
-      }
-    }
+  // Moves pressed before a fall or a win are not meant for what follows
+  if (block.isFalling || game.won) {
+    inputQueueClear(inputQueue);
+  }
+  recordRewindFrame();
+}
+
+void rewindTick() {
+  std::vector<int> fields;
+  unsigned int tick;
+  if (!rewindPop(rewindHistory, fields, tick)) {
+    return; // Back at the oldest tick kept
   }
+  // Replays only follow inputs, so the recording ends here
+  if (recording) {
+    printf("Rewound, input recording stopped\n");
+    finishRecording();
+  }
+  float camera[3];
+  if (!rewindRestore(game, camera, fields)) {
+    // Frames from another level are no use; stop rather than keep popping
+    printf("Rewind history does not match the level, cleared\n");
+    rewindClear(rewindHistory);
+    rewindHeld = rewindReleasing = false;
+    return;
+  }
+  targetCameraAngleX = camera[0];
+  targetCameraAngleY = camera[1];
+  targetCameraDistance = camera[2];
+  game.tick = tick;
+  // Undo steps and waiting moves belong to the future just undone
+  simClearHistory(game);
+  pendingInput = INPUT_NONE;
+  inputQueueClear(inputQueue);
+}
+
+void recordRewindFrame() {
+  float camera[3] = {targetCameraAngleX, targetCameraAngleY,
+                     targetCameraDistance};
+  std::vector<int> fields;
+  rewindCapture(game, camera, fields);
+  rewindRecord(rewindHistory, game.tick, fields);
+}
+
+// While rewinding, frames between ticks draw the block part of the way back
+// to the previous tick instead
+float tickFraction() {
+  float fraction =
+      std::min(1.0f, (float)(game.pendingTime / SIM_TICK_SECONDS));
+  return rewindHeld ? -fraction : fraction;
 }
 
 // Draw instruction text in top-left corner
 void drawInstructions() {
-  glDisable(GL_LIGHTING);
-  glDisable(GL_DEPTH_TEST);
-  
-  glMatrixMode(GL_PROJECTION);
-  glPushMatrix();
-  glLoadIdentity();
-  gluOrtho2D(0, windowWidth, 0, windowHeight);
-  glMatrixMode(GL_MODELVIEW);
-  glPushMatrix();
-  glLoadIdentity();
-  
-  glColor3f(0.7f, 0.9f, 0.9f);  // Light cyan
-  
   int x = 15;
   int y = windowHeight - 25;
   int lineHeight = 18;
@@ -257,10 +500,34 @@ void drawInstructions() {
     "W/S - Zoom In/Out",
     "A/D - Rotate Camera",
     "1/2 - Camera Presets",
+    "Z/Y - Undo/Redo",
+    "R (hold) - Rewind",
     "ESC - Exit"
   };
   
-  for (int i = 0; i < 6; i++) {
+  if (coreRenderer) {
+    const float color[4] = {0.7f, 0.9f, 0.9f, 1.0f}; // Light cyan
+    stateDisable(GL_DEPTH_TEST);
+    for (int i = 0; i < 8; i++) {
+      render2DText(x, y - i * lineHeight, instructions[i], 1.0f, color);
+    }
+    return;
+  }
+
+  stateDisable(GL_LIGHTING);
+  stateDisable(GL_DEPTH_TEST);
+  
+  stateMatrixMode(GL_PROJECTION);
+  glPushMatrix();
+  glLoadIdentity();
+  gluOrtho2D(0, windowWidth, 0, windowHeight);
+  stateMatrixMode(GL_MODELVIEW);
+  glPushMatrix();
+  glLoadIdentity();
+  
+  glColor3f(0.7f, 0.9f, 0.9f);  // Light cyan
+  
+  for (int i = 0; i < 8; i++) {
     glRasterPos2i(x, y - i * lineHeight);
     const char* text = instructions[i];
     while (*text) {
@@ -269,31 +536,81 @@ void drawInstructions() {
     }
   }
   
-  glMatrixMode(GL_PROJECTION);
+  stateMatrixMode(GL_PROJECTION);
   glPopMatrix();
-  glMatrixMode(GL_MODELVIEW);
+  stateMatrixMode(GL_MODELVIEW);
   glPopMatrix();
-  
-  glEnable(GL_DEPTH_TEST);
-  glEnable(GL_LIGHTING);
 }
 
 // Display
 void display() {
+  if (platformBenchRequested) {
+    PlatformBenchSetup setup = {coreRenderer,    windowWidth,
+                                windowHeight,    cameraAngleX,
+                                cameraAngleY,    cameraDistance,
+                                platformLight(), SCENE_LIGHT};
+    platformBench(setup);
+    exit(0);
+  }
   glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-  glLoadIdentity();
+  if (!coreRenderer) {
+    glLoadIdentity();
+  }
+
+  if (currentGameState == PLAYING && !levelReady) {
+    setupLevel(); // Game started before the timer got to it
+  }
 
   if (currentGameState == MENU) {
-    drawMenu();
+    coreRenderer ? drawMenuCore() : drawMenu();
   } else {
+    // The 2D overlays leave depth testing and lighting off
+    stateEnable(GL_DEPTH_TEST);
+    if (!coreRenderer) {
+      stateEnable(GL_LIGHTING);
+    }
     applyCameraTransform();
+    // Translucent, so what is further back draws first. The block stands
+    // on the platform, so it comes after, unless it has fallen below it.
+    Mat4 blockTransform = blockModel();
+    bool blockUnder = blockTransform.m[13] < 0.0f;
+    if (blockUnder) {
+      drawBlock(blockTransform);
+    }
     drawPlatform();      // Draw Platform
     drawLightStreaks();  // Draw animated light streaks
-    drawBlock();         // Draw Block
+    if (!blockUnder) {
+      drawBlock(blockTransform); // Draw Block
+    }
     drawInstructions();  // Draw keyboard controls
-    drawWinScreen();     // Draw win overlay if won
+    coreRenderer ? drawWinScreenCore() : drawWinScreen(); // Win overlay
+  }
+  if (coreRenderer) {
+    render2DFlush(windowWidth, windowHeight); // The overlays in one draw
   }
   glutSwapBuffers();
+  frameClockPresented(frameClock);
+  stateFrameDone();
+
+  if (!startupFrameShown()) {
+    glFinish(); // Count the frame once it is actually on screen
+    startupFirstFrame();
+  }
+
+  // First frame after a hot-reload: report how long the edit took to show
+  if (reloadAwaitingFrame) {
+    glFinish();
+    double presentMs = std::chrono::duration<double, std::milli>(
+                           std::chrono::steady_clock::now() - reloadAppliedAt)
+                           .count();
+    double totalMs = reloadDetectMs + reloadParseMs + reloadApplyMs + presentMs;
+    printf("Level reload: %d cells changed, detect %.2f ms, parse %.2f ms, "
+           "apply %.2f ms, present %.2f ms, total %.2f ms%s\n",
+           reloadChangedCells, reloadDetectMs, reloadParseMs, reloadApplyMs,
+           presentMs, totalMs,
+           totalMs > frameClock.intervalMs ? " (over one frame)" : "");
+    reloadAwaitingFrame = false;
+  }
 }
 
 // Reshape
@@ -303,10 +620,15 @@ void reshape(int w, int h) {
   windowWidth = w;
   windowHeight = h;
   glViewport(0, 0, w, h);
-  glMatrixMode(GL_PROJECTION);
-  glLoadIdentity();
-  gluPerspective(45.0f, (float)w / h, 0.1f, 100.0f);
-  glMatrixMode(GL_MODELVIEW);
+  if (coreRenderer) {
+    cameraProjection = mat4Perspective(45.0f, (float)w / h, 0.1f, 100.0f);
+  } else {
+    stateMatrixMode(GL_PROJECTION);
+    glLoadIdentity();
+    gluPerspective(45.0f, (float)w / h, 0.1f, 100.0f);
+    stateMatrixMode(GL_MODELVIEW);
+  }
+  requestRedraw();
 }
 
 // Input
@@ -341,12 +663,26 @@ void keyboard(unsigned char key, int x, int y) {
     targetCameraAngleY = 135.0f;
     targetCameraDistance = 15.0f;
     break;
+  // Undo and redo moves (undo also stops a fall)
+  case 'z':
+  case 'Z':
+    pendingInput = INPUT_UNDO;
+    break;
+  case 'y':
+  case 'Y':
+    pendingInput = INPUT_REDO;
+    break;
+  // Rewind while held
+  case 'r':
+  case 'R':
+    rewindHeld = levelReady;
+    rewindReleasing = false;
+    break;
   // Restart after winning
   case ' ':
     if (hasWon) {
       resetWinState();
-      resetBlock();
-      initToggleTiles();
+      pendingInput = INPUT_RESET;
     }
     break;
   // Exit
@@ -354,35 +690,138 @@ void keyboard(unsigned char key, int x, int y) {
     exit(0);
     break;
   }
+  requestRedraw();
+}
+
+void keyboardUp(unsigned char key, int x, int y) {
+  if ((key == 'r' || key == 'R') && rewindHeld) {
+    rewindReleasing = true;
+    rewindReleasedAt = std::chrono::steady_clock::now();
+  }
 }
 
 void specialKeys(int key, int x, int y) {
-  // Ignore new input if an animation is already playing
-  if (block.isAnimating) {
+  // Queue the move even while the block is rolling; update() starts it as
+  // soon as the block lands
+  if (!levelReady) {
     return;
   }
 
+  SimInput input;
   switch (key) {
   case GLUT_KEY_LEFT:
-    moveBlock(-1, 0);
+    input = INPUT_LEFT;
     break;
   case GLUT_KEY_RIGHT:
-    moveBlock(1, 0);
+    input = INPUT_RIGHT;
     break;
   case GLUT_KEY_UP:
-    moveBlock(0, -1);
+    input = INPUT_UP;
     break;
   case GLUT_KEY_DOWN:
-    moveBlock(0, 1);
+    input = INPUT_DOWN;
     break;
+  default:
+    return;
+  }
+  inputQueuePush(inputQueue, input, std::chrono::steady_clock::now());
+  requestRedraw(); // Wake the timer so the move starts on the next tick
+}
+
+void printInputStats() { printInputQueueStats(inputQueue); }
+
+void printFrameTimes() { printFrameStats(frameClock); }
+
+void printPlatformLighting() {
+  if (platformFrames == 0) {
+    return;
+  }
+  printf("Platform lighting baked: %.0f vertices a frame drawn unlit, "
+         "no per-vertex lighting worked out for them\n",
+         platformBakedVertices / platformFrames);
+}
+
+void mouse(int button, int state, int x, int y) {
+  mouseClick(button, state, x, y);
+  requestRedraw();
+}
+
+bool sceneMoving() {
+  if (reloadAwaitingFrame) {
+    return true; // Its latency is measured on the next frame
+  }
+  if (currentGameState != PLAYING) {
+    return false; // The menu is static
+  }
+  return cameraAngleX != targetCameraAngleX ||
+         cameraAngleY != targetCameraAngleY ||
+         cameraDistance != targetCameraDistance ||
+         (levelReady && (rewindHeld || !simIdle(game)));
+}
+
+void requestRedraw() {
+  redrawRequested = true;
+  if (timerSleeping) {
+    // Start a fresh timer chain now; the sleeping one ends when it fires
+    timerSleeping = false;
+    frameClockWake(frameClock);
+    glutTimerFunc(0, timer, ++timerChain);
   }
 }
 
 // Timer
 void timer(int value) {
+  if (value != timerChain) {
+    return; // Replaced by requestRedraw()
+  }
+  timerSleeping = false; // Requests from here on are picked up below
+  frameClockWaitForDue(frameClock);
+
+  // Deferred startup work, once the first frame is up
+  if (!levelReady && startupFrameShown()) {
+    setupLevel();
+  }
+  if (glassImageReady && glassTextureID == 0) {
+    StartupTime phaseStart = std::chrono::steady_clock::now();
+    glassTextureID = uploadTexture(glassImage);
+    glassImage.levels.clear();
+    startupRecord("texture upload", phaseStart);
+    requestRedraw();
+  }
+
+  if (levelFilePath && pollLevelWatch()) {
+    reloadLevelFile();
+  }
   update();
-  glutPostRedisplay();
-  glutTimerFunc(TIMER_INTERVAL_MS, timer, 0);
+
+  // Full rate while anything moves or changed; otherwise wait, drawing the
+  // streaks now and then
+  FrameTime now = std::chrono::steady_clock::now();
+  bool idle = idleEnabled && !redrawRequested && !sceneMoving() &&
+              pendingInput == INPUT_NONE;
+  frameClockSetIdle(frameClock, idle);
+  if (!idle) {
+    redrawRequested = false;
+    lastFramePosted = now;
+    glutPostRedisplay();
+    glutTimerFunc(frameClockNextDelayMs(frameClock), timer, timerChain);
+    return;
+  }
+  int waitMs = IDLE_POLL_MS;
+  if (currentGameState == PLAYING && idleStreakHz > 0.0) {
+    double periodMs = 1000.0 / idleStreakHz;
+    double sinceMs =
+        std::chrono::duration<double, std::milli>(now - lastFramePosted)
+            .count();
+    if (sinceMs >= periodMs) {
+      lastFramePosted = now;
+      glutPostRedisplay();
+      sinceMs = 0.0;
+    }
+    waitMs = std::min(waitMs, (int)(periodMs - sinceMs) + 1);
+  }
+  timerSleeping = true;
+  glutTimerFunc(frameClockIdleDelayMs(frameClock, waitMs), timer, timerChain);
 }
 
 // Camera Helper
@@ -403,141 +842,153 @@ void applyCameraTransform() {
   float camY = cameraDistance * sin(radX);
   float camZ = cameraDistance * cos(radY) * cos(radX);
 
+  if (coreRenderer) {
+    const float eye[3] = {camX, camY, camZ};
+    const float centre[3] = {0.0f, 0.0f, 0.0f}, up[3] = {0.0f, 1.0f, 0.0f};
+    cameraView = mat4LookAt(eye, centre, up);
+    renderBeginFrame(cameraProjection, cameraView, SCENE_LIGHT);
+    return;
+  }
   gluLookAt(camX, camY, camZ, 0.0, 0.0, 0.0, 0.0, 1.0, 0.0);
+  glLightfv(GL_LIGHT0, GL_POSITION, SCENE_LIGHT.direction); // World space
 }
 
-// Draw cube
+// Draw cube (the same unit cube the core renderer draws)
 void drawCube() {
   glBegin(GL_QUADS);
-
-  // Front Face
-  glNormal3f(0.0, 0.0, 1.0);
-  glTexCoord2f(0.0f, 0.0f);
-  glVertex3f(-0.5f, -0.5f, 0.5f);
-  glTexCoord2f(1.0f, 0.0f);
-  glVertex3f(0.5f, -0.5f, 0.5f);
-  glTexCoord2f(1.0f, 1.0f);
-  glVertex3f(0.5f, 0.5f, 0.5f);
-  glTexCoord2f(0.0f, 1.0f);
-  glVertex3f(-0.5f, 0.5f, 0.5f);
-
-  // Back Face
-  glNormal3f(0.0, 0.0, -1.0);
-  glTexCoord2f(1.0f, 0.0f);
-  glVertex3f(-0.5f, -0.5f, -0.5f);
-  glTexCoord2f(1.0f, 1.0f);
-  glVertex3f(-0.5f, 0.5f, -0.5f);
-  glTexCoord2f(0.0f, 1.0f);
-  glVertex3f(0.5f, 0.5f, -0.5f);
-  glTexCoord2f(0.0f, 0.0f);
-  glVertex3f(0.5f, -0.5f, -0.5f);
-
-  // Top Face
-  glNormal3f(0.0, 1.0, 0.0);
-  glTexCoord2f(0.0f, 1.0f);
-  glVertex3f(-0.5f, 0.5f, -0.5f);
-  glTexCoord2f(0.0f, 0.0f);
-  glVertex3f(-0.5f, 0.5f, 0.5f);
-  glTexCoord2f(1.0f, 0.0f);
-  glVertex3f(0.5f, 0.5f, 0.5f);
-  glTexCoord2f(1.0f, 1.0f);
-  glVertex3f(0.5f, 0.5f, -0.5f);
-
-  // Bottom Face
-  glNormal3f(0.0, -1.0, 0.0);
-  glTexCoord2f(1.0f, 1.0f);
-  glVertex3f(-0.5f, -0.5f, -0.5f);
-  glTexCoord2f(0.0f, 1.0f);
-  glVertex3f(0.5f, -0.5f, -0.5f);
-  glTexCoord2f(0.0f, 0.0f);
-  glVertex3f(0.5f, -0.5f, 0.5f);
-  glTexCoord2f(1.0f, 0.0f);
-  glVertex3f(-0.5f, -0.5f, 0.5f);
-
-  // Right Face
-  glNormal3f(1.0, 0.0, 0.0);
-  glTexCoord2f(1.0f, 0.0f);
-  glVertex3f(0.5f, -0.5f, -0.5f);
-  glTexCoord2f(1.0f, 1.0f);
-  glVertex3f(0.5f, 0.5f, -0.5f);
-  glTexCoord2f(0.0f, 1.0f);
-  glVertex3f(0.5f, 0.5f, 0.5f);
-  glTexCoord2f(0.0f, 0.0f);
-  glVertex3f(0.5f, -0.5f, 0.5f);
-
-  // Left Face
-  glNormal3f(-1.0, 0.0, 0.0);
-  glTexCoord2f(0.0f, 0.0f);
-  glVertex3f(-0.5f, -0.5f, -0.5f);
-  glTexCoord2f(1.0f, 0.0f);
-  glVertex3f(-0.5f, -0.5f, 0.5f);
-  glTexCoord2f(1.0f, 1.0f);
-  glVertex3f(-0.5f, 0.5f, 0.5f);
-  glTexCoord2f(0.0f, 1.0f);
-  glVertex3f(-0.5f, 0.5f, -0.5f);
-
+  for (int i = 0; i < RENDER_CUBE_VERTICES; i++) {
+    const RenderVertex &vertex = RENDER_CUBE[i];
+    if (i % 4 == 0) {
+      glNormal3fv(vertex.normal);
+    }
+    glTexCoord2fv(vertex.uv);
+    glVertex3fv(vertex.position);
+  }
   glEnd();
 }
 
-// Draw border
-void drawCubeBorders() { glutWireCube(TILE_SIZE + 0.001f); }
-
 // Draw platform
 void drawPlatform() {
-  GLfloat plat_specular[] = {0.0f, 0.0f, 0.0f, 1.0f}; // No highlight
-  GLfloat plat_shininess[] = {0.0f};                  // No shininess
-
-  glMaterialfv(GL_FRONT, GL_SPECULAR, plat_specular);
-  glMaterialfv(GL_FRONT, GL_SHININESS, plat_shininess);
-
-  float offsetX = -PLATFORM_COLS * TILE_SIZE / 2.0f;
-  float offsetZ = -PLATFORM_ROWS * TILE_SIZE / 2.0f;
-
-  for (int i = 0; i < PLATFORM_ROWS; ++i) {
-    for (int j = 0; j < PLATFORM_COLS; ++j) {
-      // Only draw if the tile is not an empty space (0)
-      if (platformLayout[i][j] != 0) {
-        glPushMatrix();
-        glTranslatef(offsetX + (j + 0.5f) * TILE_SIZE, -TILE_SIZE / 2.0f,
-                     offsetZ + (i + 0.5f) * TILE_SIZE);
-
-        // Set material properties for the tile
-        int tileType = platformLayout[i][j];
-        if (tileType == 1) {
-          // Regular tile - dark gray
-          GLfloat mat_diffuse[] = {0.2f, 0.2f, 0.25f, 0.7f};
-          glMaterialfv(GL_FRONT, GL_DIFFUSE, mat_diffuse);
-        } else if (tileType == 2) {
-          // Target tile - cyan
-          GLfloat mat_diffuse[] = {0.0f, 0.8f, 0.8f, 0.6f};
-          glMaterialfv(GL_FRONT, GL_DIFFUSE, mat_diffuse);
-        } else if (tileType == 4) {
-          // Toggle tile (bridge) - orange
-          GLfloat mat_diffuse[] = {1.0f, 0.6f, 0.2f, 0.7f};
-          glMaterialfv(GL_FRONT, GL_DIFFUSE, mat_diffuse);
-        } else if (tileType == 5) {
-          // Toggle action tile - purple
-          GLfloat mat_diffuse[] = {0.7f, 0.3f, 0.9f, 0.7f};
-          glMaterialfv(GL_FRONT, GL_DIFFUSE, mat_diffuse);
-        }
-        drawCube();
+  platformChanged.clear();
+  if (!platformStale && !platformEdited.empty())
+    platformStale = !meshSyncCells(platformMesh, game, platformEdited,
+                                   platformChanged);
+  platformEdited.clear();
+  if (platformStale) {
+    streakMaskStale = true;
+    buildPlatform(platformMesh, platformBuffers, game, platformInstanced);
+    platformInstanced = platformBuffers.instanced;
+    platformStale = false;
+  } else {
+    meshSyncToggles(platformMesh, game, platformChanged);
+    platformUpdate(platformBuffers, platformMesh, platformChanged);
+  }
+  streakMaskStale = streakMaskStale || !platformChanged.empty();
+
+  // The mesh is in grid units with row 0, column 0 at the origin
+  PlatformStats stats;
+  if (coreRenderer) {
+    Mat4 model = mat4Multiply(mat4Translate(-PLATFORM_COLS * TILE_SIZE / 2.0f,
+                                            0.0f,
+                                            -PLATFORM_ROWS * TILE_SIZE / 2.0f),
+                              mat4Scale(TILE_SIZE, TILE_SIZE, TILE_SIZE));
+    PlatformView view = {cameraProjection, cameraView, model, windowHeight};
+    platformDrawView(platformBuffers, platformMesh, view,
+                     PLATFORM_CULL | PLATFORM_LOD | PLATFORM_SORT, &stats);
+  } else {
+    // The baked faces draw unlit; the instanced ones light with no highlight
+    GLfloat plat_specular[] = {0.0f, 0.0f, 0.0f, 1.0f};
+    GLfloat plat_shininess[] = {0.0f};
+
+    stateMaterial(GL_SPECULAR, plat_specular);
+    stateMaterial(GL_SHININESS, plat_shininess);
+
+    glPushMatrix();
+    glTranslatef(-PLATFORM_COLS * TILE_SIZE / 2.0f, 0.0f,
+                 -PLATFORM_ROWS * TILE_SIZE / 2.0f);
+    glScalef(TILE_SIZE, TILE_SIZE, TILE_SIZE);
+    platformDraw(platformBuffers, platformMesh,
+                 PLATFORM_CULL | PLATFORM_LOD | PLATFORM_SORT, &stats);
+    glPopMatrix();
+  }
+  platformBakedVertices += stats.bakedVertices;
+  platformFrames++;
+}
 
-        glDisable(GL_LIGHTING);
-        glColor3f(0.0f, 0.9f, 0.9f); // Cyan
-        drawCubeBorders();
-        glEnable(GL_LIGHTING);
+MeshLight platformLight() {
+  MeshLight light;
+  for (int i = 0; i < 3; i++) {
+    light.direction[i] = SCENE_LIGHT.direction[i];
+    light.ambient[i] =
+        (SCENE_LIGHT.sceneAmbient[i] + SCENE_LIGHT.ambient[i]) *
+        PLATFORM_AMBIENT;
+    light.diffuse[i] = SCENE_LIGHT.diffuse[i];
+  }
+  return light;
+}
 
-        glPopMatrix();
-      }
+// Build and upload the mesh. Instanced falls back to baked where the
+// context cannot draw it, and with the core renderer.
+void buildPlatform(PlatformMesh &mesh, PlatformBuffers &buffers,
+                   const SimState &sim, bool instanced) {
+  if (instanced && coreRenderer) {
+    printf("Instanced platform needs the legacy renderer\n");
+  } else if (instanced && platformInstancingSupported()) {
+    meshBuildInstances(mesh, sim, platformLight());
+    platformUpload(buffers, mesh);
+    if (buffers.program) {
+      return;
     }
   }
+  if (instanced) {
+    printf("Drawing the platform baked instead\n");
+  }
+  meshBuild(mesh, sim, platformLight());
+  platformUpload(buffers, mesh);
 }
 
 // Draw animated white light streaks along tile edges
+// Cell of the n-th shown tile in row-major order; false past the last
+bool streakTile(int n, int &row, int &col) {
+  int words = walkableWordsPerRow(PLATFORM_COLS);
+  if (streakMaskStale) {
+    layoutToGrid(platformLayout, streakGrid);
+    walkableMask(streakGrid, streakMask);
+    streakRowTiles.assign(PLATFORM_ROWS + 1, 0);
+    for (int i = 0; i < PLATFORM_ROWS; i++) {
+      int tiles = 0;
+      for (int w = 0; w < words; w++)
+        tiles += __builtin_popcountll(streakMask[(size_t)i * words + w]);
+      streakRowTiles[i + 1] = streakRowTiles[i] + tiles;
+    }
+    streakMaskStale = false;
+  }
+  if (n < 0 || n >= streakRowTiles[PLATFORM_ROWS])
+    return false;
+  row = std::upper_bound(streakRowTiles.begin(), streakRowTiles.end(), n) -
+        streakRowTiles.begin() - 1;
+  n -= streakRowTiles[row];
+  for (int w = 0;; w++) {
+    unsigned long long bits = streakMask[(size_t)row * words + w];
+    int count = __builtin_popcountll(bits);
+    if (n < count) {
+      for (; n > 0; n--)
+        bits &= bits - 1; // Drop the lowest set bit
+      col = w * 64 + __builtin_ctzll(bits);
+      return true;
+    }
+    n -= count;
+  }
+}
+
 void drawLightStreaks() {
-  glDisable(GL_LIGHTING);
-  glEnable(GL_BLEND);
-  glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+  static std::vector<RenderPoint> points; // STREAK_STEPS per streak
+  points.clear();
+  if (!coreRenderer) {
+    stateDisable(GL_LIGHTING);
+  }
+  stateEnable(GL_BLEND);
+  stateBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
   
   float offsetX = -PLATFORM_COLS * TILE_SIZE / 2.0f;
   float offsetZ = -PLATFORM_ROWS * TILE_SIZE / 2.0f;
@@ -553,12 +1004,7 @@ void drawLightStreaks() {
     float pos = streakPositions[s];
     
     // Pick a random-ish row and column based on streak index and position
-    int tileCount = 0;
-    for (int i = 0; i < PLATFORM_ROWS; ++i) {
-      for (int j = 0; j < PLATFORM_COLS; ++j) {
-        if (platformLayout[i][j] != 0) tileCount++;
-      }
-    }
+    int tileCount = game.tileCount;
     
     if (tileCount == 0) continue;
     
@@ -566,447 +1012,324 @@ void drawLightStreaks() {
     int targetTile = (int)(pos * tileCount * 7) % tileCount;
     int edgeIndex = (s + (int)(pos * 100)) % 4;  // 0=top, 1=right, 2=bottom, 3=left
     
-    int count = 0;
-    for (int i = 0; i < PLATFORM_ROWS; ++i) {
-      for (int j = 0; j < PLATFORM_COLS; ++j) {
-        if (platformLayout[i][j] != 0) {
-          if (count == targetTile) {
-            // Found our target tile, draw streak on selected edge
-            float tileX = offsetX + (j + 0.5f) * TILE_SIZE;
-            float tileZ = offsetZ + (i + 0.5f) * TILE_SIZE;
-            float half = TILE_SIZE / 2.0f;
-            
-            float x1, z1, x2, z2;
-            switch (edgeIndex) {
-              case 0: // Top edge (negative Z)
-                x1 = tileX - half; z1 = tileZ - half;
-                x2 = tileX + half; z2 = tileZ - half;
-                break;
-              case 1: // Right edge (positive X)
-                x1 = tileX + half; z1 = tileZ - half;
-                x2 = tileX + half; z2 = tileZ + half;
-                break;
-              case 2: // Bottom edge (positive Z)
-                x1 = tileX + half; z1 = tileZ + half;
-                x2 = tileX - half; z2 = tileZ + half;
-                break;
-              default: // Left edge (negative X)
-                x1 = tileX - half; z1 = tileZ + half;
-                x2 = tileX - half; z2 = tileZ - half;
-                break;
-            }
-            
-            // Draw streak along this edge
-            float edgeProgress = fmod(pos * 3.0f, 1.0f);  // Position along edge
-            float streakLen = 0.4f;  // Streak length as fraction of edge
-            
-            for (float t = 0; t < streakLen; t += 0.05f) {
-              float p = fmod(edgeProgress + t, 1.0f);
-              float px = x1 + (x2 - x1) * p;
-              float pz = z1 + (z2 - z1) * p;
-              
-              float alpha = 1.0f - (t / streakLen);
-              alpha = alpha * alpha;
-              
-              glPointSize(4.0f * alpha + 1.0f);
-              glBegin(GL_POINTS);
-              glColor4f(1.0f, 1.0f, 1.0f, alpha * 0.9f);
-              glVertex3f(px, y, pz);
-              glEnd();
-            }
-            goto next_streak;
-          }
-          count++;
-        }
-      }
+    int i, j;
+    if (!streakTile(targetTile, i, j))
+      continue;
+    // Draw streak on the selected edge of the target tile
+    float tileX = offsetX + (j + 0.5f) * TILE_SIZE;
+    float tileZ = offsetZ + (i + 0.5f) * TILE_SIZE;
+    float half = TILE_SIZE / 2.0f;
+    
+    float x1, z1, x2, z2;
+    switch (edgeIndex) {
+      case 0: // Top edge (negative Z)
+        x1 = tileX - half; z1 = tileZ - half;
+        x2 = tileX + half; z2 = tileZ - half;
+        break;
+      case 1: // Right edge (positive X)
+        x1 = tileX + half; z1 = tileZ - half;
+        x2 = tileX + half; z2 = tileZ + half;
+        break;
+      case 2: // Bottom edge (positive Z)
+        x1 = tileX + half; z1 = tileZ + half;
+        x2 = tileX - half; z2 = tileZ + half;
+        break;
+      default: // Left edge (negative X)
+        x1 = tileX - half; z1 = tileZ + half;
+        x2 = tileX - half; z2 = tileZ - half;
+        break;
+    }
+    
+    // Draw streak along this edge
+    float edgeProgress = fmod(pos * 3.0f, 1.0f);  // Position along edge
+    float streakLen = 0.4f;  // Streak length as fraction of edge
+    
+    for (int step = 0; step < STREAK_STEPS; step++) {
+      float t = step * streakLen / STREAK_STEPS;
+      float p = fmod(edgeProgress + t, 1.0f);
+      float px = x1 + (x2 - x1) * p;
+      float pz = z1 + (z2 - z1) * p;
+      
+      float alpha = 1.0f - (t / streakLen);
+      alpha = alpha * alpha;
+      
+      RenderPoint point = {{px, y, pz},
+                           4.0f * alpha + 1.0f,
+                           {1.0f, 1.0f, 1.0f, alpha * 0.9f}};
+      points.push_back(point);
     }
-    next_streak:;
   }
   
-  glEnable(GL_LIGHTING);
+  if (coreRenderer) {
+    renderPoints(points);
+    return;
+  }
+  // Each step has the same size and colour in every streak, so the legacy
+  // path draws one batch per step
+  for (int step = 0; step < STREAK_STEPS && step < (int)points.size();
+       step++) {
+    statePointSize(points[step].size);
+    glBegin(GL_POINTS);
+    glColor4fv(points[step].color);
+    for (size_t i = step; i < points.size(); i += STREAK_STEPS)
+      glVertex3fv(points[i].position);
+    glEnd();
+  }
+  stateEnable(GL_LIGHTING);
 }
 
-void drawBlock() {
-  glPushMatrix();
+// World position of the centre of a block resting on (row, col)
+Vec3 blockCenter(int row, int col, BlockOrientation orientation) {
+  Vec3 center = {(-PLATFORM_COLS / 2.0f + col + 0.5f) * TILE_SIZE,
+                 orientation == STANDING ? 1.0f : 0.5f,
+                 (-PLATFORM_ROWS / 2.0f + row + 0.5f) * TILE_SIZE};
+  if (orientation == LYING_X)
+    center.x += 0.5f * TILE_SIZE;
+  if (orientation == LYING_Z)
+    center.z += 0.5f * TILE_SIZE;
+  return center;
+}
 
+Mat4 blockModel() {
+  Mat4 model;
   if (block.isAnimating) {
-    float t = block.animationProgress;
+    float t = (block.animationTick + tickFraction()) * BLOCK_ANIMATION_SPEED;
+    t = std::max(0.0f, std::min(t, 1.0f));
     t = t * t * (3.0f - 2.0f * t); // Smooth step interpolation
 
-    float currentRotZ =
-        block.startRotZ + (block.targetRotZ - block.startRotZ) * t;
-    float currentRotX =
-        block.startRotX + (block.targetRotX - block.startRotX) * t;
+    // Roll about the bottom edge of the starting footprint that faces the
+    // direction of movement
+    Vec3 start =
+        blockCenter(block.fromRow, block.fromCol, block.fromOrientation);
+    float halfX = (block.fromOrientation == LYING_X ? 1.0f : 0.5f) * TILE_SIZE;
+    float halfZ = (block.fromOrientation == LYING_Z ? 1.0f : 0.5f) * TILE_SIZE;
+    Vec3 pivot = {start.x + block.moveDx * halfX, 0.0f,
+                  start.z + block.moveDz * halfZ};
 
     // Translate to pivot point first
-    glTranslatef(block.pivotPoint.x, block.pivotPoint.y, block.pivotPoint.z);
+    model = mat4Translate(pivot.x, pivot.y, pivot.z);
 
     // Apply rotation around pivot
-    if (block.targetRotZ != 0) {
-      glRotatef(currentRotZ, 0.0f, 0.0f, 1.0f);
+    if (block.moveDx != 0) {
+      model = mat4Multiply(
+          model, mat4Rotate(-block.moveDx * 90.0f * t, 0.0f, 0.0f, 1.0f));
     }
-    if (block.targetRotX != 0) {
-      glRotatef(currentRotX, 1.0f, 0.0f, 0.0f);
+    if (block.moveDz != 0) {
+      model = mat4Multiply(
+          model, mat4Rotate(block.moveDz * 90.0f * t, 1.0f, 0.0f, 0.0f));
     }
 
     // Translate back from pivot to block's original position relative to pivot
-    glTranslatef(block.startPos.x - block.pivotPoint.x,
-                 block.startPos.y - block.pivotPoint.y,
-                 block.startPos.z - block.pivotPoint.z);
+    model = mat4Multiply(model, mat4Translate(start.x - pivot.x,
+                                              start.y - pivot.y,
+                                              start.z - pivot.z));
 
   } else {
-    glTranslatef(block.x, block.y, block.z);
+    Vec3 center = blockCenter(block.row, block.col, block.orientation);
+    if (block.isFalling) {
+      float n = std::max(0.0f, block.fallTick + tickFraction());
+      center.y -= FALL_GRAVITY * n * (n + 1) / 2.0f;
+    }
+    model = mat4Translate(center.x, center.y, center.z);
   }
 
-  GLfloat mat_ambient[] = {0.8f, 0.8f, 0.8f, 1.0f};
-  GLfloat mat_diffuse[] = {1.0f, 1.0f, 1.0f, 0.8f}; // White base color, 80%
-  GLfloat mat_specular[] = {1.0f, 1.0f, 1.0f, 1.0f};
-  GLfloat mat_shininess[] = {90.0f};
-
-  glMaterialfv(GL_FRONT, GL_AMBIENT, mat_ambient);
-  glMaterialfv(GL_FRONT, GL_DIFFUSE, mat_diffuse);
-  glMaterialfv(GL_FRONT, GL_SPECULAR, mat_specular);
-  glMaterialfv(GL_FRONT, GL_SHININESS, mat_shininess);
-
-  glEnable(GL_TEXTURE_2D);
-  glBindTexture(GL_TEXTURE_2D, glassTextureID);
-
-  glPushMatrix();
-
   // Use the START orientation for scaling during animation
-  BlockOrientation drawOrientation;
-  if (block.isAnimating) {
-    // Determine what orientation the block was BEFORE the move
-    // by checking what it will become and reversing
-    if (block.targetRotZ != 0) {
-      // Moving in X direction
-      if (block.orientation == STANDING) {
-        drawOrientation = LYING_X; // Was lying, becoming standing
-      } else if (block.orientation == LYING_X) {
-        drawOrientation = STANDING; // Was standing, becoming lying
-      } else {
-        drawOrientation = LYING_Z; // Was lying Z, stays lying Z
-      }
-    } else if (block.targetRotX != 0) {
-      // Moving in Z direction
-      if (block.orientation == STANDING) {
-        drawOrientation = LYING_Z;
-      } else if (block.orientation == LYING_Z) {
-        drawOrientation = STANDING;
-      } else {
-        drawOrientation = LYING_X;
-      }
-    } else {
-      drawOrientation = block.orientation;
-    }
-  } else {
-    drawOrientation = block.orientation;
-  }
+  BlockOrientation drawOrientation =
+      block.isAnimating ? block.fromOrientation : block.orientation;
 
   switch (drawOrientation) {
   case STANDING:
-    glScalef(1.0f, 2.0f, 1.0f);
+    model = mat4Multiply(model, mat4Scale(1.0f, 2.0f, 1.0f));
     break;
   case LYING_X:
-    glScalef(2.0f, 1.0f, 1.0f);
+    model = mat4Multiply(model, mat4Scale(2.0f, 1.0f, 1.0f));
     break;
   case LYING_Z:
-    glScalef(1.0f, 1.0f, 2.0f);
+    model = mat4Multiply(model, mat4Scale(1.0f, 1.0f, 2.0f));
     break;
   }
-
-  drawCube();
-
-  glPopMatrix();
-
-  glDisable(GL_TEXTURE_2D);
-
-  glPopMatrix();
+  return model;
 }
 
-void moveBlock(int dx, int dz) {
-  if (dx == 0 && dz == 0)
-    return;
+void drawBlock(const Mat4 &model) {
+  static const RenderMaterial BLOCK_MATERIAL = {
+      {0.8f, 0.8f, 0.8f, 1.0f},
+      {1.0f, 1.0f, 1.0f, 0.8f}, // White base color, 80%
+      {1.0f, 1.0f, 1.0f, 1.0f},
+      90.0f};
 
-  // Store starting position and rotation
-  block.startPos = {block.x, block.y, block.z};
-  block.startRotZ = 0;
-  block.startRotX = 0;
-  block.targetRotZ = 0;
-  block.targetRotX = 0;
-
-  if (dx != 0) {
-    // Horizontal movement (left/right) - rotates around Z axis
-    if (block.orientation == STANDING) {
-      // Standing (1x2x1) rolling to lying on X axis (2x1x1)
-      // Block center is at height 1.0, bottom edge is at y=0
-      // Pivot is at the bottom edge in the direction of movement
-      block.pivotPoint = {block.x +
-                              dx * 0.5f * TILE_SIZE, // Edge of the 1x1 base
-                          0.0f,                      // Ground level
-                          block.z};
-
-      block.targetPos = {block.x + dx * 1.5f *
-                                       TILE_SIZE, // Move 1.5 tiles (0.5 + 1.0)
-                         0.5f,                    // Lying block center height
-                         block.z};
-
-      block.targetRotZ = -dx * 90.0f;
-      block.orientation = LYING_X;
-
-    } else if (block.orientation == LYING_X) {
-      // Lying on X axis (2x1x1) - rolling to stand up
-      // Block extends 1 tile in each X direction from center
-      // Pivot is at the far edge in movement direction
-      block.pivotPoint = {block.x +
-                              dx * TILE_SIZE, // Far edge of the 2x1 footprint
-                          0.0f,               // Ground level
-                          block.z};
-
-      block.targetPos = {block.x + dx * 1.5f * TILE_SIZE, // Move 1.5 tiles
-                         1.0f, // Standing block center height
-                         block.z};
-
-      block.targetRotZ = -dx * 90.0f;
-      block.orientation = STANDING;
-
-    } else if (block.orientation == LYING_Z) {
-      // Lying on Z axis (1x1x2) rolling sideways - stays lying on Z
-      block.pivotPoint = {block.x + dx * 0.5f * TILE_SIZE, 0.0f, block.z};
-
-      block.targetPos = {block.x + dx * TILE_SIZE, 0.5f, block.z};
-
-      block.targetRotZ = -dx * 90.0f;
-      // Orientation stays LYING_Z
-    }
+  if (coreRenderer) {
+    renderBlock(model, BLOCK_MATERIAL, glassTextureID);
+    return;
   }
 
-  if (dz != 0) {
-    // Forward/backward movement - rotates around X axis
-    if (block.orientation == STANDING) {
-      // Standing rolling forward/backward
-      block.pivotPoint = {block.x, 0.0f, block.z + dz * 0.5f * TILE_SIZE};
-
-      block.targetPos = {block.x, 0.5f, block.z + dz * 1.5f * TILE_SIZE};
-
-      block.targetRotX = dz * 90.0f;
-      block.orientation = LYING_Z;
-
-    } else if (block.orientation == LYING_Z) {
-      // Lying on Z axis rolling forward/backward to standing
-      block.pivotPoint = {block.x, 0.0f, block.z + dz * TILE_SIZE};
+  stateMaterial(GL_AMBIENT, BLOCK_MATERIAL.ambient);
+  stateMaterial(GL_DIFFUSE, BLOCK_MATERIAL.diffuse);
+  stateMaterial(GL_SPECULAR, BLOCK_MATERIAL.specular);
+  stateMaterial(GL_SHININESS, &BLOCK_MATERIAL.shininess);
 
-      block.targetPos = {block.x, 1.0f, block.z + dz * 1.5f * TILE_SIZE};
+  stateEnable(GL_TEXTURE_2D);
+  stateBindTexture(glassTextureID);
 
-      block.targetRotX = dz * 90.0f;
-      block.orientation = STANDING;
-
-    } else if (block.orientation == LYING_X) {
-      // Lying on X axis rolling forward/backward - stays lying on X
-      block.pivotPoint = {block.x, 0.0f, block.z + dz * 0.5f * TILE_SIZE};
-
-      block.targetPos = {block.x, 0.5f, block.z + dz * TILE_SIZE};
-
-      block.targetRotX = dz * 90.0f;
-      // Orientation stays LYING_X
-    }
-  }
-
-  block.isAnimating = true;
-  block.animationProgress = 0.0f;
-}
+  // Its far faces first, then the near ones over them
+  glPushMatrix();
+  glMultMatrixf(model.m);
+  stateEnable(GL_CULL_FACE);
+  stateCullFace(GL_FRONT);
+  drawCube();
+  stateCullFace(GL_BACK);
+  drawCube();
+  stateDisable(GL_CULL_FACE);
+  glPopMatrix();
 
-// Convert world X coordinate to grid column
-int worldToGridCol(float worldX) {
-  float offsetX = -PLATFORM_COLS * TILE_SIZE / 2.0f;
-  return (int)floor((worldX - offsetX) / TILE_SIZE);
+  stateDisable(GL_TEXTURE_2D);
 }
 
-// Convert world Z coordinate to grid row
-int worldToGridRow(float worldZ) {
-  float offsetZ = -PLATFORM_ROWS * TILE_SIZE / 2.0f;
-  return (int)floor((worldZ - offsetZ) / TILE_SIZE);
+// Read the level named on the command line (a text level or one level of a
+// pack)
+bool readLevelFile(std::vector<std::vector<int>> &layout,
+                   std::vector<SwitchDef> &switches) {
+  return loadNamedLevel(levelFilePath, levelPackIndex, layout, switches);
 }
 
-// Get tile value at grid position (returns 0 if out of bounds)
-int getTileAt(int row, int col) {
-  if (row < 0 || row >= PLATFORM_ROWS || col < 0 || col >= PLATFORM_COLS) {
-    return 0; // Out of bounds = empty
+// Save the input log with the state the session ended in
+void finishRecording() {
+  if (!recording)
+    return;
+  recording = false;
+  endInputLog(inputLog, game);
+  if (saveInputLog(recordPath, inputLog)) {
+    printf("Input log saved to %s (%u ticks)\n", recordPath,
+           inputLog.finalTick);
   }
-  return platformLayout[row][col];
 }
 
-// Check if block should fall
-bool checkBlockFall() {
-  int centerCol = worldToGridCol(block.x);
-  int centerRow = worldToGridRow(block.z);
-
-  switch (block.orientation) {
-  case STANDING:
-    // Standing block occupies only one tile
-    if (getTileAt(centerRow, centerCol) == 0) {
-      return true;
-    }
-    break;
-
-  case LYING_X:
-    // Block extends 1 tile in X direction (left and right from center)
-    // Check both tiles the block occupies
-    {
-      int leftCol = worldToGridCol(block.x - 0.5f * TILE_SIZE);
-      int rightCol = worldToGridCol(block.x + 0.5f * TILE_SIZE);
-      if (getTileAt(centerRow, leftCol) == 0 ||
-          getTileAt(centerRow, rightCol) == 0) {
-        return true;
-      }
-    }
-    break;
-
-  case LYING_Z:
-    // Block extends 1 tile in Z direction (forward and backward from center)
-    {
-      int frontRow = worldToGridRow(block.z - 0.5f * TILE_SIZE);
-      int backRow = worldToGridRow(block.z + 0.5f * TILE_SIZE);
-      if (getTileAt(frontRow, centerCol) == 0 ||
-          getTileAt(backRow, centerCol) == 0) {
-        return true;
-      }
-    }
-    break;
+// True if two switch tables list the same tiles in the same order
+bool sameSwitches(const std::vector<SwitchDef> &a,
+                  const std::vector<SwitchDef> &b) {
+  if (a.size() != b.size())
+    return false;
+  for (size_t s = 0; s < a.size(); s++) {
+    if (a[s].actionRow != b[s].actionRow ||
+        a[s].actionCol != b[s].actionCol || a[s].tiles != b[s].tiles)
+      return false;
   }
-
-  return false;
-}
-
-// Reset block to starting position
-void resetBlock() {
-  block.x = (-PLATFORM_COLS / 2.0f + START_COL + 0.5f) * TILE_SIZE;
-  block.y = 1.0f;
-  block.z = (-PLATFORM_ROWS / 2.0f + START_ROW + 0.5f) * TILE_SIZE;
-  block.orientation = STANDING;
-  block.isAnimating = false;
-  block.animationProgress = 0.0f;
-  block.isFalling = false;
-  block.fallVelocity = 0.0f;
+  return true;
 }
 
-// Initialize toggle tiles to be hidden at start
-void initToggleTiles() {
-  // Only hide toggle tiles if they exist (type 4) - prevents affecting other levels
-  // Hide toggle tiles for group 1 (columns 4-5) if they exist
-  for (int i = 0; i < 2; i++) {
-    int row = TOGGLE_TILES_1[i][0];
-    int col = TOGGLE_TILES_1[i][1];
-    // Check bounds and if it's actually a toggle tile
-    if (row < PLATFORM_ROWS && col < PLATFORM_COLS && platformLayout[row][col] == 4) {
-      platformLayout[row][col] = 0;
-    }
-  }
-  // Hide toggle tiles for group 2 (columns 10-11) if they exist
-  for (int i = 0; i < 2; i++) {
-    int row = TOGGLE_TILES_2[i][0];
-    int col = TOGGLE_TILES_2[i][1];
-    // Check bounds and if it's actually a toggle tile
-    if (row < PLATFORM_ROWS && col < PLATFORM_COLS && platformLayout[row][col] == 4) {
-      platformLayout[row][col] = 0;
-    }
+// Re-read the level file and apply only what changed. Same-size edits touch
+// just the changed cells (plus the toggle table if a switch or bridge was
+// edited); a size change rebuilds the level. The block stays where it is
+// unless the edit removed the ground under it.
+void reloadLevelFile() {
+  typedef std::chrono::steady_clock Clock;
+  reloadDetectMs = levelFileAgeMs();
+  Clock::time_point parseStart = Clock::now();
+
+  std::vector<std::vector<int>> layout;
+  std::vector<SwitchDef> switches;
+  if (!readLevelFile(layout, switches)) {
+    return; // Keep playing the current level until the file is fixed
   }
-  toggleGroup1Visible = false;
-  toggleGroup2Visible = false;
-}
-
-// Check if block is on a toggle action tile and toggle the corresponding tiles
-void checkToggleTiles() {
-  int centerCol = worldToGridCol(block.x);
-  int centerRow = worldToGridRow(block.z);
-
-  // Get all tiles the block occupies
-  int occupiedRow1 = centerRow, occupiedCol1 = centerCol;
-  int occupiedRow2 = -1,
-      occupiedCol2 = -1; // -1 means not occupied (standing block)
-
-  if (block.orientation == LYING_X) {
-    occupiedCol1 = worldToGridCol(block.x - 0.5f * TILE_SIZE);
-    occupiedCol2 = worldToGridCol(block.x + 0.5f * TILE_SIZE);
-    occupiedRow2 = centerRow;
-  } else if (block.orientation == LYING_Z) {
-    occupiedRow1 = worldToGridRow(block.z - 0.5f * TILE_SIZE);
-    occupiedRow2 = worldToGridRow(block.z + 0.5f * TILE_SIZE);
-    occupiedCol2 = centerCol;
-  }
-
-  // Check if any occupied tile is actually a toggle action tile (type 5)
-  // First check the actual tile type, not just the position
-  bool tile1IsActionTile = (getTileAt(occupiedRow1, occupiedCol1) == 5);
-  bool tile2IsActionTile =
-      (occupiedRow2 >= 0 && getTileAt(occupiedRow2, occupiedCol2) == 5);
-
-  // Only check toggle groups if we're on an action tile
-  if (!tile1IsActionTile && !tile2IsActionTile) {
-    return; // Not on any action tile, skip toggle logic
-  }
-
-  // Check group 1 action tile
-  bool onGroup1Action =
-      (tile1IsActionTile && occupiedRow1 == TOGGLE_GROUP_1_ACTION_ROW &&
-       occupiedCol1 == TOGGLE_GROUP_1_ACTION_COL) ||
-      (tile2IsActionTile && occupiedRow2 == TOGGLE_GROUP_1_ACTION_ROW &&
-       occupiedCol2 == TOGGLE_GROUP_1_ACTION_COL);
-
-  // Check group 2 action tile
-  bool onGroup2Action =
-      (tile1IsActionTile && occupiedRow1 == TOGGLE_GROUP_2_ACTION_ROW &&
-       occupiedCol1 == TOGGLE_GROUP_2_ACTION_COL) ||
-      (tile2IsActionTile && occupiedRow2 == TOGGLE_GROUP_2_ACTION_ROW &&
-       occupiedCol2 == TOGGLE_GROUP_2_ACTION_COL);
-
-  // Toggle group 1
-  if (onGroup1Action) {
-    toggleGroup1Visible = !toggleGroup1Visible;
-    for (int i = 0; i < 2; i++) {
-      platformLayout[TOGGLE_TILES_1[i][0]][TOGGLE_TILES_1[i][1]] =
-          toggleGroup1Visible ? 4 : 0;
-    }
+  Clock::time_point applyStart = Clock::now();
+
+  // A replay could not reproduce the edit, so the recording ends here
+  if (recording) {
+    printf("Level changed, input recording stopped\n");
+    finishRecording();
   }
 
-  // Toggle group 2
-  if (onGroup2Action) {
-    toggleGroup2Visible = !toggleGroup2Visible;
-    for (int i = 0; i < 2; i++) {
-      platformLayout[TOGGLE_TILES_2[i][0]][TOGGLE_TILES_2[i][1]] =
-          toggleGroup2Visible ? 4 : 0;
+  bool switchesChanged = !sameSwitches(switches, game.switches);
+  game.switches.swap(switches);
+
+  int changedCells = 0;
+  if ((int)layout.size() != PLATFORM_ROWS ||
+      (int)layout[0].size() != PLATFORM_COLS) {
+    // The block keeps its grid cell as the platform re-centers
+    changedCells = layout.size() * layout[0].size();
+    platformStale = true;
+    platformLayout.swap(layout);
+    PLATFORM_ROWS = platformLayout.size();
+    PLATFORM_COLS = platformLayout[0].size();
+    game.source = platformLayout;
+    simFindStart(game);
+    simBuildToggleGroups(game);
+    game.tileCount = simCountTiles(game);
+    simHideBridges(game);
+  } else {
+    for (int i = 0; i < PLATFORM_ROWS; i++) {
+      for (int j = 0; j < PLATFORM_COLS; j++) {
+        int oldTile = game.source[i][j];
+        int newTile = layout[i][j];
+        if (oldTile == newTile)
+          continue;
+        changedCells++;
+        platformEdited.push_back(std::make_pair(i, j));
+        game.source[i][j] = newTile;
+        if (oldTile == 4 || oldTile == 5 || newTile == 4 || newTile == 5)
+          switchesChanged = true;
+
+        // Same rewrite simFindStart() applies to the start tile
+        int value = newTile;
+        if (newTile == 9) {
+          game.startRow = i;
+          game.startCol = j;
+          value = 1;
+        }
+        game.tileCount += (value != 0) - (platformLayout[i][j] != 0);
+        platformLayout[i][j] = value;
+      }
     }
-  }
-}
 
-// Find starting position from tile 9 in level data and convert it to normal
-// tile
-void findStartPosition() {
-  for (int i = 0; i < PLATFORM_ROWS; i++) {
-    for (int j = 0; j < PLATFORM_COLS; j++) {
-      if (platformLayout[i][j] == 9) {
-        START_ROW = i;
-        START_COL = j;
-        // Convert starting tile to normal tile
-        platformLayout[i][j] = 1;
-        return;
+    // Rebuild the toggle table, keeping the state of surviving switches
+    if (switchesChanged) {
+      std::vector<ToggleGroup> oldGroups;
+      oldGroups.swap(game.toggleGroups);
+      // Show all old bridges; groups that still exist re-hide theirs below
+      for (size_t o = 0; o < oldGroups.size(); o++) {
+        for (size_t t = 0; t < oldGroups[o].tiles.size(); t++) {
+          int row = oldGroups[o].tiles[t].first;
+          int col = oldGroups[o].tiles[t].second;
+          platformEdited.push_back(oldGroups[o].tiles[t]);
+          if (game.source[row][col] == 4 && platformLayout[row][col] == 0) {
+            platformLayout[row][col] = 4;
+            game.tileCount++;
+          }
+        }
+      }
+      simBuildToggleGroups(game);
+      for (size_t g = 0; g < game.toggleGroups.size(); g++) {
+        ToggleGroup &group = game.toggleGroups[g];
+        bool visible = false;
+        for (size_t o = 0; o < oldGroups.size(); o++) {
+          if (oldGroups[o].actionRow == group.actionRow &&
+              oldGroups[o].actionCol == group.actionCol)
+            visible = oldGroups[o].visible;
+        }
+        simSetGroupVisible(game, group, visible);
+        platformEdited.insert(platformEdited.end(), group.tiles.begin(),
+                              group.tiles.end());
       }
     }
   }
-}
 
-// Check if block is standing on the goal tile (type 2)
-void checkWinCondition() {
-  // Only win if block is standing (1x1 footprint)
-  if (block.orientation != STANDING) {
-    return;
+  // Only move the block if the edit removed the ground under it
+  if (simIdle(game) && simBlockShouldFall(game)) {
+    simResetBlock(game);
   }
-  
-  int col = worldToGridCol(block.x);
-  int row = worldToGridRow(block.z);
-  
-  // Check if standing on goal tile (type 2)
-  if (getTileAt(row, col) == 2) {
-    hasWon = true;
-  }
-}
\ No newline at end of file
+  // Undo steps and rewind frames refer to cells and switches of the old
+  // level
+  simClearHistory(game);
+  rewindClear(rewindHistory);
+  recordRewindFrame();
+
+  Clock::time_point applyEnd = Clock::now();
+  reloadParseMs =
+      std::chrono::duration<double, std::milli>(applyStart - parseStart)
+          .count();
+  reloadApplyMs =
+      std::chrono::duration<double, std::milli>(applyEnd - applyStart).count();
+  reloadChangedCells = changedCells;
+  reloadAppliedAt = applyEnd;
+  reloadAwaitingFrame = true;
+}
@@ -1,6 +1,8 @@
 #define GL_SILENCE_DEPRECATION
 #include <GLUT/glut.h>
 #include "headers/menu.h"
+#include "headers/glstate.h"
+#include "headers/render.h"
 
 // Define the external variables
 GameState currentGameState = MENU;
@@ -19,17 +21,17 @@ void renderText(float x, float y, const char* text, void* font) {
 // Draw the startup menu
 void drawMenu() {
     // Switch to 2D orthographic projection for menu
-    glMatrixMode(GL_PROJECTION);
+    stateMatrixMode(GL_PROJECTION);
     glPushMatrix();
     glLoadIdentity();
     gluOrtho2D(0, windowWidth, 0, windowHeight);
-    glMatrixMode(GL_MODELVIEW);
+    stateMatrixMode(GL_MODELVIEW);
     glPushMatrix();
     glLoadIdentity();
 
     // Disable lighting for 2D rendering
-    glDisable(GL_LIGHTING);
-    glDisable(GL_DEPTH_TEST);
+    stateDisable(GL_LIGHTING);
+    stateDisable(GL_DEPTH_TEST);
 
     // Draw title using stroke font (scalable, much larger)
     glColor3f(0.0f, 0.9f, 0.9f);  // Cyan
@@ -46,7 +48,7 @@ void drawMenu() {
     glPushMatrix();
     glTranslatef((windowWidth - scaledTitleWidth) / 2.0f, windowHeight * 0.65f, 0);
     glScalef(scale, scale, 1.0f);
-    glLineWidth(3.0f);
+    stateLineWidth(3.0f);
     for (const char* c = title; *c; c++) {
         glutStrokeCharacter(GLUT_STROKE_ROMAN, *c);
     }
@@ -69,7 +71,7 @@ void drawMenu() {
 
     // Draw button border
     glColor3f(0.0f, 0.9f, 0.9f);  // Cyan
-    glLineWidth(2.0f);
+    stateLineWidth(2.0f);
     glBegin(GL_LINE_LOOP);
     glVertex2i(buttonX, buttonY);
     glVertex2i(buttonX + buttonWidth, buttonY);
@@ -83,16 +85,46 @@ void drawMenu() {
     glColor3f(1.0f, 1.0f, 1.0f);  // White
     renderText(buttonX + (buttonWidth - textWidth) / 2.0f, buttonY + buttonHeight / 2.0f - 5, buttonText, GLUT_BITMAP_HELVETICA_18);
 
-    // Restore state
-    glEnable(GL_DEPTH_TEST);
-    glEnable(GL_LIGHTING);
-
-    glMatrixMode(GL_PROJECTION);
+    // Restore the matrices. Depth testing and lighting stay off; the 3D
+    // scene turns them back on.
+    stateMatrixMode(GL_PROJECTION);
     glPopMatrix();
-    glMatrixMode(GL_MODELVIEW);
+    stateMatrixMode(GL_MODELVIEW);
     glPopMatrix();
 }
 
+// The same with the core renderer: queued with render2D*(), in the pixel
+// font, and drawn by the frame's render2DFlush()
+void drawMenuCore() {
+    stateDisable(GL_DEPTH_TEST);
+
+    const float cyan[4] = {0.0f, 0.9f, 0.9f, 1.0f};
+    const char* title = "BLOXORZ 3D";
+    float titleScale = 8.0f;
+    render2DText((windowWidth - render2DTextWidth(title, titleScale)) / 2.0f,
+                 windowHeight * 0.65f, title, titleScale, cyan);
+
+    // Button, its border 2 pixels wide as the lines are
+    int buttonWidth = 200;
+    int buttonHeight = 50;
+    int buttonX = (windowWidth - buttonWidth) / 2;
+    int buttonY = (windowHeight - buttonHeight) / 2 - 50;
+    const float gray[4] = {0.3f, 0.3f, 0.4f, 1.0f};
+    render2DRect(buttonX, buttonY, buttonWidth, buttonHeight, gray);
+    render2DRect(buttonX - 1, buttonY - 1, buttonWidth + 2, 2, cyan);
+    render2DRect(buttonX - 1, buttonY + buttonHeight - 1, buttonWidth + 2, 2,
+                 cyan);
+    render2DRect(buttonX - 1, buttonY + 1, 2, buttonHeight - 2, cyan);
+    render2DRect(buttonX + buttonWidth - 1, buttonY + 1, 2, buttonHeight - 2,
+                 cyan);
+
+    const char* buttonText = "New Game";
+    const float white[4] = {1.0f, 1.0f, 1.0f, 1.0f};
+    float textWidth = render2DTextWidth(buttonText, 2.0f);
+    render2DText(buttonX + (buttonWidth - textWidth) / 2.0f,
+                 buttonY + buttonHeight / 2.0f - 5, buttonText, 2.0f, white);
+}
+
 // Handle mouse clicks
 void mouseClick(int button, int state, int x, int y) {
     if (button == GLUT_LEFT_BUTTON && state == GLUT_DOWN) {
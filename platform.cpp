@@ -0,0 +1,1008 @@
+#define GL_SILENCE_DEPRECATION // Ignore deprecation errors
+#include "headers/platform.h"
+#include "headers/glstate.h"
+#include <GLUT/glut.h>
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+
+static const GLfloat EDGE_COLOR[] = {0.0f, 0.9f, 0.9f}; // Cyan
+
+// Baked faces and the tile map carry their lighting (see platformmesh.h),
+// so their shaders only pass on the colour, the position in grid units and
+// the face normal for the outlines. The instanced shader lights as the
+// fixed pipeline does for one directional light with no specular (the
+// platform material has none), from the tile's diffuse colour. Fragment
+// shaders are shared by both renderers, written for 1.20 with fragColor as
+// the output (see buildProgram()).
+#define VARYINGS_GLSL                                                        \
+  "varying vec3 position;\n"                                               \
+  "varying vec3 faceNormal;\n"
+
+#define LIGHTING_GLSL                                                        \
+  "vec4 light(vec3 normal, vec4 diffuse) {\n"                              \
+  "  vec3 n = normalize(gl_NormalMatrix * normal);\n"                     \
+  "  vec3 l = normalize(gl_LightSource[0].position.xyz);\n"               \
+  "  vec3 lit = gl_FrontLightModelProduct.sceneColor.rgb +\n"             \
+  "             gl_FrontLightProduct[0].ambient.rgb +\n"                  \
+  "             max(dot(n, l), 0.0) * gl_LightSource[0].diffuse.rgb *\n"  \
+  "                 diffuse.rgb;\n"                                        \
+  "  return vec4(lit, diffuse.a);\n"                                       \
+  "}\n"
+
+// Baked faces, coloured per vertex
+static const char *BAKED_SHADER =
+    VARYINGS_GLSL
+    "varying vec4 color;\n"
+    "void main() {\n"
+    "  gl_Position = ftransform();\n"
+    "  position = gl_Vertex.xyz;\n"
+    "  faceNormal = gl_Normal;\n"
+    "  color = gl_Color;\n"
+    "}\n";
+
+static const char *CORE_BAKED_SHADER =
+    VARYINGS_GLSL
+    "uniform mat4 model;\n"
+    "attribute vec3 corner;\n"
+    "attribute vec3 normal;\n"
+    "attribute vec4 tileColor;\n"
+    "varying vec4 color;\n"
+    "void main() {\n"
+    "  gl_Position = projection * view * model * vec4(corner, 1.0);\n"
+    "  position = corner;\n"
+    "  faceNormal = normal;\n"
+    "  color = tileColor;\n"
+    "}\n";
+
+// Instanced faces. Hidden tiles are moved outside the clip volume.
+static const char *INSTANCED_SHADER =
+    VARYINGS_GLSL
+    LIGHTING_GLSL
+    "attribute vec3 corner;\n"
+    "attribute vec3 normal;\n"
+    "attribute vec2 cell;\n"
+    "attribute float type;\n"
+    "attribute float shown;\n"
+    "uniform vec4 colors[6];\n"
+    "varying vec4 color;\n"
+    "void main() {\n"
+    "  if (shown == 0.0) {\n"
+    "    gl_Position = vec4(2.0, 2.0, 2.0, 1.0);\n"
+    "    return;\n"
+    "  }\n"
+    "  position = vec3(corner.x + cell.x, corner.y, corner.z + cell.y);\n"
+    "  gl_Position = gl_ModelViewProjectionMatrix * vec4(position, 1.0);\n"
+    "  faceNormal = normal;\n"
+    "  color = light(normal, colors[int(type)]);\n"
+    "}\n";
+
+// Far chunks: a quad over the chunk, coloured per cell from the tile map
+static const char *FLAT_SHADER =
+    VARYINGS_GLSL
+    "void main() {\n"
+    "  gl_Position = ftransform();\n"
+    "  position = gl_Vertex.xyz;\n"
+    "  faceNormal = vec3(0.0, 1.0, 0.0);\n"
+    "}\n";
+
+static const char *CORE_FLAT_SHADER =
+    VARYINGS_GLSL
+    "uniform mat4 model;\n"
+    "attribute vec3 corner;\n"
+    "void main() {\n"
+    "  gl_Position = projection * view * model * vec4(corner, 1.0);\n"
+    "  position = corner;\n"
+    "  faceNormal = vec3(0.0, 1.0, 0.0);\n"
+    "}\n";
+
+// Tile outlines, drawn with the faces. Tile edges lie on whole grid units,
+// so a fragment within about a pixel of one (along either axis of its
+// face) takes the edge colour. Each edge is drawn once however the faces
+// were merged. Where tiles shrink to a few pixels the lines fade out
+// rather than cover them.
+#define OUTLINE_GLSL                                                         \
+  VARYINGS_GLSL                                                            \
+  "const vec3 EDGE = vec3(0.0, 0.9, 0.9);\n"                               \
+  "float outline() {\n"                                                    \
+  "  vec3 width = max(fwidth(position), vec3(1e-4));\n"                   \
+  "  vec3 pixels = abs(fract(position + 0.5) - 0.5) / width;\n"           \
+  "  pixels += step(0.5, abs(faceNormal)) * 1e4;\n"                       \
+  "  float line = 1.0 - smoothstep(0.25, 0.75,\n"                         \
+  "                                min(pixels.x, min(pixels.y, pixels.z)));\n" \
+  "  float tile = max(width.x, max(width.y, width.z));\n"                 \
+  "  return line * (1.0 - smoothstep(0.25, 0.5, tile));\n"                \
+  "}\n"
+
+static const char *FACE_FRAGMENT_SHADER =
+    OUTLINE_GLSL
+    "varying vec4 color;\n"
+    "void main() {\n"
+    "  fragColor = mix(color, vec4(EDGE, 1.0), outline());\n"
+    "}\n";
+
+static const char *FLAT_FRAGMENT_SHADER =
+    OUTLINE_GLSL
+    "uniform sampler2D map;\n"
+    "uniform vec2 mapScale;\n" // 1 / columns, 1 / rows
+    "void main() {\n"
+    "  vec4 tile = texture2D(map, position.xz * mapScale);\n"
+    "  if (tile.a == 0.0)\n"
+    "    discard;\n"
+    "  fragColor = mix(tile, vec4(EDGE, 1.0), outline());\n"
+    "}\n";
+
+// Attribute locations (corner takes 0, which stands in for gl_Vertex)
+enum {
+  ATTRIB_CORNER,
+  ATTRIB_NORMAL,
+  ATTRIB_CELL,
+  ATTRIB_TYPE,
+  ATTRIB_SHOWN,
+  ATTRIB_COLOR, // Core only; legacy reads gl_Color
+  ATTRIB_COUNT
+};
+static const char *ATTRIBUTES[ATTRIB_COUNT] = {"corner", "normal", "cell",
+                                               "type",   "shown",  "tileColor"};
+
+static bool hasExtension(const char *name) {
+  const char *list = (const char *)glGetString(GL_EXTENSIONS);
+  size_t len = strlen(name);
+  for (const char *p = list; p && (p = strstr(p, name)); p += len) {
+    if ((p == list || p[-1] == ' ') && (p[len] == ' ' || p[len] == '\0'))
+      return true;
+  }
+  return false;
+}
+
+// True if a legacy context runs GLSL vertex and fragment shaders
+static bool legacyShadersSupported() {
+  static int supported = -1;
+  if (supported < 0)
+    supported = hasExtension("GL_ARB_vertex_shader") &&
+                hasExtension("GL_ARB_fragment_shader");
+  return supported;
+}
+
+// Core contexts always do, and have no extension string to check
+static bool shadersSupported(const PlatformBuffers &buffers) {
+  return buffers.core || legacyShadersSupported();
+}
+
+bool platformInstancingSupported() {
+  static int supported = -1;
+  if (supported < 0) {
+    supported = hasExtension("GL_ARB_instanced_arrays") &&
+                hasExtension("GL_ARB_draw_instanced") &&
+                legacyShadersSupported();
+    if (!supported)
+      printf("Instanced platform needs ARB_instanced_arrays, "
+             "ARB_draw_instanced and GLSL shaders\n");
+  }
+  return supported;
+}
+
+static GLuint compileShader(GLenum type, const char *prefix,
+                            const char *source, char *log, int logSize) {
+  GLuint shader = glCreateShader(type);
+  const char *sources[2] = {prefix, source};
+  glShaderSource(shader, 2, sources, NULL);
+  glCompileShader(shader);
+  GLint ok;
+  glGetShaderiv(shader, GL_COMPILE_STATUS, &ok);
+  if (!ok) {
+    glGetShaderInfoLog(shader, logSize, NULL, log);
+    glDeleteShader(shader);
+    return 0;
+  }
+  return shader;
+}
+
+// Link a program from a vertex and fragment shader, with the attributes at
+// their locations: the legacy vertex shader as GLSL 1.20, or the core one
+// through renderProgram(). 0 on errors, which are printed.
+static unsigned int buildProgram(const PlatformBuffers &buffers,
+                                 const char *vertexSource,
+                                 const char *coreVertexSource,
+                                 const char *fragmentSource) {
+  if (buffers.core)
+    return renderProgram(coreVertexSource, fragmentSource, ATTRIBUTES,
+                         ATTRIB_COUNT);
+  char log[1024] = "";
+  GLuint shaders[2] = {compileShader(GL_VERTEX_SHADER, "#version 120\n",
+                                     vertexSource, log, sizeof(log)),
+                       0};
+  if (shaders[0])
+    shaders[1] = compileShader(GL_FRAGMENT_SHADER,
+                               "#version 120\n"
+                               "#define fragColor gl_FragColor\n",
+                               fragmentSource, log, sizeof(log));
+  GLuint program = 0;
+  if (shaders[0] && shaders[1]) {
+    program = glCreateProgram();
+    for (int i = 0; i < 2; i++)
+      glAttachShader(program, shaders[i]);
+    for (int a = 0; a < ATTRIB_COUNT; a++)
+      glBindAttribLocation(program, a, ATTRIBUTES[a]);
+    glLinkProgram(program);
+    GLint ok;
+    glGetProgramiv(program, GL_LINK_STATUS, &ok);
+    if (!ok) {
+      glGetProgramInfoLog(program, sizeof(log), NULL, log);
+      glDeleteProgram(program);
+      program = 0;
+    }
+  }
+  for (int i = 0; i < 2; i++)
+    if (shaders[i])
+      glDeleteShader(shaders[i]); // Freed with the program
+  if (!program)
+    printf("Platform shader error: %s\n", log);
+  return program;
+}
+
+static unsigned int buildInstancedProgram(const PlatformBuffers &buffers) {
+  GLuint program =
+      buildProgram(buffers, INSTANCED_SHADER, NULL, FACE_FRAGMENT_SHADER);
+  if (!program)
+    return 0;
+  GLfloat colors[MESH_TILE_TYPES * 4];
+  for (int t = 0; t < MESH_TILE_TYPES; t++)
+    for (int i = 0; i < 4; i++)
+      colors[t * 4 + i] = meshTileColor(t)[i] / 255.0f;
+  stateUseProgram(program);
+  glUniform4fv(glGetUniformLocation(program, "colors"), MESH_TILE_TYPES,
+               colors);
+  stateUseProgram(0);
+  return program;
+}
+
+// The faces of the instanced path's unit cube: a tile at row 0, column 0
+static void uploadCube(PlatformBuffers &buffers) {
+  MeshVertex faces[TILE_FACE_VERTICES];
+  MeshPoint edges[TILE_EDGE_VERTICES];
+  meshWriteCube(faces, edges, 0, 0, 1);
+  glGenBuffers(1, &buffers.cube);
+  glBindBuffer(GL_ARRAY_BUFFER, buffers.cube);
+  glBufferData(GL_ARRAY_BUFFER, sizeof(faces), faces, GL_STATIC_DRAW);
+}
+
+// The chunk's faces, and its edges only when there is no face shader to
+// outline them
+static void uploadChunk(ChunkBuffers &chunk, const MeshChunk &mesh,
+                        bool lines) {
+  chunk.faceVertices = mesh.faces.size();
+  chunk.topVertices = mesh.topVertices;
+  chunk.sorted = false;
+  chunk.edgeVertices = lines ? mesh.edges.size() : 0;
+  if (chunk.faces == 0) {
+    if (mesh.faces.empty() && chunk.edgeVertices == 0)
+      return;
+    glGenBuffers(1, &chunk.faces);
+    if (lines)
+      glGenBuffers(1, &chunk.edges);
+  }
+  glBindBuffer(GL_ARRAY_BUFFER, chunk.faces);
+  glBufferData(GL_ARRAY_BUFFER, mesh.faces.size() * sizeof(MeshVertex),
+               mesh.faces.data(), GL_DYNAMIC_DRAW);
+  if (lines) {
+    glBindBuffer(GL_ARRAY_BUFFER, chunk.edges);
+    glBufferData(GL_ARRAY_BUFFER, mesh.edges.size() * sizeof(MeshPoint),
+                 mesh.edges.data(), GL_DYNAMIC_DRAW);
+  }
+}
+
+static void releaseChunks(PlatformBuffers &buffers) {
+  for (size_t c = 0; c < buffers.chunks.size(); c++) {
+    ChunkBuffers &chunk = buffers.chunks[c];
+    if (chunk.faces)
+      glDeleteBuffers(1, &chunk.faces);
+    if (chunk.edges)
+      glDeleteBuffers(1, &chunk.edges);
+    if (chunk.order)
+      glDeleteBuffers(1, &chunk.order);
+  }
+  buffers.chunks.clear();
+}
+
+// The tile map, a texel per cell, and a quad over each chunk's bounds
+// (empty chunks get an empty one). Without fragment shaders, or with a
+// level too big for one texture, far chunks keep their tops instead.
+static void uploadFlat(PlatformBuffers &buffers, const PlatformMesh &mesh) {
+  if (buffers.map) {
+    glDeleteTextures(1, &buffers.map);
+    buffers.map = 0;
+    buffers.mapBytes = 0;
+  }
+  if (shadersSupported(buffers) && buffers.flatProgram == 0)
+    buffers.flatProgram = buildProgram(buffers, FLAT_SHADER, CORE_FLAT_SHADER,
+                                       FLAT_FRAGMENT_SHADER);
+  GLint maxSize;
+  glGetIntegerv(GL_MAX_TEXTURE_SIZE, &maxSize);
+  if (buffers.flatProgram && mesh.rows > 0 && mesh.rows <= maxSize &&
+      mesh.cols <= maxSize) {
+    glGenTextures(1, &buffers.map);
+    stateBindTexture(buffers.map);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, mesh.cols, mesh.rows, 0, GL_RGBA,
+                 GL_UNSIGNED_BYTE, mesh.map.data());
+    stateBindTexture(0);
+    buffers.mapBytes = mesh.map.size();
+    stateUseProgram(buffers.flatProgram);
+    glUniform2f(glGetUniformLocation(buffers.flatProgram, "mapScale"),
+                1.0f / mesh.cols, 1.0f / mesh.rows);
+    glUniform1i(glGetUniformLocation(buffers.flatProgram, "map"), 0);
+    stateUseProgram(0);
+  }
+
+  std::vector<MeshPoint> quads(mesh.chunks.size() * 4);
+  for (size_t c = 0; c < mesh.chunks.size(); c++) {
+    const MeshChunk &chunk = mesh.chunks[c];
+    if (chunk.tiles == 0)
+      continue;
+    MeshPoint *quad = &quads[c * 4];
+    // Wound as the tile tops
+    short x0 = chunk.minCol, x1 = chunk.maxCol;
+    short z0 = chunk.minRow, z1 = chunk.maxRow;
+    MeshPoint corners[4] = {
+        {x0, 0, z0, 0}, {x0, 0, z1, 0}, {x1, 0, z1, 0}, {x1, 0, z0, 0}};
+    memcpy(quad, corners, sizeof(corners));
+  }
+  if (buffers.flat == 0)
+    glGenBuffers(1, &buffers.flat);
+  glBindBuffer(GL_ARRAY_BUFFER, buffers.flat);
+  glBufferData(GL_ARRAY_BUFFER, quads.size() * sizeof(MeshPoint),
+               quads.data(), GL_STATIC_DRAW);
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+// Upload the tile map texels of columns col .. col + cols - 1 and rows
+// row .. row + rows - 1
+static void updateMap(const PlatformBuffers &buffers, const PlatformMesh &mesh,
+                      int row, int col, int rows, int cols) {
+  stateBindTexture(buffers.map);
+  glPixelStorei(GL_UNPACK_ROW_LENGTH, mesh.cols);
+  glTexSubImage2D(GL_TEXTURE_2D, 0, col, row, cols, rows, GL_RGBA,
+                  GL_UNSIGNED_BYTE,
+                  &mesh.map[((size_t)row * mesh.cols + col) * 4]);
+  glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+  stateBindTexture(0);
+}
+
+// Triangles for quads 0 .. quads - 1 (corners 0, 1, 2 and 0, 2, 3 of each),
+// as core contexts have no GL_QUADS. The buffer only grows.
+static void uploadQuadIndices(PlatformBuffers &buffers, int quads) {
+  if (!buffers.core || quads <= buffers.quadIndexCount)
+    return;
+  static const int QUAD_TRIANGLES[6] = {0, 1, 2, 0, 2, 3};
+  std::vector<GLuint> indices((size_t)quads * 6);
+  for (size_t i = 0; i < indices.size(); i++)
+    indices[i] = i / 6 * 4 + QUAD_TRIANGLES[i % 6];
+  if (buffers.quadIndices == 0)
+    glGenBuffers(1, &buffers.quadIndices);
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, buffers.quadIndices);
+  glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(GLuint),
+               indices.data(), GL_STATIC_DRAW);
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+  buffers.quadIndexCount = quads;
+}
+
+void platformUpload(PlatformBuffers &buffers, const PlatformMesh &mesh) {
+  buffers.slots = mesh.slotCount;
+  buffers.instanced = mesh.instanced;
+  releaseChunks(buffers);
+  buffers.lods.assign(mesh.chunks.size(), LOD_FULL);
+  buffers.chunkOrder.clear();
+  uploadFlat(buffers, mesh);
+  if (buffers.instanced) {
+    if (buffers.program == 0) {
+      buffers.program = buildInstancedProgram(buffers);
+      uploadCube(buffers);
+      glGenBuffers(1, &buffers.instances);
+      glGenBuffers(1, &buffers.visible);
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, buffers.instances);
+    glBufferData(GL_ARRAY_BUFFER,
+                 mesh.instances.size() * sizeof(TileInstance),
+                 mesh.instances.data(), GL_STATIC_DRAW);
+    glBindBuffer(GL_ARRAY_BUFFER, buffers.visible);
+    glBufferData(GL_ARRAY_BUFFER, mesh.visible.size(), mesh.visible.data(),
+                 GL_DYNAMIC_DRAW);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    return;
+  }
+  if (shadersSupported(buffers) && buffers.faceProgram == 0)
+    buffers.faceProgram = buildProgram(buffers, BAKED_SHADER, CORE_BAKED_SHADER,
+                                       FACE_FRAGMENT_SHADER);
+  ChunkBuffers none = {};
+  buffers.chunks.assign(mesh.chunks.size(), none);
+  int quads = mesh.chunks.size(); // The flat quads
+  for (size_t c = 0; c < mesh.chunks.size(); c++) {
+    uploadChunk(buffers.chunks[c], mesh.chunks[c], !buffers.faceProgram);
+    quads = std::max(quads, (int)mesh.chunks[c].faces.size() / 4);
+  }
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+  uploadQuadIndices(buffers, quads);
+}
+
+void platformUpdate(PlatformBuffers &buffers, const PlatformMesh &mesh,
+                    std::vector<int> &changed) {
+  if (changed.empty())
+    return;
+  if (!buffers.instanced) {
+    for (size_t i = 0; i < changed.size(); i++) {
+      const MeshChunk &chunk = mesh.chunks[changed[i]];
+      uploadChunk(buffers.chunks[changed[i]], chunk, !buffers.faceProgram);
+      uploadQuadIndices(buffers, chunk.faces.size() / 4);
+      if (buffers.map)
+        updateMap(buffers, mesh, chunk.row0, chunk.col0, chunk.rows,
+                  chunk.cols);
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    return;
+  }
+  // Visibility for toggles, and the type too for cells edited in place
+  std::sort(changed.begin(), changed.end());
+  for (size_t s = 0; s < changed.size();) {
+    size_t end = s + 1;
+    while (end < changed.size() && changed[end] <= changed[end - 1] + 1)
+      end++;
+    int first = changed[s], count = changed[end - 1] - first + 1;
+    glBindBuffer(GL_ARRAY_BUFFER, buffers.visible);
+    glBufferSubData(GL_ARRAY_BUFFER, first, count, &mesh.visible[first]);
+    glBindBuffer(GL_ARRAY_BUFFER, buffers.instances);
+    glBufferSubData(GL_ARRAY_BUFFER, first * sizeof(TileInstance),
+                    count * sizeof(TileInstance), &mesh.instances[first]);
+    s = end;
+  }
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+  if (buffers.map) {
+    for (size_t s = 0; s < changed.size(); s++) {
+      const TileInstance &instance = mesh.instances[changed[s]];
+      updateMap(buffers, mesh, instance.row, instance.col, 1, 1);
+    }
+  }
+}
+
+// Clip planes (a, b, c, d with ax + by + cz + d >= 0 inside) of the current
+// projection times modelview
+static void viewFrustum(const GLfloat projection[16],
+                        const GLfloat modelview[16], GLfloat planes[6][4]) {
+  GLfloat m[16];
+  for (int col = 0; col < 4; col++)
+    for (int row = 0; row < 4; row++) {
+      m[col * 4 + row] = 0.0f;
+      for (int k = 0; k < 4; k++)
+        m[col * 4 + row] += projection[k * 4 + row] * modelview[col * 4 + k];
+    }
+  // Left, right, bottom, top, near, far: the last row plus or minus another
+  for (int p = 0; p < 6; p++) {
+    float sign = p % 2 ? -1.0f : 1.0f;
+    for (int i = 0; i < 4; i++)
+      planes[p][i] = m[i * 4 + 3] + sign * m[i * 4 + p / 2];
+  }
+}
+
+// False when the chunk's bounds are wholly outside one of the planes
+static bool chunkInView(const MeshChunk &chunk, const GLfloat planes[6][4]) {
+  for (int p = 0; p < 6; p++) {
+    const GLfloat *plane = planes[p];
+    // The box corner furthest along the plane's normal
+    float x = plane[0] >= 0.0f ? chunk.maxCol : chunk.minCol;
+    float y = plane[1] >= 0.0f ? 0.0f : -1.0f;
+    float z = plane[2] >= 0.0f ? chunk.maxRow : chunk.minRow;
+    if (plane[0] * x + plane[1] * y + plane[2] * z + plane[3] < 0.0f)
+      return false;
+  }
+  return true;
+}
+
+// Pixels a tile covers (lengthwise) below which a chunk drops to the next
+// level of detail, and how far past it the chunk must get to come back
+static const float LOD_PIXELS[LOD_LEVELS - 1] = {12.0f, 6.0f};
+static const float LOD_HYSTERESIS = 1.25f;
+
+// Where the camera is, in grid units, from a modelview of rotations,
+// translations and uniform scales
+static void viewEye(const GLfloat m[16], float eye[3]) {
+  float scale2 = m[0] * m[0] + m[1] * m[1] + m[2] * m[2];
+  for (int i = 0; i < 3; i++)
+    eye[i] = -(m[i * 4] * m[12] + m[i * 4 + 1] * m[13] +
+               m[i * 4 + 2] * m[14]) / scale2;
+}
+
+// Distance from the eye to the nearest point of the chunk's bounds
+static float chunkDistance(const MeshChunk &chunk, const float eye[3]) {
+  float dx = std::max(std::max(chunk.minCol - eye[0], 0.0f),
+                      eye[0] - chunk.maxCol);
+  float dy = std::max(std::max(-1.0f - eye[1], 0.0f), eye[1]);
+  float dz = std::max(std::max(chunk.minRow - eye[2], 0.0f),
+                      eye[2] - chunk.maxRow);
+  return sqrtf(dx * dx + dy * dy + dz * dz);
+}
+
+// The view's direction around the vertical, in octants (0 to 7 from +x
+// towards +z), from the modelview's third row (the eye's backward axis)
+static const float OCTANT = 0.785398163f; // Radians
+static int viewOctant(const GLfloat m[16]) {
+  int octant = (int)floorf(atan2f(-m[10], -m[2]) / OCTANT);
+  return (octant + 8) % 8;
+}
+
+// Chunks back to front for views in the octant, as for a parallel view:
+// rows and columns each walked from the far side, along the axis the view
+// is closer to in the outer loop
+static void orderChunks(PlatformBuffers &buffers, const PlatformMesh &mesh,
+                        int octant) {
+  float dx = cosf((octant + 0.5f) * OCTANT);
+  float dz = sinf((octant + 0.5f) * OCTANT);
+  bool rowsOuter = fabsf(dz) > fabsf(dx);
+  int outer = rowsOuter ? mesh.chunkRows : mesh.chunkCols;
+  int inner = rowsOuter ? mesh.chunkCols : mesh.chunkRows;
+  buffers.chunkOrder.clear();
+  for (int a = 0; a < outer; a++) {
+    for (int b = 0; b < inner; b++) {
+      int row = rowsOuter ? a : b, col = rowsOuter ? b : a;
+      if (dz > 0.0f)
+        row = mesh.chunkRows - 1 - row;
+      if (dx > 0.0f)
+        col = mesh.chunkCols - 1 - col;
+      buffers.chunkOrder.push_back(row * mesh.chunkCols + col);
+    }
+  }
+  buffers.octant = octant;
+}
+
+// Chunks to draw at each level of detail, in order
+static std::vector<int> drawLists[LOD_LEVELS];
+
+static void listChunks(PlatformBuffers &buffers, const PlatformMesh &mesh,
+                       const GLfloat projection[16],
+                       const GLfloat modelview[16], int viewportHeight,
+                       int options, PlatformStats &stats) {
+  GLfloat planes[6][4];
+  bool cull = options & PLATFORM_CULL;
+  if (cull)
+    viewFrustum(projection, modelview, planes);
+  // A tile at distance d covers about pixelScale / d pixels
+  float eye[3];
+  viewEye(modelview, eye);
+  float pixelScale = viewportHeight * projection[5] / 2.0f;
+  int coarsest = options & PLATFORM_LOD ? buffers.map ? LOD_FLAT : LOD_TOPS
+                                        : LOD_FULL;
+  bool sort = options & PLATFORM_SORT;
+  if (sort) {
+    int octant = viewOctant(modelview);
+    if (octant != buffers.octant ||
+        buffers.chunkOrder.size() != mesh.chunks.size())
+      orderChunks(buffers, mesh, octant);
+  }
+
+  for (int l = 0; l < LOD_LEVELS; l++)
+    drawLists[l].clear();
+  for (size_t i = 0; i < mesh.chunks.size(); i++) {
+    int c = sort ? buffers.chunkOrder[i] : i;
+    const MeshChunk &chunk = mesh.chunks[c];
+    if (chunk.tiles == 0)
+      continue;
+    if (cull && !chunkInView(chunk, planes)) {
+      stats.chunksCulled++;
+      continue;
+    }
+    int lod = LOD_FULL;
+    if (coarsest != LOD_FULL) {
+      float pixels = pixelScale / std::max(chunkDistance(chunk, eye), 1e-3f);
+      lod = std::min((int)buffers.lods[c], coarsest);
+      while (lod < coarsest && pixels < LOD_PIXELS[lod])
+        lod++;
+      while (lod > LOD_FULL && pixels > LOD_PIXELS[lod - 1] * LOD_HYSTERESIS)
+        lod--;
+      buffers.lods[c] = lod;
+    }
+    stats.chunksDrawn++;
+    stats.chunksAt[lod]++;
+    drawLists[lod].push_back(c);
+  }
+  // Flat quads all lie in the tile plane, so any order will do; ascending,
+  // neighbours draw together
+  if (sort)
+    std::sort(drawLists[LOD_FLAT].begin(), drawLists[LOD_FLAT].end());
+}
+
+// Sort keys (distance << 16 | quad) and the radix passes' output
+static std::vector<float> sortDistances;
+static std::vector<unsigned int> sortKeys, sortScratch;
+static std::vector<GLushort> sortIndices;
+
+// Sort the chunk's faces back to front from 'eye' and upload their indices:
+// the quads' corners, or in core their two triangles. The key is the
+// distance from the eye to a quad's centre in 16 bits, furthest lowest,
+// sorted in two 8-bit radix passes. A chunk has at most 20 * 32 * 32
+// vertices, so short indices do.
+static void sortChunk(ChunkBuffers &chunk, const MeshChunk &mesh,
+                      const float eye[3], bool core) {
+  static const int QUAD_CORNERS[4] = {0, 1, 2, 3};
+  static const int QUAD_TRIANGLES[6] = {0, 1, 2, 0, 2, 3};
+  int quads = mesh.faces.size() / 4;
+  sortDistances.resize(quads);
+  float furthest = 1e-6f;
+  for (int q = 0; q < quads; q++) {
+    const MeshVertex *quad = &mesh.faces[q * 4];
+    float x = 0.0f, y = 0.0f, z = 0.0f;
+    for (int v = 0; v < 4; v++) {
+      x += quad[v].position.x;
+      y += quad[v].position.y;
+      z += quad[v].position.z;
+    }
+    x = x / 4.0f - eye[0];
+    y = y / 4.0f - eye[1];
+    z = z / 4.0f - eye[2];
+    sortDistances[q] = sqrtf(x * x + y * y + z * z);
+    furthest = std::max(furthest, sortDistances[q]);
+  }
+  sortKeys.resize(quads);
+  sortScratch.resize(quads);
+  for (int q = 0; q < quads; q++) {
+    unsigned int key =
+        (unsigned int)((1.0f - sortDistances[q] / furthest) * 65535.0f);
+    sortKeys[q] = key << 16 | q;
+  }
+  for (int shift = 16; shift < 32; shift += 8) {
+    int counts[257] = {};
+    for (int q = 0; q < quads; q++)
+      counts[((sortKeys[q] >> shift) & 255) + 1]++;
+    for (int b = 1; b < 257; b++)
+      counts[b] += counts[b - 1];
+    for (int q = 0; q < quads; q++)
+      sortScratch[counts[(sortKeys[q] >> shift) & 255]++] = sortKeys[q];
+    sortKeys.swap(sortScratch);
+  }
+
+  const int *corners = core ? QUAD_TRIANGLES : QUAD_CORNERS;
+  int perQuad = core ? 6 : 4;
+  sortIndices.resize((size_t)quads * perQuad);
+  for (int q = 0; q < quads; q++) {
+    int first = (sortKeys[q] & 0xFFFF) * 4;
+    for (int i = 0; i < perQuad; i++)
+      sortIndices[q * perQuad + i] = first + corners[i];
+  }
+  if (chunk.order == 0)
+    glGenBuffers(1, &chunk.order);
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, chunk.order);
+  glBufferData(GL_ELEMENT_ARRAY_BUFFER, sortIndices.size() * sizeof(GLushort),
+               sortIndices.data(), GL_STREAM_DRAW);
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+}
+
+// Sort the listed full chunks whose faces are not in order for the eye
+static void sortChunks(PlatformBuffers &buffers, const PlatformMesh &mesh,
+                       const GLfloat modelview[16], PlatformStats &stats) {
+  float eye[3];
+  viewEye(modelview, eye);
+  const std::vector<int> &full = drawLists[LOD_FULL];
+  for (size_t i = 0; i < full.size(); i++) {
+    ChunkBuffers &chunk = buffers.chunks[full[i]];
+    if (chunk.faceVertices == 0 ||
+        (chunk.sorted && memcmp(chunk.sortEye, eye, sizeof(eye)) == 0))
+      continue;
+    sortChunk(chunk, mesh.chunks[full[i]], eye, buffers.core);
+    chunk.sorted = true;
+    memcpy(chunk.sortEye, eye, sizeof(eye));
+    stats.chunksSorted++;
+  }
+}
+
+// Point the instance attributes at the slots from 'first' on
+static void pointInstances(const PlatformBuffers &buffers, int first) {
+  glBindBuffer(GL_ARRAY_BUFFER, buffers.instances);
+  glVertexAttribPointer(ATTRIB_CELL, 2, GL_SHORT, GL_FALSE,
+                        sizeof(TileInstance),
+                        (const GLvoid *)(first * sizeof(TileInstance)));
+  glVertexAttribPointer(ATTRIB_TYPE, 1, GL_UNSIGNED_BYTE, GL_FALSE,
+                        sizeof(TileInstance),
+                        (const GLvoid *)(first * sizeof(TileInstance) +
+                                         offsetof(TileInstance, type)));
+  glBindBuffer(GL_ARRAY_BUFFER, buffers.visible);
+  glVertexAttribPointer(ATTRIB_SHOWN, 1, GL_UNSIGNED_BYTE, GL_FALSE, 1,
+                        (const GLvoid *)(size_t)first);
+}
+
+// Listed chunks are runs of slots; adjacent ones draw as one range
+static void drawRuns(const PlatformBuffers &buffers, const PlatformMesh &mesh,
+                     const std::vector<int> &list, GLenum mode, int first,
+                     int count, PlatformStats &stats) {
+  for (size_t i = 0; i < list.size();) {
+    int slot = mesh.chunks[list[i]].firstSlot;
+    int end = slot;
+    for (; i < list.size() && mesh.chunks[list[i]].firstSlot == end; i++)
+      end += mesh.chunks[list[i]].tiles;
+    pointInstances(buffers, slot);
+    glDrawArraysInstancedARB(mode, first, count, end - slot);
+    stats.drawCalls++;
+  }
+}
+
+static void drawInstanced(const PlatformBuffers &buffers,
+                          const PlatformMesh &mesh, PlatformStats &stats) {
+  const std::vector<int> &full = drawLists[LOD_FULL];
+  const std::vector<int> &tops = drawLists[LOD_TOPS];
+  if (full.empty() && tops.empty())
+    return;
+  stateUseProgram(buffers.program);
+  GLsizei stride = sizeof(MeshVertex);
+  glBindBuffer(GL_ARRAY_BUFFER, buffers.cube);
+  glVertexAttribPointer(ATTRIB_CORNER, 3, GL_SHORT, GL_FALSE, stride,
+                        (const GLvoid *)offsetof(MeshVertex, position));
+  glVertexAttribPointer(ATTRIB_NORMAL, 3, GL_BYTE, GL_TRUE, stride,
+                        (const GLvoid *)offsetof(MeshVertex, normal));
+  for (int a = ATTRIB_CORNER; a <= ATTRIB_SHOWN; a++) {
+    glEnableVertexAttribArray(a);
+    glVertexAttribDivisorARB(a, a >= ATTRIB_CELL);
+  }
+
+  // Tops first, as those chunks are further away
+  drawRuns(buffers, mesh, tops, GL_QUADS, TILE_TOP_VERTEX, 4, stats);
+  drawRuns(buffers, mesh, full, GL_QUADS, 0, TILE_FACE_VERTICES, stats);
+
+  for (int a = ATTRIB_CORNER; a <= ATTRIB_SHOWN; a++) {
+    glVertexAttribDivisorARB(a, 0);
+    glDisableVertexAttribArray(a);
+  }
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+  stateUseProgram(0);
+}
+
+static void drawBaked(const PlatformBuffers &buffers, bool sorted,
+                      PlatformStats &stats) {
+  GLsizei stride = sizeof(MeshVertex);
+  bool lines = buffers.faceProgram == 0;
+
+  // Faces: vertex colours are already lit, and the shader outlines them.
+  // Without it they are drawn with lighting off, pushed back a little so
+  // the edges, drawn on the same lines after, win the depth test. Chunks
+  // with tops only (further away, so first) draw just the first part;
+  // sorted full chunks draw through their order.
+  glEnableClientState(GL_VERTEX_ARRAY);
+  glEnableClientState(GL_NORMAL_ARRAY);
+  glEnableClientState(GL_COLOR_ARRAY);
+  if (lines) {
+    stateDisable(GL_LIGHTING);
+    stateEnable(GL_POLYGON_OFFSET_FILL);
+    glPolygonOffset(1.0f, 1.0f);
+  } else {
+    stateUseProgram(buffers.faceProgram);
+  }
+  for (int lod = LOD_TOPS; lod >= LOD_FULL; lod--) {
+    const std::vector<int> &list = drawLists[lod];
+    for (size_t i = 0; i < list.size(); i++) {
+      const ChunkBuffers &chunk = buffers.chunks[list[i]];
+      int vertices = lod == LOD_FULL ? chunk.faceVertices : chunk.topVertices;
+      if (vertices == 0)
+        continue;
+      glBindBuffer(GL_ARRAY_BUFFER, chunk.faces);
+      glVertexPointer(3, GL_SHORT, stride,
+                      (const GLvoid *)offsetof(MeshVertex, position));
+      glNormalPointer(GL_BYTE, stride,
+                      (const GLvoid *)offsetof(MeshVertex, normal));
+      glColorPointer(4, GL_UNSIGNED_BYTE, stride,
+                     (const GLvoid *)offsetof(MeshVertex, color));
+      if (sorted && lod == LOD_FULL) {
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, chunk.order);
+        glDrawElements(GL_QUADS, vertices, GL_UNSIGNED_SHORT, 0);
+      } else {
+        glDrawArrays(GL_QUADS, 0, vertices);
+      }
+      stats.drawCalls++;
+      stats.bakedVertices += vertices;
+    }
+  }
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+  glDisableClientState(GL_COLOR_ARRAY);
+  glDisableClientState(GL_NORMAL_ARRAY);
+
+  // Edges, when the faces were not outlined
+  if (lines) {
+    stateDisable(GL_POLYGON_OFFSET_FILL);
+    const std::vector<int> &full = drawLists[LOD_FULL];
+    glColor3fv(EDGE_COLOR);
+    for (size_t i = 0; i < full.size(); i++) {
+      const ChunkBuffers &chunk = buffers.chunks[full[i]];
+      if (chunk.edgeVertices == 0)
+        continue;
+      glBindBuffer(GL_ARRAY_BUFFER, chunk.edges);
+      glVertexPointer(3, GL_SHORT, sizeof(MeshPoint), 0);
+      glDrawArrays(GL_LINES, 0, chunk.edgeVertices);
+      stats.drawCalls++;
+    }
+    stateEnable(GL_LIGHTING);
+  } else {
+    stateUseProgram(0);
+  }
+  glDisableClientState(GL_VERTEX_ARRAY);
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+// Far chunks: their quads, adjacent chunks as one draw
+static void drawFlat(const PlatformBuffers &buffers, PlatformStats &stats) {
+  const std::vector<int> &list = drawLists[LOD_FLAT];
+  if (list.empty())
+    return;
+  stateUseProgram(buffers.flatProgram);
+  stateBindTexture(buffers.map);
+  glBindBuffer(GL_ARRAY_BUFFER, buffers.flat);
+  glEnableClientState(GL_VERTEX_ARRAY);
+  glVertexPointer(3, GL_SHORT, sizeof(MeshPoint), 0);
+  for (size_t i = 0; i < list.size();) {
+    size_t end = i + 1;
+    while (end < list.size() && list[end] == list[end - 1] + 1)
+      end++;
+    glDrawArrays(GL_QUADS, list[i] * 4, (end - i) * 4);
+    stats.drawCalls++;
+    stats.bakedVertices += (end - i) * 4;
+    i = end;
+  }
+  glDisableClientState(GL_VERTEX_ARRAY);
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+  stateBindTexture(0);
+  stateUseProgram(0);
+}
+
+// Core: the same faces from generic attributes, as indexed triangles
+static void drawBakedCore(const PlatformBuffers &buffers, const Mat4 &model,
+                          bool sorted, PlatformStats &stats) {
+  GLsizei stride = sizeof(MeshVertex);
+  stateUseProgram(buffers.faceProgram);
+  glUniformMatrix4fv(glGetUniformLocation(buffers.faceProgram, "model"), 1,
+                     GL_FALSE, model.m);
+  glEnableVertexAttribArray(ATTRIB_CORNER);
+  glEnableVertexAttribArray(ATTRIB_NORMAL);
+  glEnableVertexAttribArray(ATTRIB_COLOR);
+  for (int lod = LOD_TOPS; lod >= LOD_FULL; lod--) {
+    const std::vector<int> &list = drawLists[lod];
+    for (size_t i = 0; i < list.size(); i++) {
+      const ChunkBuffers &chunk = buffers.chunks[list[i]];
+      int vertices = lod == LOD_FULL ? chunk.faceVertices : chunk.topVertices;
+      if (vertices == 0)
+        continue;
+      glBindBuffer(GL_ARRAY_BUFFER, chunk.faces);
+      glVertexAttribPointer(ATTRIB_CORNER, 3, GL_SHORT, GL_FALSE, stride,
+                            (const GLvoid *)offsetof(MeshVertex, position));
+      glVertexAttribPointer(ATTRIB_NORMAL, 3, GL_BYTE, GL_TRUE, stride,
+                            (const GLvoid *)offsetof(MeshVertex, normal));
+      glVertexAttribPointer(ATTRIB_COLOR, 4, GL_UNSIGNED_BYTE, GL_TRUE, stride,
+                            (const GLvoid *)offsetof(MeshVertex, color));
+      if (sorted && lod == LOD_FULL) {
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, chunk.order);
+        glDrawElements(GL_TRIANGLES, vertices / 4 * 6, GL_UNSIGNED_SHORT, 0);
+      } else {
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, buffers.quadIndices);
+        glDrawElements(GL_TRIANGLES, vertices / 4 * 6, GL_UNSIGNED_INT, 0);
+      }
+      stats.drawCalls++;
+      stats.bakedVertices += vertices;
+    }
+  }
+  glDisableVertexAttribArray(ATTRIB_COLOR);
+  glDisableVertexAttribArray(ATTRIB_NORMAL);
+  glDisableVertexAttribArray(ATTRIB_CORNER);
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+  stateUseProgram(0);
+}
+
+static void drawFlatCore(const PlatformBuffers &buffers, const Mat4 &model,
+                         PlatformStats &stats) {
+  const std::vector<int> &list = drawLists[LOD_FLAT];
+  if (list.empty())
+    return;
+  stateUseProgram(buffers.flatProgram);
+  glUniformMatrix4fv(glGetUniformLocation(buffers.flatProgram, "model"), 1,
+                     GL_FALSE, model.m);
+  stateBindTexture(buffers.map);
+  glBindBuffer(GL_ARRAY_BUFFER, buffers.flat);
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, buffers.quadIndices);
+  glEnableVertexAttribArray(ATTRIB_CORNER);
+  glVertexAttribPointer(ATTRIB_CORNER, 3, GL_SHORT, GL_FALSE,
+                        sizeof(MeshPoint), 0);
+  for (size_t i = 0; i < list.size();) {
+    size_t end = i + 1;
+    while (end < list.size() && list[end] == list[end - 1] + 1)
+      end++;
+    glDrawElements(GL_TRIANGLES, (end - i) * 6, GL_UNSIGNED_INT,
+                   (const GLvoid *)(list[i] * 6 * sizeof(GLuint)));
+    stats.drawCalls++;
+    stats.bakedVertices += (end - i) * 4;
+    i = end;
+  }
+  glDisableVertexAttribArray(ATTRIB_CORNER);
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+  stateBindTexture(0);
+  stateUseProgram(0);
+}
+
+void platformDraw(PlatformBuffers &buffers, const PlatformMesh &mesh,
+                  int options, PlatformStats *stats) {
+  PlatformStats counted = {};
+  if (buffers.instanced ? buffers.program != 0
+                        : buffers.chunks.size() == mesh.chunks.size()) {
+    GLfloat projection[16], modelview[16];
+    glGetFloatv(GL_PROJECTION_MATRIX, projection);
+    glGetFloatv(GL_MODELVIEW_MATRIX, modelview);
+    GLint viewport[4];
+    glGetIntegerv(GL_VIEWPORT, viewport);
+    listChunks(buffers, mesh, projection, modelview, viewport[3], options,
+               counted);
+    bool sorted = options & PLATFORM_SORT;
+    if (sorted && !buffers.instanced)
+      sortChunks(buffers, mesh, modelview, counted);
+    drawFlat(buffers, counted); // Furthest, so first
+    if (buffers.instanced)
+      drawInstanced(buffers, mesh, counted);
+    else
+      drawBaked(buffers, sorted, counted);
+  }
+  if (stats)
+    *stats = counted;
+}
+
+void platformDrawView(PlatformBuffers &buffers, const PlatformMesh &mesh,
+                      const PlatformView &view, int options,
+                      PlatformStats *stats) {
+  PlatformStats counted = {};
+  if (buffers.faceProgram && buffers.chunks.size() == mesh.chunks.size()) {
+    Mat4 modelview = mat4Multiply(view.view, view.model);
+    listChunks(buffers, mesh, view.projection.m, modelview.m,
+               view.viewportHeight, options, counted);
+    bool sorted = options & PLATFORM_SORT;
+    if (sorted)
+      sortChunks(buffers, mesh, modelview.m, counted);
+    drawFlatCore(buffers, view.model, counted);
+    drawBakedCore(buffers, view.model, sorted, counted);
+  }
+  if (stats)
+    *stats = counted;
+}
+
+size_t platformBufferBytes(const PlatformBuffers &buffers) {
+  size_t bytes = buffers.lods.size() * 4 * sizeof(MeshPoint) + // Flat quads
+                 buffers.mapBytes;
+  if (buffers.instanced)
+    return bytes + (size_t)buffers.slots * (sizeof(TileInstance) + 1);
+  bytes += (size_t)buffers.quadIndexCount * 6 * sizeof(GLuint);
+  for (size_t c = 0; c < buffers.chunks.size(); c++) {
+    const ChunkBuffers &chunk = buffers.chunks[c];
+    bytes += (size_t)chunk.faceVertices * sizeof(MeshVertex) +
+             (size_t)chunk.edgeVertices * sizeof(MeshPoint);
+    if (chunk.order)
+      bytes += (size_t)chunk.faceVertices / 4 * (buffers.core ? 6 : 4) *
+               sizeof(GLushort);
+  }
+  return bytes;
+}
+
+void platformRelease(PlatformBuffers &buffers) {
+  releaseChunks(buffers);
+  GLuint names[] = {buffers.cube, buffers.instances, buffers.visible,
+                    buffers.flat, buffers.quadIndices};
+  for (int i = 0; i < 5; i++) {
+    if (names[i])
+      glDeleteBuffers(1, &names[i]);
+  }
+  if (buffers.map)
+    glDeleteTextures(1, &buffers.map);
+  if (buffers.program)
+    glDeleteProgram(buffers.program);
+  if (buffers.flatProgram)
+    glDeleteProgram(buffers.flatProgram);
+  if (buffers.faceProgram)
+    glDeleteProgram(buffers.faceProgram);
+  PlatformBuffers none = {};
+  none.core = buffers.core;
+  buffers = none;
+}
@@ -0,0 +1,227 @@
+#define GL_SILENCE_DEPRECATION // Ignore deprecation errors
+#include "headers/platformbench.h"
+#include "headers/glstate.h"
+#include <GLUT/glut.h>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+typedef std::chrono::steady_clock Clock;
+
+static double msSince(Clock::time_point start) {
+  return std::chrono::duration<double, std::milli>(Clock::now() - start)
+      .count();
+}
+
+// Build and upload one path of the bench; false if it cannot run
+static bool benchBuild(PlatformMesh &mesh, PlatformBuffers &buffers,
+                       const SimState &level, bool instanced,
+                       const PlatformBenchSetup &setup) {
+  buffers.core = setup.core;
+  if (instanced && (setup.core || !platformInstancingSupported())) {
+    return false;
+  }
+  if (instanced) {
+    meshBuildInstances(mesh, level, setup.meshLight);
+  } else {
+    meshBuild(mesh, level, setup.meshLight);
+  }
+  platformUpload(buffers, mesh);
+  return true;
+}
+
+// One frame of the platform alone, seen from the given angles (degrees) and
+// distance as the game's camera would see it, in ms
+static double benchFrame(PlatformBuffers &buffers, const PlatformMesh &mesh,
+                         int options, PlatformStats &stats,
+                         const PlatformBenchSetup &setup, float angleY,
+                         float distance) {
+  Clock::time_point start = Clock::now();
+  float radX = setup.cameraAngleX * 3.14159f / 180.0f;
+  float radY = angleY * 3.14159f / 180.0f;
+  const float eye[3] = {distance * sinf(radY) * cosf(radX),
+                        distance * sinf(radX),
+                        distance * cosf(radY) * cosf(radX)};
+  const float centre[3] = {0.0f, 0.0f, 0.0f}, up[3] = {0.0f, 1.0f, 0.0f};
+  PlatformView view = {
+      mat4Perspective(45.0f, (float)setup.width / setup.height, 0.1f, 100.0f),
+      mat4LookAt(eye, centre, up),
+      mat4Translate(-mesh.cols / 2.0f, 0.0f, -mesh.rows / 2.0f),
+      setup.height};
+
+  glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+  if (setup.core) {
+    renderBeginFrame(view.projection, view.view, setup.light);
+    platformDrawView(buffers, mesh, view, options, &stats);
+  } else {
+    stateMatrixMode(GL_PROJECTION);
+    glLoadMatrixf(view.projection.m);
+    stateMatrixMode(GL_MODELVIEW);
+    glLoadMatrixf(view.view.m);
+    glLightfv(GL_LIGHT0, GL_POSITION, setup.light.direction); // World space
+    glMultMatrixf(view.model.m);
+    platformDraw(buffers, mesh, options, &stats);
+  }
+  glFinish();
+  return msSince(start);
+}
+
+// Build, draw and toggle times of both paths on levels of 10^2 to 10^7
+// tiles (every seventh cell empty, with one switch and bridge), seen from
+// the starting camera
+static void benchSizes(const PlatformBenchSetup &setup) {
+  const int SIDES[] = {10, 32, 100, 316, 1000, 3162};
+  const double MAX_BAKED_MB = 1024.0;
+  printf("Platform bench (%dx%d window)\n", setup.width, setup.height);
+  printf("  %9s  %-9s %15s %10s %7s %10s %9s\n", "tiles", "path",
+         "build+upload ms", "frame ms", "calls", "toggle ms", "MB");
+  for (int side : SIDES) {
+    std::vector<std::vector<int>> layout(side, std::vector<int>(side, 1));
+    for (int i = 0; i < side; i++) {
+      for (int j = 0; j < side; j++) {
+        if ((i * 31 + j * 17) % 7 == 0) {
+          layout[i][j] = 0;
+        }
+      }
+    }
+    layout[0][0] = 9;
+    layout[1][1] = 5;
+    for (int j = 2; j < std::min(side, 6); j++) {
+      layout[1][j] = 4;
+    }
+    SimState level;
+    simLoadLevel(level, layout, std::vector<SwitchDef>());
+
+    for (int instanced = 0; instanced < 2; instanced++) {
+      const char *path = instanced ? "instanced" : "baked";
+      // At most, before merging
+      double bakedMB = (double)level.tileCount *
+                       (TILE_FACE_VERTICES * sizeof(MeshVertex) +
+                        TILE_EDGE_VERTICES * sizeof(MeshPoint)) /
+                       1e6;
+      PlatformMesh mesh;
+      PlatformBuffers buffers = {};
+      Clock::time_point start = Clock::now();
+      if ((!instanced && bakedMB > MAX_BAKED_MB) ||
+          !benchBuild(mesh, buffers, level, instanced, setup)) {
+        printf("  %9d  %-9s skipped\n", level.tileCount, path);
+        continue;
+      }
+      glFinish();
+      double buildMs = msSince(start);
+
+      int frames = 0;
+      double frameMs = 0.0;
+      PlatformStats stats;
+      while (frames < 3 || (frameMs < 500.0 && frames < 200)) {
+        frameMs += benchFrame(buffers, mesh,
+                              PLATFORM_CULL | PLATFORM_LOD | PLATFORM_SORT,
+                              stats, setup, setup.cameraAngleY,
+                              setup.cameraDistance);
+        frames++;
+      }
+
+      Clock::time_point toggleStart = Clock::now();
+      ToggleGroup &group = level.toggleGroups[0];
+      simSetGroupVisible(level, group, !group.visible);
+      std::vector<int> changed;
+      meshSyncToggles(mesh, level, changed);
+      platformUpdate(buffers, mesh, changed);
+      glFinish();
+      double toggleMs = msSince(toggleStart);
+      simSetGroupVisible(level, group, !group.visible);
+
+      printf("  %9d  %-9s %15.2f %10.2f %7d %10.3f %9.1f\n", level.tileCount,
+             path, buildMs, frameMs / frames, stats.drawCalls, toggleMs,
+             platformBufferBytes(buffers) / 1e6);
+      platformRelease(buffers);
+    }
+  }
+}
+
+// Draw calls, chunks culled and drawn at each level of detail, and frame
+// times with the camera orbiting levels of 512^2 and 4096^2 tiles, close
+// and zoomed out
+static void benchOrbit(const PlatformBenchSetup &setup) {
+  // Square islands 16 tiles wide, with a fifth of the blocks left out
+  const int ORBIT_SIDES[] = {512, 4096};
+  const int ORBIT_FRAMES = 72;
+  const float ORBIT_DISTANCES[] = {15.0f, 50.0f};
+  const struct {
+    const char *name;
+    int options;
+  } MODES[] = {{"all", 0},
+               {"cull", PLATFORM_CULL},
+               {"cull+lod", PLATFORM_CULL | PLATFORM_LOD},
+               {"sorted", PLATFORM_CULL | PLATFORM_LOD | PLATFORM_SORT}};
+  printf("Orbit, %d frames a full turn\n", ORBIT_FRAMES);
+  printf("  %9s  %-9s %5s %-8s %10s %10s %7s %7s %7s %7s %7s %7s %7s\n",
+         "tiles", "path", "zoom", "mode", "build ms", "frame ms", "calls",
+         "culled", "full", "tops", "flat", "sorted", "MB");
+  for (int side : ORBIT_SIDES) {
+    std::vector<std::vector<int>> layout(side, std::vector<int>(side, 1));
+    for (int i = 0; i < side; i++) {
+      for (int j = 0; j < side; j++) {
+        if (((i / 16) * 7 + (j / 16) * 3) % 5 == 0) {
+          layout[i][j] = 0;
+        }
+      }
+    }
+    layout[0][0] = 9;
+    SimState level;
+    simLoadLevel(level, layout, std::vector<SwitchDef>());
+    for (int instanced = 0; instanced < 2; instanced++) {
+      const char *path = instanced ? "instanced" : "baked";
+      PlatformMesh mesh;
+      PlatformBuffers buffers = {};
+      Clock::time_point start = Clock::now();
+      if (!benchBuild(mesh, buffers, level, instanced, setup)) {
+        printf("  %9d  %-9s skipped\n", level.tileCount, path);
+        continue;
+      }
+      glFinish();
+      double buildMs = msSince(start);
+      for (float zoom : ORBIT_DISTANCES) {
+        for (const auto &mode : MODES) {
+          // Drawing everything once, close up, is enough to show the cost
+          if (mode.options == 0 && zoom != ORBIT_DISTANCES[0]) {
+            continue;
+          }
+          int frames = mode.options ? ORBIT_FRAMES : 1;
+          double frameMs = 0.0;
+          PlatformStats total = {};
+          for (int f = 0; f < frames; f++) {
+            float angleY = setup.cameraAngleY + 360.0f * f / ORBIT_FRAMES;
+            PlatformStats stats;
+            frameMs += benchFrame(buffers, mesh, mode.options, stats, setup,
+                                  angleY, zoom);
+            total.drawCalls += stats.drawCalls;
+            total.chunksCulled += stats.chunksCulled;
+            total.chunksSorted += stats.chunksSorted;
+            for (int l = 0; l < LOD_LEVELS; l++) {
+              total.chunksAt[l] += stats.chunksAt[l];
+            }
+          }
+          printf("  %9d  %-9s %5.0f %-8s %10.0f %10.2f %7.1f %7.0f %7.1f "
+                 "%7.1f %7.1f %7.1f %7.1f\n",
+                 level.tileCount, path, zoom, mode.name, buildMs,
+                 frameMs / frames, (double)total.drawCalls / frames,
+                 (double)total.chunksCulled / frames,
+                 (double)total.chunksAt[LOD_FULL] / frames,
+                 (double)total.chunksAt[LOD_TOPS] / frames,
+                 (double)total.chunksAt[LOD_FLAT] / frames,
+                 (double)total.chunksSorted / frames,
+                 platformBufferBytes(buffers) / 1e6);
+        }
+      }
+      platformRelease(buffers);
+    }
+  }
+}
+
+void platformBench(const PlatformBenchSetup &setup) {
+  benchSizes(setup);
+  benchOrbit(setup);
+}
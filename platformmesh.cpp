@@ -0,0 +1,500 @@
+#include "headers/platformmesh.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+// Tile colours by type, as the diffuse material. Fragile tiles (3) draw
+// like regular ones.
+static const unsigned char TILE_COLORS[MESH_TILE_TYPES][4] = {
+    {0, 0, 0, 0},
+    {51, 51, 64, 179},   // 1 regular - dark gray
+    {0, 204, 204, 153},  // 2 target - cyan
+    {51, 51, 64, 179},   // 3 fragile
+    {255, 153, 51, 179}, // 4 bridge - orange
+    {179, 77, 230, 179}, // 5 toggle action - purple
+};
+
+// Unit cube corners (0 or 1 on each axis) of each face but the bottom,
+// wound as drawCube() winds them, and the face normals
+enum { FACE_FRONT, FACE_BACK, FACE_TOP, FACE_RIGHT, FACE_LEFT };
+static const unsigned char FACE_CORNERS[TILE_FACE_VERTICES][3] = {
+    {0, 0, 1}, {1, 0, 1}, {1, 1, 1}, {0, 1, 1}, // Front (+z)
+    {0, 0, 0}, {0, 1, 0}, {1, 1, 0}, {1, 0, 0}, // Back (-z)
+    {0, 1, 0}, {0, 1, 1}, {1, 1, 1}, {1, 1, 0}, // Top
+    {1, 0, 0}, {1, 1, 0}, {1, 1, 1}, {1, 0, 1}, // Right (+x)
+    {0, 0, 0}, {0, 0, 1}, {0, 1, 1}, {0, 1, 0}, // Left (-x)
+};
+static const signed char FACE_NORMALS[5][3] = {
+    {0, 0, 127}, {0, 0, -127}, {0, 127, 0}, {127, 0, 0}, {-127, 0, 0},
+};
+
+// The 12 cube edges, as corner pairs
+static const unsigned char EDGE_CORNERS[TILE_EDGE_VERTICES][3] = {
+    {0, 0, 0}, {1, 0, 0}, {0, 1, 0}, {1, 1, 0}, // Along x
+    {0, 0, 1}, {1, 0, 1}, {0, 1, 1}, {1, 1, 1},
+    {0, 0, 0}, {0, 1, 0}, {1, 0, 0}, {1, 1, 0}, // Along y
+    {0, 0, 1}, {0, 1, 1}, {1, 0, 1}, {1, 1, 1},
+    {0, 0, 0}, {0, 0, 1}, {1, 0, 0}, {1, 0, 1}, // Along z
+    {0, 1, 0}, {0, 1, 1}, {1, 1, 0}, {1, 1, 1},
+};
+
+const unsigned char *meshTileColor(int tile) {
+  return TILE_COLORS[tile >= 0 && tile < MESH_TILE_TYPES ? tile : 1];
+}
+
+static MeshPoint corner(int row, int col, const unsigned char *c) {
+  MeshPoint p = {(short)(col + c[0]), (short)(c[1] - 1), (short)(row + c[2]),
+                 0};
+  return p;
+}
+
+// Ambient light left at a side corner with a tile diagonally in front of it
+static const float AO_OCCLUDED = 0.5f;
+
+// A face of the tile type lit as the fixed pipeline would, its ambient
+// part scaled by 'ambient'
+static void lightFace(const MeshLight &light, int face, int tile,
+                      float ambient, unsigned char lit[4]) {
+  const unsigned char *color = meshTileColor(tile);
+  float cosine = 0.0f;
+  for (int i = 0; i < 3; i++)
+    cosine += FACE_NORMALS[face][i] / 127.0f * light.direction[i];
+  cosine = std::max(cosine, 0.0f);
+  for (int i = 0; i < 3; i++) {
+    float value = light.ambient[i] * ambient +
+                  cosine * light.diffuse[i] * color[i] / 255.0f;
+    lit[i] = (unsigned char)(std::min(value, 1.0f) * 255.0f + 0.5f);
+  }
+  lit[3] = color[3];
+}
+
+// One face of the box covering columns col0 .. col1 - 1 and rows
+// row0 .. row1 - 1, coloured 'start' at its corners nearest the origin
+// along the face's length (x, or z for sides facing along x) and 'end' at
+// the others
+static void addFace(std::vector<MeshVertex> &faces, int face, int row0,
+                    int col0, int row1, int col1, const unsigned char *start,
+                    const unsigned char *end) {
+  bool alongX = face != FACE_LEFT && face != FACE_RIGHT;
+  for (int v = 0; v < 4; v++) {
+    const unsigned char *c = FACE_CORNERS[face * 4 + v];
+    MeshVertex vertex;
+    vertex.position.x = c[0] ? col1 : col0;
+    vertex.position.y = c[1] - 1;
+    vertex.position.z = c[2] ? row1 : row0;
+    vertex.position.w = 0;
+    memcpy(vertex.normal, FACE_NORMALS[face], 3);
+    vertex.normal[3] = 0;
+    memcpy(vertex.color, (alongX ? c[0] : c[2]) ? end : start, 4);
+    faces.push_back(vertex);
+  }
+}
+
+void meshWriteCube(MeshVertex *faces, MeshPoint *edges, int row, int col,
+                   int tile) {
+  if (tile == 0) {
+    MeshVertex none = {};
+    MeshPoint point = {};
+    for (int v = 0; v < TILE_FACE_VERTICES; v++)
+      faces[v] = none;
+    for (int v = 0; v < TILE_EDGE_VERTICES; v++)
+      edges[v] = point;
+    return;
+  }
+  const unsigned char *color = meshTileColor(tile);
+  for (int v = 0; v < TILE_FACE_VERTICES; v++) {
+    MeshVertex &vertex = faces[v];
+    vertex.position = corner(row, col, FACE_CORNERS[v]);
+    for (int i = 0; i < 3; i++)
+      vertex.normal[i] = FACE_NORMALS[v / 4][i];
+    vertex.normal[3] = 0;
+    for (int i = 0; i < 4; i++)
+      vertex.color[i] = color[i];
+  }
+  for (int v = 0; v < TILE_EDGE_VERTICES; v++)
+    edges[v] = corner(row, col, EDGE_CORNERS[v]);
+}
+
+// Type a shown tile draws as, 0 for none. Types that draw alike count as
+// one, so they merge.
+static int shownType(const SimState &sim, int row, int col) {
+  if (row < 0 || col < 0 || row >= sim.rows || col >= sim.cols)
+    return 0;
+  int tile = sim.layout[row][col];
+  return tile == 3 || tile >= MESH_TILE_TYPES ? 1 : tile;
+}
+
+static void writeMap(PlatformMesh &mesh, const SimState &sim, int row,
+                     int col) {
+  unsigned char *texel = &mesh.map[((size_t)row * sim.cols + col) * 4];
+  int type = shownType(sim, row, col);
+  if (type)
+    lightFace(mesh.light, FACE_TOP, type, 1.0f, texel);
+  else
+    memset(texel, 0, 4);
+}
+
+// Count the chunk's tiles in the authored level and take their bounds
+static void chunkBounds(MeshChunk &chunk, const SimState &sim) {
+  chunk.tiles = 0;
+  chunk.minRow = chunk.minCol = 0x7FFFFFFF;
+  chunk.maxRow = chunk.maxCol = 0;
+  for (int i = chunk.row0; i < chunk.row0 + chunk.rows; i++) {
+    for (int j = chunk.col0; j < chunk.col0 + chunk.cols; j++) {
+      if (sim.source[i][j] == 0)
+        continue;
+      chunk.tiles++;
+      chunk.minRow = std::min(chunk.minRow, i);
+      chunk.minCol = std::min(chunk.minCol, j);
+      chunk.maxRow = std::max(chunk.maxRow, i + 1);
+      chunk.maxCol = std::max(chunk.maxCol, j + 1);
+    }
+  }
+}
+
+// Chunks covering the level, with the bounds of their tiles, the toggle
+// state and the light (its direction made unit length). Drops the previous
+// mesh.
+static void initChunks(PlatformMesh &mesh, const SimState &sim,
+                       const MeshLight &light, bool instanced) {
+  mesh.instanced = instanced;
+  mesh.light = light;
+  float length = sqrtf(light.direction[0] * light.direction[0] +
+                       light.direction[1] * light.direction[1] +
+                       light.direction[2] * light.direction[2]);
+  for (int i = 0; i < 3; i++)
+    mesh.light.direction[i] =
+        length > 0.0f ? light.direction[i] / length : 0.0f;
+  mesh.rows = sim.rows;
+  mesh.cols = sim.cols;
+  mesh.chunkRows = (sim.rows + CHUNK_TILES - 1) / CHUNK_TILES;
+  mesh.chunkCols = (sim.cols + CHUNK_TILES - 1) / CHUNK_TILES;
+  std::vector<MeshChunk>().swap(mesh.chunks);
+  mesh.chunks.resize((size_t)mesh.chunkRows * mesh.chunkCols);
+  mesh.dirty.assign(mesh.chunks.size(), false);
+  for (int cr = 0; cr < mesh.chunkRows; cr++) {
+    for (int cc = 0; cc < mesh.chunkCols; cc++) {
+      MeshChunk &chunk = mesh.chunks[cr * mesh.chunkCols + cc];
+      chunk.row0 = cr * CHUNK_TILES;
+      chunk.col0 = cc * CHUNK_TILES;
+      chunk.rows = std::min(CHUNK_TILES, sim.rows - chunk.row0);
+      chunk.cols = std::min(CHUNK_TILES, sim.cols - chunk.col0);
+      chunk.topVertices = 0;
+      chunk.firstSlot = 0;
+      chunkBounds(chunk, sim);
+    }
+  }
+  mesh.groupVisible.resize(sim.toggleGroups.size());
+  for (size_t g = 0; g < sim.toggleGroups.size(); g++)
+    mesh.groupVisible[g] = sim.toggleGroups[g].visible;
+  mesh.map.assign((size_t)sim.rows * sim.cols * 4, 0);
+  for (int i = 0; i < sim.rows; i++)
+    for (int j = 0; j < sim.cols; j++)
+      writeMap(mesh, sim, i, j);
+  mesh.slotCount = 0;
+  std::vector<int>().swap(mesh.slots);
+  std::vector<TileInstance>().swap(mesh.instances);
+  std::vector<unsigned char>().swap(mesh.visible);
+}
+
+static void addEdge(std::vector<MeshPoint> &edges, int x0, int y0, int z0,
+                    int x1, int y1, int z1) {
+  MeshPoint a = {(short)x0, (short)y0, (short)z0, 0};
+  MeshPoint b = {(short)x1, (short)y1, (short)z1, 0};
+  edges.push_back(a);
+  edges.push_back(b);
+}
+
+// Edges a chunk draws. It owns the grid lines through its first row and
+// column up to its last, and the closing lines at the level's far edges.
+// Top lines are drawn next to any shown tile; bottom lines and the
+// vertical ones only where they bound a side face.
+static void buildEdges(MeshChunk &chunk, const PlatformMesh &mesh,
+                       const SimState &sim) {
+  int rowEnd = chunk.row0 + chunk.rows + (chunk.row0 + chunk.rows == mesh.rows);
+  int colEnd = chunk.col0 + chunk.cols + (chunk.col0 + chunk.cols == mesh.cols);
+  for (int alongX = 0; alongX < 2; alongX++) {
+    int lineEnd = alongX ? rowEnd : colEnd;
+    int k0 = alongX ? chunk.col0 : chunk.row0;
+    int k1 = k0 + (alongX ? chunk.cols : chunk.rows);
+    for (int line = alongX ? chunk.row0 : chunk.col0; line < lineEnd;
+         line++) {
+      for (int bottom = 0; bottom < 2; bottom++) {
+        int runStart = -1;
+        for (int k = k0; k <= k1; k++) {
+          bool present = false;
+          if (k < k1) {
+            bool a = alongX ? shownType(sim, line - 1, k) != 0
+                            : shownType(sim, k, line - 1) != 0;
+            bool b = alongX ? shownType(sim, line, k) != 0
+                            : shownType(sim, k, line) != 0;
+            present = bottom ? a != b : a || b;
+          }
+          if (present && runStart < 0)
+            runStart = k;
+          if (present || runStart < 0)
+            continue;
+          if (alongX)
+            addEdge(chunk.edges, runStart, -bottom, line, k, -bottom, line);
+          else
+            addEdge(chunk.edges, line, -bottom, runStart, line, -bottom, k);
+          runStart = -1;
+        }
+      }
+    }
+  }
+  for (int i = chunk.row0; i < rowEnd; i++) {
+    for (int j = chunk.col0; j < colEnd; j++) {
+      int around = (shownType(sim, i - 1, j - 1) != 0) +
+                   (shownType(sim, i - 1, j) != 0) +
+                   (shownType(sim, i, j - 1) != 0) +
+                   (shownType(sim, i, j) != 0);
+      if (around > 0 && around < 4)
+        addEdge(chunk.edges, j, -1, i, j, 0, i);
+    }
+  }
+}
+
+// A strip of 'length' sides from the tile at (row, col) along its row or
+// column, with the corners at either end darkened or not. Darkened end
+// tiles are split off, so the shading does not stretch along the strip.
+static void addSide(std::vector<MeshVertex> &faces, const MeshLight &light,
+                    int face, bool alongRow, int row, int col, int length,
+                    int tile, bool startDark, bool endDark) {
+  unsigned char open[4], dark[4];
+  lightFace(light, face, tile, 1.0f, open);
+  lightFace(light, face, tile, AO_OCCLUDED, dark);
+  int cuts[4] = {0, 0, length, length};
+  if (startDark && length > 1)
+    cuts[1] = 1;
+  if (endDark && length - cuts[1] > 1)
+    cuts[2] = length - 1;
+  for (int p = 0; p < 3; p++) {
+    if (cuts[p] == cuts[p + 1])
+      continue;
+    const unsigned char *start = cuts[p] == 0 && startDark ? dark : open;
+    const unsigned char *end = cuts[p + 1] == length && endDark ? dark : open;
+    if (alongRow)
+      addFace(faces, face, row, col + cuts[p], row + 1, col + cuts[p + 1],
+              start, end);
+    else
+      addFace(faces, face, row + cuts[p], col, row + cuts[p + 1], col + 1,
+              start, end);
+  }
+}
+
+// Faces and edges of one chunk from the live layout. Tops merge greedily
+// into rectangles of one type; a side is kept only where no shown tile is
+// next to it, and runs of kept sides along a row or column merge into
+// strips (see addSide()).
+static void buildChunk(MeshChunk &chunk, const PlatformMesh &mesh,
+                       const SimState &sim) {
+  chunk.faces.clear();
+  chunk.edges.clear();
+  int rows = chunk.rows, cols = chunk.cols;
+  int row0 = chunk.row0, col0 = chunk.col0;
+  bool merged[CHUNK_TILES][CHUNK_TILES] = {};
+  for (int i = 0; i < rows; i++) {
+    for (int j = 0; j < cols; j++) {
+      int type = shownType(sim, row0 + i, col0 + j);
+      if (type == 0 || merged[i][j])
+        continue;
+      int width = 1;
+      while (j + width < cols && !merged[i][j + width] &&
+             shownType(sim, row0 + i, col0 + j + width) == type)
+        width++;
+      int height = 1;
+      for (bool grow = true; grow && i + height < rows;) {
+        for (int k = 0; k < width && grow; k++)
+          grow = !merged[i + height][j + k] &&
+                 shownType(sim, row0 + i + height, col0 + j + k) == type;
+        height += grow;
+      }
+      for (int a = 0; a < height; a++)
+        for (int k = 0; k < width; k++)
+          merged[i + a][j + k] = true;
+      unsigned char lit[4];
+      lightFace(mesh.light, FACE_TOP, type, 1.0f, lit);
+      addFace(chunk.faces, FACE_TOP, row0 + i, col0 + j, row0 + i + height,
+              col0 + j + width, lit, lit);
+    }
+  }
+  chunk.topVertices = chunk.faces.size();
+
+  // Sides facing -z and +z run along rows, -x and +x along columns
+  static const struct {
+    int face, drow, dcol;
+  } SIDES[4] = {{FACE_BACK, -1, 0}, {FACE_FRONT, 1, 0},
+                {FACE_LEFT, 0, -1}, {FACE_RIGHT, 0, 1}};
+  for (int s = 0; s < 4; s++) {
+    bool alongRow = SIDES[s].drow != 0;
+    int lines = alongRow ? rows : cols;
+    int length = alongRow ? cols : rows;
+    for (int line = 0; line < lines; line++) {
+      int runType = 0, runStart = 0;
+      for (int k = 0; k <= length; k++) {
+        int type = 0;
+        if (k < length) {
+          int row = row0 + (alongRow ? line : k);
+          int col = col0 + (alongRow ? k : line);
+          type = shownType(sim, row, col);
+          if (type && shownType(sim, row + SIDES[s].drow, col + SIDES[s].dcol))
+            type = 0; // Hidden by its neighbour
+        }
+        if (type == runType)
+          continue;
+        if (runType) {
+          // Corners are shaded by the tiles diagonally in front of the
+          // run's first and last tiles
+          int row = row0 + (alongRow ? line : runStart);
+          int col = col0 + (alongRow ? runStart : line);
+          int count = k - runStart;
+          int frontRow = row + SIDES[s].drow, frontCol = col + SIDES[s].dcol;
+          bool startDark = alongRow ? shownType(sim, frontRow, frontCol - 1)
+                                    : shownType(sim, frontRow - 1, frontCol);
+          bool endDark = alongRow ? shownType(sim, frontRow, frontCol + count)
+                                  : shownType(sim, frontRow + count, frontCol);
+          addSide(chunk.faces, mesh.light, SIDES[s].face, alongRow, row, col,
+                  count, runType, startDark, endDark);
+        }
+        runType = type;
+        runStart = k;
+      }
+    }
+  }
+  buildEdges(chunk, mesh, sim);
+}
+
+void meshBuild(PlatformMesh &mesh, const SimState &sim,
+               const MeshLight &light) {
+  initChunks(mesh, sim, light, false);
+  for (size_t c = 0; c < mesh.chunks.size(); c++)
+    buildChunk(mesh.chunks[c], mesh, sim);
+}
+
+void meshBuildInstances(PlatformMesh &mesh, const SimState &sim,
+                        const MeshLight &light) {
+  initChunks(mesh, sim, light, true);
+  mesh.slots.assign((size_t)sim.rows * sim.cols, -1);
+  for (size_t c = 0; c < mesh.chunks.size(); c++) {
+    MeshChunk &chunk = mesh.chunks[c];
+    chunk.firstSlot = mesh.slotCount;
+    for (int i = chunk.row0; i < chunk.row0 + chunk.rows; i++) {
+      for (int j = chunk.col0; j < chunk.col0 + chunk.cols; j++) {
+        if (sim.source[i][j] != 0)
+          mesh.slots[i * sim.cols + j] = mesh.slotCount++;
+      }
+    }
+  }
+  mesh.instances.resize(mesh.slotCount);
+  mesh.visible.resize(mesh.slotCount);
+  for (int i = 0; i < sim.rows; i++) {
+    for (int j = 0; j < sim.cols; j++) {
+      int slot = mesh.slots[i * sim.cols + j];
+      if (slot < 0)
+        continue;
+      TileInstance &instance = mesh.instances[slot];
+      instance.col = j;
+      instance.row = i;
+      instance.type = sim.source[i][j] == 9 ? 1 : sim.source[i][j];
+      mesh.visible[slot] = sim.layout[i][j] != 0;
+    }
+  }
+}
+
+// Mark the chunk owning the cell or grid corner at (row, col), if any
+static void markChunk(PlatformMesh &mesh, int row, int col) {
+  if (row < 0 || col < 0)
+    return;
+  row = std::min(row, mesh.rows - 1);
+  col = std::min(col, mesh.cols - 1);
+  mesh.dirty[(row / CHUNK_TILES) * mesh.chunkCols + col / CHUNK_TILES] = true;
+}
+
+// A tile's neighbours' sides, the edges at its far corner and the corner
+// shading of the tiles diagonal to it change with it
+static void markAround(PlatformMesh &mesh, int row, int col) {
+  for (int dr = -1; dr <= 1; dr++)
+    for (int dc = -1; dc <= 1; dc++)
+      markChunk(mesh, row + dr, col + dc);
+}
+
+static void rebuildDirty(PlatformMesh &mesh, const SimState &sim,
+                         std::vector<int> &changed) {
+  for (size_t c = 0; c < mesh.chunks.size(); c++) {
+    if (!mesh.dirty[c])
+      continue;
+    mesh.dirty[c] = false;
+    buildChunk(mesh.chunks[c], mesh, sim);
+    changed.push_back(c);
+  }
+}
+
+void meshSyncToggles(PlatformMesh &mesh, const SimState &sim,
+                     std::vector<int> &changed) {
+  bool any = false;
+  for (size_t g = 0; g < sim.toggleGroups.size(); g++) {
+    const ToggleGroup &group = sim.toggleGroups[g];
+    if (group.visible == mesh.groupVisible[g])
+      continue;
+    mesh.groupVisible[g] = group.visible;
+    for (size_t t = 0; t < group.tiles.size(); t++) {
+      int row = group.tiles[t].first;
+      int col = group.tiles[t].second;
+      writeMap(mesh, sim, row, col);
+      if (mesh.instanced) {
+        // A cell empty in the authored level has no instance to show
+        int slot = mesh.slots[row * mesh.cols + col];
+        if (slot < 0)
+          continue;
+        mesh.visible[slot] = sim.layout[row][col] != 0;
+        changed.push_back(slot);
+        continue;
+      }
+      markAround(mesh, row, col);
+      any = true;
+    }
+  }
+  if (any)
+    rebuildDirty(mesh, sim, changed);
+}
+
+bool meshSyncCells(PlatformMesh &mesh, const SimState &sim,
+                   const std::vector<std::pair<int, int> > &cells,
+                   std::vector<int> &changed) {
+  if (mesh.rows != sim.rows || mesh.cols != sim.cols)
+    return false;
+  // An instanced tile cannot gain or lose its slot in place
+  for (size_t c = 0; c < cells.size() && mesh.instanced; c++) {
+    int row = cells[c].first, col = cells[c].second;
+    bool hasSlot = mesh.slots[row * mesh.cols + col] >= 0;
+    if (hasSlot != (sim.source[row][col] != 0))
+      return false;
+  }
+  mesh.groupVisible.resize(sim.toggleGroups.size());
+  for (size_t g = 0; g < sim.toggleGroups.size(); g++)
+    mesh.groupVisible[g] = sim.toggleGroups[g].visible;
+  for (size_t c = 0; c < cells.size(); c++) {
+    int row = cells[c].first, col = cells[c].second;
+    writeMap(mesh, sim, row, col);
+    if (mesh.instanced) {
+      int slot = mesh.slots[row * mesh.cols + col];
+      if (slot < 0)
+        continue;
+      int tile = sim.source[row][col];
+      mesh.instances[slot].type = tile == 9 ? 1 : tile;
+      mesh.visible[slot] = sim.layout[row][col] != 0;
+      changed.push_back(slot);
+      continue;
+    }
+    markAround(mesh, row, col);
+  }
+  if (mesh.instanced)
+    return true;
+  for (size_t c = 0; c < mesh.chunks.size(); c++) {
+    if (mesh.dirty[c])
+      chunkBounds(mesh.chunks[c], sim);
+  }
+  rebuildDirty(mesh, sim, changed);
+  return true;
+}
@@ -0,0 +1,111 @@
+#include "headers/reload.h"
+#include <cstdio>
+#include <ctime>
+#include <string>
+#include <sys/stat.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <sys/inotify.h>
+#endif
+
+static std::string watchedPath;
+static std::string watchedName; // File name inside the watched directory
+static int watchFd = -1;
+static int watchDescriptor = -1;
+static struct timespec lastWriteTime = {0, 0};
+
+// Modification time of the watched file (zero if it cannot be read)
+static struct timespec fileWriteTime() {
+  struct stat st;
+  struct timespec ts = {0, 0};
+  if (stat(watchedPath.c_str(), &st) == 0) {
+#ifdef __APPLE__
+    ts = st.st_mtimespec;
+#else
+    ts = st.st_mtim;
+#endif
+  }
+  return ts;
+}
+
+bool startLevelWatch(const char *path) {
+  stopLevelWatch();
+  watchedPath = path;
+  lastWriteTime = fileWriteTime();
+
+  size_t slash = watchedPath.find_last_of('/');
+  std::string dir =
+      slash == std::string::npos ? "." : watchedPath.substr(0, slash + 1);
+  watchedName =
+      slash == std::string::npos ? watchedPath : watchedPath.substr(slash + 1);
+
+#ifdef __linux__
+  watchFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+  if (watchFd < 0) {
+    perror("inotify_init1");
+    return false;
+  }
+  // Watch the directory, not the file: a rename-over replaces the inode
+  watchDescriptor =
+      inotify_add_watch(watchFd, dir.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO);
+  if (watchDescriptor < 0) {
+    perror("inotify_add_watch");
+    close(watchFd);
+    watchFd = -1;
+    return false;
+  }
+#endif
+  return true;
+}
+
+bool pollLevelWatch() {
+  if (watchedPath.empty())
+    return false;
+
+#ifdef __linux__
+  if (watchFd < 0)
+    return false;
+
+  // Drain every queued event so a burst of saves causes a single reload
+  bool changed = false;
+  char buffer[4096]
+      __attribute__((aligned(__alignof__(struct inotify_event))));
+  for (;;) {
+    ssize_t len = read(watchFd, buffer, sizeof(buffer));
+    if (len <= 0)
+      break;
+    for (char *p = buffer; p < buffer + len;) {
+      struct inotify_event *event = (struct inotify_event *)p;
+      if (event->len > 0 && watchedName == event->name)
+        changed = true;
+      p += sizeof(struct inotify_event) + event->len;
+    }
+  }
+  if (changed)
+    lastWriteTime = fileWriteTime();
+  return changed;
+#else
+  struct timespec now = fileWriteTime();
+  if (now.tv_sec == lastWriteTime.tv_sec &&
+      now.tv_nsec == lastWriteTime.tv_nsec)
+    return false;
+  lastWriteTime = now;
+  return true;
+#endif
+}
+
+double levelFileAgeMs() {
+  struct timespec now;
+  clock_gettime(CLOCK_REALTIME, &now);
+  return (now.tv_sec - lastWriteTime.tv_sec) * 1000.0 +
+         (now.tv_nsec - lastWriteTime.tv_nsec) / 1000000.0;
+}
+
+void stopLevelWatch() {
+#ifdef __linux__
+  if (watchFd >= 0)
+    close(watchFd);
+#endif
+  watchFd = -1;
+  watchDescriptor = -1;
+}
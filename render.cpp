@@ -0,0 +1,594 @@
+#define GL_SILENCE_DEPRECATION // Ignore deprecation errors
+#include "headers/render.h"
+#include "headers/glstate.h"
+#include <GLUT/glut.h>
+#ifdef __APPLE__
+#define GL_DO_NOT_WARN_IF_MULTI_GL_VERSION_HEADERS_INCLUDED
+#include <OpenGL/gl3.h> // Core-profile entry points
+#endif
+#include <cmath>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+
+const RenderVertex RENDER_CUBE[RENDER_CUBE_VERTICES] = {
+    // Front
+    {{-0.5f, -0.5f, 0.5f}, {0.0f, 0.0f, 1.0f}, {0.0f, 0.0f}},
+    {{0.5f, -0.5f, 0.5f}, {0.0f, 0.0f, 1.0f}, {1.0f, 0.0f}},
+    {{0.5f, 0.5f, 0.5f}, {0.0f, 0.0f, 1.0f}, {1.0f, 1.0f}},
+    {{-0.5f, 0.5f, 0.5f}, {0.0f, 0.0f, 1.0f}, {0.0f, 1.0f}},
+    // Back
+    {{-0.5f, -0.5f, -0.5f}, {0.0f, 0.0f, -1.0f}, {1.0f, 0.0f}},
+    {{-0.5f, 0.5f, -0.5f}, {0.0f, 0.0f, -1.0f}, {1.0f, 1.0f}},
+    {{0.5f, 0.5f, -0.5f}, {0.0f, 0.0f, -1.0f}, {0.0f, 1.0f}},
+    {{0.5f, -0.5f, -0.5f}, {0.0f, 0.0f, -1.0f}, {0.0f, 0.0f}},
+    // Top
+    {{-0.5f, 0.5f, -0.5f}, {0.0f, 1.0f, 0.0f}, {0.0f, 1.0f}},
+    {{-0.5f, 0.5f, 0.5f}, {0.0f, 1.0f, 0.0f}, {0.0f, 0.0f}},
+    {{0.5f, 0.5f, 0.5f}, {0.0f, 1.0f, 0.0f}, {1.0f, 0.0f}},
+    {{0.5f, 0.5f, -0.5f}, {0.0f, 1.0f, 0.0f}, {1.0f, 1.0f}},
+    // Bottom
+    {{-0.5f, -0.5f, -0.5f}, {0.0f, -1.0f, 0.0f}, {1.0f, 1.0f}},
+    {{0.5f, -0.5f, -0.5f}, {0.0f, -1.0f, 0.0f}, {0.0f, 1.0f}},
+    {{0.5f, -0.5f, 0.5f}, {0.0f, -1.0f, 0.0f}, {0.0f, 0.0f}},
+    {{-0.5f, -0.5f, 0.5f}, {0.0f, -1.0f, 0.0f}, {1.0f, 0.0f}},
+    // Right
+    {{0.5f, -0.5f, -0.5f}, {1.0f, 0.0f, 0.0f}, {1.0f, 0.0f}},
+    {{0.5f, 0.5f, -0.5f}, {1.0f, 0.0f, 0.0f}, {1.0f, 1.0f}},
+    {{0.5f, 0.5f, 0.5f}, {1.0f, 0.0f, 0.0f}, {0.0f, 1.0f}},
+    {{0.5f, -0.5f, 0.5f}, {1.0f, 0.0f, 0.0f}, {0.0f, 0.0f}},
+    // Left
+    {{-0.5f, -0.5f, -0.5f}, {-1.0f, 0.0f, 0.0f}, {0.0f, 0.0f}},
+    {{-0.5f, -0.5f, 0.5f}, {-1.0f, 0.0f, 0.0f}, {1.0f, 0.0f}},
+    {{-0.5f, 0.5f, 0.5f}, {-1.0f, 0.0f, 0.0f}, {1.0f, 1.0f}},
+    {{-0.5f, 0.5f, -0.5f}, {-1.0f, 0.0f, 0.0f}, {0.0f, 1.0f}},
+};
+
+// 5x7 font for ASCII 32 to 126: a byte per column, bit 0 at the top
+static const unsigned char FONT[95][5] = {
+    {0x00, 0x00, 0x00, 0x00, 0x00}, {0x00, 0x00, 0x5F, 0x00, 0x00}, // ' ' !
+    {0x00, 0x07, 0x00, 0x07, 0x00}, {0x14, 0x7F, 0x14, 0x7F, 0x14}, // " #
+    {0x24, 0x2A, 0x7F, 0x2A, 0x12}, {0x23, 0x13, 0x08, 0x64, 0x62}, // $ %
+    {0x36, 0x49, 0x55, 0x22, 0x50}, {0x00, 0x05, 0x03, 0x00, 0x00}, // & '
+    {0x00, 0x1C, 0x22, 0x41, 0x00}, {0x00, 0x41, 0x22, 0x1C, 0x00}, // ( )
+    {0x14, 0x08, 0x3E, 0x08, 0x14}, {0x08, 0x08, 0x3E, 0x08, 0x08}, // * +
+    {0x00, 0x50, 0x30, 0x00, 0x00}, {0x08, 0x08, 0x08, 0x08, 0x08}, // , -
+    {0x00, 0x60, 0x60, 0x00, 0x00}, {0x20, 0x10, 0x08, 0x04, 0x02}, // . /
+    {0x3E, 0x51, 0x49, 0x45, 0x3E}, {0x00, 0x42, 0x7F, 0x40, 0x00}, // 0 1
+    {0x42, 0x61, 0x51, 0x49, 0x46}, {0x21, 0x41, 0x45, 0x4B, 0x31}, // 2 3
+    {0x18, 0x14, 0x12, 0x7F, 0x10}, {0x27, 0x45, 0x45, 0x45, 0x39}, // 4 5
+    {0x3C, 0x4A, 0x49, 0x49, 0x30}, {0x01, 0x71, 0x09, 0x05, 0x03}, // 6 7
+    {0x36, 0x49, 0x49, 0x49, 0x36}, {0x06, 0x49, 0x49, 0x29, 0x1E}, // 8 9
+    {0x00, 0x36, 0x36, 0x00, 0x00}, {0x00, 0x56, 0x36, 0x00, 0x00}, // : ;
+    {0x08, 0x14, 0x22, 0x41, 0x00}, {0x14, 0x14, 0x14, 0x14, 0x14}, // < =
+    {0x00, 0x41, 0x22, 0x14, 0x08}, {0x02, 0x01, 0x51, 0x09, 0x06}, // > ?
+    {0x32, 0x49, 0x79, 0x41, 0x3E}, {0x7E, 0x11, 0x11, 0x11, 0x7E}, // @ A
+    {0x7F, 0x49, 0x49, 0x49, 0x36}, {0x3E, 0x41, 0x41, 0x41, 0x22}, // B C
+    {0x7F, 0x41, 0x41, 0x22, 0x1C}, {0x7F, 0x49, 0x49, 0x49, 0x41}, // D E
+    {0x7F, 0x09, 0x09, 0x01, 0x01}, {0x3E, 0x41, 0x41, 0x51, 0x32}, // F G
+    {0x7F, 0x08, 0x08, 0x08, 0x7F}, {0x00, 0x41, 0x7F, 0x41, 0x00}, // H I
+    {0x20, 0x40, 0x41, 0x3F, 0x01}, {0x7F, 0x08, 0x14, 0x22, 0x41}, // J K
+    {0x7F, 0x40, 0x40, 0x40, 0x40}, {0x7F, 0x02, 0x04, 0x02, 0x7F}, // L M
+    {0x7F, 0x04, 0x08, 0x10, 0x7F}, {0x3E, 0x41, 0x41, 0x41, 0x3E}, // N O
+    {0x7F, 0x09, 0x09, 0x09, 0x06}, {0x3E, 0x41, 0x51, 0x21, 0x5E}, // P Q
+    {0x7F, 0x09, 0x19, 0x29, 0x46}, {0x46, 0x49, 0x49, 0x49, 0x31}, // R S
+    {0x01, 0x01, 0x7F, 0x01, 0x01}, {0x3F, 0x40, 0x40, 0x40, 0x3F}, // T U
+    {0x1F, 0x20, 0x40, 0x20, 0x1F}, {0x7F, 0x20, 0x18, 0x20, 0x7F}, // V W
+    {0x63, 0x14, 0x08, 0x14, 0x63}, {0x03, 0x04, 0x78, 0x04, 0x03}, // X Y
+    {0x61, 0x51, 0x49, 0x45, 0x43}, {0x00, 0x7F, 0x41, 0x41, 0x00}, // Z [
+    {0x02, 0x04, 0x08, 0x10, 0x20}, {0x00, 0x41, 0x41, 0x7F, 0x00}, // \ ]
+    {0x04, 0x02, 0x01, 0x02, 0x04}, {0x40, 0x40, 0x40, 0x40, 0x40}, // ^ _
+    {0x00, 0x01, 0x02, 0x04, 0x00}, {0x20, 0x54, 0x54, 0x54, 0x78}, // ` a
+    {0x7F, 0x48, 0x44, 0x44, 0x38}, {0x38, 0x44, 0x44, 0x44, 0x20}, // b c
+    {0x38, 0x44, 0x44, 0x48, 0x7F}, {0x38, 0x54, 0x54, 0x54, 0x18}, // d e
+    {0x08, 0x7E, 0x09, 0x01, 0x02}, {0x08, 0x14, 0x54, 0x54, 0x3C}, // f g
+    {0x7F, 0x08, 0x04, 0x04, 0x78}, {0x00, 0x44, 0x7D, 0x40, 0x00}, // h i
+    {0x20, 0x40, 0x44, 0x3D, 0x00}, {0x00, 0x7F, 0x10, 0x28, 0x44}, // j k
+    {0x00, 0x41, 0x7F, 0x40, 0x00}, {0x7C, 0x04, 0x18, 0x04, 0x78}, // l m
+    {0x7C, 0x08, 0x04, 0x04, 0x78}, {0x38, 0x44, 0x44, 0x44, 0x38}, // n o
+    {0x7C, 0x14, 0x14, 0x14, 0x08}, {0x08, 0x14, 0x14, 0x18, 0x7C}, // p q
+    {0x7C, 0x08, 0x04, 0x04, 0x08}, {0x48, 0x54, 0x54, 0x54, 0x20}, // r s
+    {0x04, 0x3F, 0x44, 0x40, 0x20}, {0x3C, 0x40, 0x40, 0x20, 0x7C}, // t u
+    {0x1C, 0x20, 0x40, 0x20, 0x1C}, {0x3C, 0x40, 0x30, 0x40, 0x3C}, // v w
+    {0x44, 0x28, 0x10, 0x28, 0x44}, {0x0C, 0x50, 0x50, 0x50, 0x3C}, // x y
+    {0x44, 0x64, 0x54, 0x4C, 0x44}, {0x00, 0x08, 0x36, 0x41, 0x00}, // z {
+    {0x00, 0x00, 0x7F, 0x00, 0x00}, {0x00, 0x41, 0x36, 0x08, 0x00}, // | }
+    {0x08, 0x04, 0x08, 0x10, 0x08},                                 // ~
+};
+
+// The font texture: 16 x 6 cells of 6 x 8 texels (a column and a row of
+// spacing), ASCII 32 on. The cell of 127 is solid, for rectangles.
+const int FONT_CELL_WIDTH = 6, FONT_CELL_HEIGHT = 8, FONT_COLUMNS = 16;
+const int FONT_WIDTH = FONT_CELL_WIDTH * FONT_COLUMNS;
+const int FONT_HEIGHT = FONT_CELL_HEIGHT * 6;
+const int FONT_SOLID = 127;
+
+// The Scene uniform block, std140
+struct SceneBlock {
+  float projection[16], view[16];
+  float lightDirection[4], lightAmbient[4], lightDiffuse[4], lightSpecular[4];
+  float sceneAmbient[4];
+};
+
+// The block, lit per vertex as the fixed pipeline: normals go through the
+// inverse transpose unnormalised (so the stretched block's long faces are
+// dimmer, as without GL_NORMALIZE), and specular uses an infinite viewer
+static const char *BLOCK_SHADER =
+    "attribute vec3 corner;\n"
+    "attribute vec3 normal;\n"
+    "attribute vec2 uv;\n"
+    "uniform mat4 model;\n"
+    "uniform vec4 ambient;\n"
+    "uniform vec4 diffuse;\n"
+    "uniform vec4 specular;\n"
+    "uniform float shininess;\n"
+    "varying vec4 color;\n"
+    "varying vec2 texCoord;\n"
+    "void main() {\n"
+    "  mat4 modelview = view * model;\n"
+    "  gl_Position = projection * modelview * vec4(corner, 1.0);\n"
+    "  vec3 n = transpose(inverse(mat3(modelview))) * normal;\n"
+    "  vec3 l = normalize(lightDirection.xyz);\n"
+    "  float lambert = max(dot(n, l), 0.0);\n"
+    "  vec3 lit = (sceneAmbient.rgb + lightAmbient.rgb) * ambient.rgb +\n"
+    "             lambert * lightDiffuse.rgb * diffuse.rgb;\n"
+    "  if (lambert > 0.0) {\n"
+    "    vec3 h = normalize(l + vec3(0.0, 0.0, 1.0));\n"
+    "    lit += pow(max(dot(n, h), 0.0), shininess) * lightSpecular.rgb *\n"
+    "           specular.rgb;\n"
+    "  }\n"
+    "  color = vec4(clamp(lit, 0.0, 1.0), diffuse.a);\n"
+    "  texCoord = uv;\n"
+    "}\n";
+
+static const char *BLOCK_FRAGMENT_SHADER =
+    "uniform sampler2D glass;\n"
+    "uniform bool textured;\n"
+    "varying vec4 color;\n"
+    "varying vec2 texCoord;\n"
+    "void main() {\n"
+    "  fragColor = textured ? color * texture2D(glass, texCoord) : color;\n"
+    "}\n";
+
+static const char *POINT_SHADER =
+    "attribute vec3 corner;\n"
+    "attribute float size;\n"
+    "attribute vec4 tint;\n"
+    "varying vec4 color;\n"
+    "void main() {\n"
+    "  gl_Position = projection * view * vec4(corner, 1.0);\n"
+    "  gl_PointSize = size;\n"
+    "  color = tint;\n"
+    "}\n";
+
+static const char *POINT_FRAGMENT_SHADER =
+    "varying vec4 color;\n"
+    "void main() {\n"
+    "  fragColor = color;\n"
+    "}\n";
+
+static const char *OVERLAY_SHADER =
+    "attribute vec2 corner;\n"
+    "attribute vec2 uv;\n"
+    "attribute vec4 tint;\n"
+    "uniform vec2 pixelScale;\n" // 2 / window size
+    "varying vec2 texCoord;\n"
+    "varying vec4 color;\n"
+    "void main() {\n"
+    "  gl_Position = vec4(corner * pixelScale - 1.0, 0.0, 1.0);\n"
+    "  texCoord = uv;\n"
+    "  color = tint;\n"
+    "}\n";
+
+static const char *OVERLAY_FRAGMENT_SHADER =
+    "uniform sampler2D font;\n"
+    "varying vec2 texCoord;\n"
+    "varying vec4 color;\n"
+    "void main() {\n"
+    "  fragColor = vec4(color.rgb, color.a * texture2D(font, texCoord).r);\n"
+    "}\n";
+
+static const char *VERTEX_PREFIX =
+    "#version 330 core\n"
+    "#define attribute in\n"
+    "#define varying out\n" RENDER_SCENE_GLSL;
+static const char *FRAGMENT_PREFIX = "#version 330 core\n"
+                                     "#define varying in\n"
+                                     "#define texture2D texture\n"
+                                     "out vec4 fragColor;\n";
+
+// An overlay vertex: window position, font texture position, colour
+struct OverlayVertex {
+  float x, y, u, v;
+  float color[4];
+};
+
+static struct {
+  unsigned int vao, scene;
+  unsigned int cube, points, overlay;
+  unsigned int font;
+  unsigned int blockProgram, pointProgram, overlayProgram;
+  int model, ambient, diffuse, specular, shininess, textured;
+  int pixelScale;
+  std::vector<OverlayVertex> quads; // Queued 2D
+} renderer;
+
+Mat4 mat4Identity() {
+  Mat4 r = {};
+  r.m[0] = r.m[5] = r.m[10] = r.m[15] = 1.0f;
+  return r;
+}
+
+Mat4 mat4Multiply(const Mat4 &a, const Mat4 &b) {
+  Mat4 r;
+  for (int col = 0; col < 4; col++)
+    for (int row = 0; row < 4; row++) {
+      float sum = 0.0f;
+      for (int k = 0; k < 4; k++)
+        sum += a.m[k * 4 + row] * b.m[col * 4 + k];
+      r.m[col * 4 + row] = sum;
+    }
+  return r;
+}
+
+// As gluPerspective
+Mat4 mat4Perspective(float fovYDegrees, float aspect, float zNear,
+                     float zFar) {
+  float f = 1.0f / tanf(fovYDegrees * (float)M_PI / 360.0f);
+  Mat4 r = {};
+  r.m[0] = f / aspect;
+  r.m[5] = f;
+  r.m[10] = (zFar + zNear) / (zNear - zFar);
+  r.m[11] = -1.0f;
+  r.m[14] = 2.0f * zFar * zNear / (zNear - zFar);
+  return r;
+}
+
+static void normalize3(float v[3]) {
+  float length = sqrtf(v[0] * v[0] + v[1] * v[1] + v[2] * v[2]);
+  if (length > 0.0f)
+    for (int i = 0; i < 3; i++)
+      v[i] /= length;
+}
+
+static void cross3(const float a[3], const float b[3], float r[3]) {
+  r[0] = a[1] * b[2] - a[2] * b[1];
+  r[1] = a[2] * b[0] - a[0] * b[2];
+  r[2] = a[0] * b[1] - a[1] * b[0];
+}
+
+// As gluLookAt
+Mat4 mat4LookAt(const float eye[3], const float centre[3], const float up[3]) {
+  float f[3] = {centre[0] - eye[0], centre[1] - eye[1], centre[2] - eye[2]};
+  normalize3(f);
+  float s[3], u[3];
+  cross3(f, up, s);
+  normalize3(s);
+  cross3(s, f, u);
+  Mat4 r = mat4Identity();
+  for (int i = 0; i < 3; i++) {
+    r.m[i * 4] = s[i];
+    r.m[i * 4 + 1] = u[i];
+    r.m[i * 4 + 2] = -f[i];
+  }
+  return mat4Multiply(r, mat4Translate(-eye[0], -eye[1], -eye[2]));
+}
+
+Mat4 mat4Translate(float x, float y, float z) {
+  Mat4 r = mat4Identity();
+  r.m[12] = x;
+  r.m[13] = y;
+  r.m[14] = z;
+  return r;
+}
+
+// As glRotatef
+Mat4 mat4Rotate(float degrees, float x, float y, float z) {
+  float radians = degrees * (float)M_PI / 180.0f;
+  float c = cosf(radians), s = sinf(radians), t = 1.0f - c;
+  Mat4 r = mat4Identity();
+  r.m[0] = x * x * t + c;
+  r.m[1] = y * x * t + z * s;
+  r.m[2] = x * z * t - y * s;
+  r.m[4] = x * y * t - z * s;
+  r.m[5] = y * y * t + c;
+  r.m[6] = y * z * t + x * s;
+  r.m[8] = x * z * t + y * s;
+  r.m[9] = y * z * t - x * s;
+  r.m[10] = z * z * t + c;
+  return r;
+}
+
+Mat4 mat4Scale(float x, float y, float z) {
+  Mat4 r = mat4Identity();
+  r.m[0] = x;
+  r.m[5] = y;
+  r.m[10] = z;
+  return r;
+}
+
+unsigned int renderProgram(const char *vertexBody, const char *fragmentBody,
+                           const char *const *attributes,
+                           int attributeCount) {
+  const char *sources[2][2] = {{VERTEX_PREFIX, vertexBody},
+                               {FRAGMENT_PREFIX, fragmentBody}};
+  GLenum types[2] = {GL_VERTEX_SHADER, GL_FRAGMENT_SHADER};
+  GLuint program = glCreateProgram();
+  char log[1024] = "";
+  bool ok = true;
+  for (int i = 0; i < 2 && ok; i++) {
+    GLuint shader = glCreateShader(types[i]);
+    glShaderSource(shader, 2, sources[i], NULL);
+    glCompileShader(shader);
+    GLint compiled;
+    glGetShaderiv(shader, GL_COMPILE_STATUS, &compiled);
+    if (compiled)
+      glAttachShader(program, shader);
+    else
+      glGetShaderInfoLog(shader, sizeof(log), NULL, log);
+    glDeleteShader(shader); // Freed with the program
+    ok = compiled;
+  }
+  if (ok) {
+    for (int i = 0; i < attributeCount; i++)
+      glBindAttribLocation(program, i, attributes[i]);
+    glLinkProgram(program);
+    GLint linked;
+    glGetProgramiv(program, GL_LINK_STATUS, &linked);
+    if (!linked)
+      glGetProgramInfoLog(program, sizeof(log), NULL, log);
+    ok = linked;
+  }
+  if (!ok) {
+    printf("Shader error: %s\n", log);
+    glDeleteProgram(program);
+    return 0;
+  }
+  GLuint scene = glGetUniformBlockIndex(program, "Scene");
+  if (scene != GL_INVALID_INDEX)
+    glUniformBlockBinding(program, scene, RENDER_SCENE_BINDING);
+  return program;
+}
+
+static void uploadFont() {
+  std::vector<unsigned char> texels(FONT_WIDTH * FONT_HEIGHT, 0);
+  for (int c = 32; c <= FONT_SOLID; c++) {
+    int cell = c - 32;
+    int x0 = cell % FONT_COLUMNS * FONT_CELL_WIDTH;
+    int top = cell / FONT_COLUMNS * FONT_CELL_HEIGHT; // From the top
+    for (int row = 0; row < FONT_CELL_HEIGHT; row++)
+      for (int col = 0; col < FONT_CELL_WIDTH; col++) {
+        bool on = c == FONT_SOLID ||
+                  (col < 5 && row < 7 && (FONT[cell][col] >> row & 1));
+        // Texture rows run from the bottom
+        texels[(FONT_HEIGHT - 1 - top - row) * FONT_WIDTH + x0 + col] =
+            on ? 255 : 0;
+      }
+  }
+  glGenTextures(1, &renderer.font);
+  stateBindTexture(renderer.font);
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+  glTexImage2D(GL_TEXTURE_2D, 0, GL_R8, FONT_WIDTH, FONT_HEIGHT, 0, GL_RED,
+               GL_UNSIGNED_BYTE, texels.data());
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+  stateBindTexture(0);
+}
+
+bool renderInit() {
+  GLint major = 0, minor = 0;
+  glGetIntegerv(GL_MAJOR_VERSION, &major);
+  glGetIntegerv(GL_MINOR_VERSION, &minor);
+  if (major * 10 + minor < 33) {
+    printf("The core renderer needs GL 3.3, got %s\n",
+           (const char *)glGetString(GL_VERSION));
+    return false;
+  }
+  static const char *blockAttributes[] = {"corner", "normal", "uv"};
+  static const char *pointAttributes[] = {"corner", "size", "tint"};
+  static const char *overlayAttributes[] = {"corner", "uv", "tint"};
+  renderer.blockProgram =
+      renderProgram(BLOCK_SHADER, BLOCK_FRAGMENT_SHADER, blockAttributes, 3);
+  renderer.pointProgram =
+      renderProgram(POINT_SHADER, POINT_FRAGMENT_SHADER, pointAttributes, 3);
+  renderer.overlayProgram = renderProgram(
+      OVERLAY_SHADER, OVERLAY_FRAGMENT_SHADER, overlayAttributes, 3);
+  if (!renderer.blockProgram || !renderer.pointProgram ||
+      !renderer.overlayProgram)
+    return false;
+  GLuint block = renderer.blockProgram;
+  renderer.model = glGetUniformLocation(block, "model");
+  renderer.ambient = glGetUniformLocation(block, "ambient");
+  renderer.diffuse = glGetUniformLocation(block, "diffuse");
+  renderer.specular = glGetUniformLocation(block, "specular");
+  renderer.shininess = glGetUniformLocation(block, "shininess");
+  renderer.textured = glGetUniformLocation(block, "textured");
+  renderer.pixelScale =
+      glGetUniformLocation(renderer.overlayProgram, "pixelScale");
+
+  // One vertex array for everything: draws point its attributes as the
+  // legacy path points its client arrays
+  glGenVertexArrays(1, &renderer.vao);
+  glBindVertexArray(renderer.vao);
+  glGenBuffers(1, &renderer.scene);
+  glBindBuffer(GL_UNIFORM_BUFFER, renderer.scene);
+  glBufferData(GL_UNIFORM_BUFFER, sizeof(SceneBlock), NULL, GL_DYNAMIC_DRAW);
+  glBindBufferBase(GL_UNIFORM_BUFFER, RENDER_SCENE_BINDING, renderer.scene);
+
+  // The cube as triangles
+  RenderVertex triangles[RENDER_CUBE_VERTICES / 4 * 6];
+  static const int QUAD_TRIANGLES[6] = {0, 1, 2, 0, 2, 3};
+  for (int q = 0; q < RENDER_CUBE_VERTICES / 4; q++)
+    for (int i = 0; i < 6; i++)
+      triangles[q * 6 + i] = RENDER_CUBE[q * 4 + QUAD_TRIANGLES[i]];
+  glGenBuffers(1, &renderer.cube);
+  glBindBuffer(GL_ARRAY_BUFFER, renderer.cube);
+  glBufferData(GL_ARRAY_BUFFER, sizeof(triangles), triangles, GL_STATIC_DRAW);
+  glGenBuffers(1, &renderer.points);
+  glGenBuffers(1, &renderer.overlay);
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+  uploadFont();
+  stateUseProgram(renderer.overlayProgram);
+  glUniform1i(glGetUniformLocation(renderer.overlayProgram, "font"), 0);
+  stateUseProgram(renderer.blockProgram);
+  glUniform1i(glGetUniformLocation(block, "glass"), 0);
+  stateUseProgram(0);
+  stateEnable(GL_PROGRAM_POINT_SIZE);
+  return true;
+}
+
+void renderBeginFrame(const Mat4 &projection, const Mat4 &view,
+                      const RenderLight &light) {
+  SceneBlock scene;
+  memcpy(scene.projection, projection.m, sizeof(scene.projection));
+  memcpy(scene.view, view.m, sizeof(scene.view));
+  for (int i = 0; i < 4; i++) {
+    scene.lightDirection[i] = 0.0f;
+    for (int k = 0; k < 4; k++)
+      scene.lightDirection[i] += view.m[k * 4 + i] * light.direction[k];
+  }
+  memcpy(scene.lightAmbient, light.ambient, sizeof(light.ambient));
+  memcpy(scene.lightDiffuse, light.diffuse, sizeof(light.diffuse));
+  memcpy(scene.lightSpecular, light.specular, sizeof(light.specular));
+  memcpy(scene.sceneAmbient, light.sceneAmbient, sizeof(light.sceneAmbient));
+  glBindBuffer(GL_UNIFORM_BUFFER, renderer.scene);
+  glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(scene), &scene);
+  glBindBuffer(GL_UNIFORM_BUFFER, 0);
+}
+
+void renderBlock(const Mat4 &model, const RenderMaterial &material,
+                 unsigned int texture) {
+  stateUseProgram(renderer.blockProgram);
+  glUniformMatrix4fv(renderer.model, 1, GL_FALSE, model.m);
+  glUniform4fv(renderer.ambient, 1, material.ambient);
+  glUniform4fv(renderer.diffuse, 1, material.diffuse);
+  glUniform4fv(renderer.specular, 1, material.specular);
+  glUniform1f(renderer.shininess, material.shininess);
+  glUniform1i(renderer.textured, texture != 0);
+  stateBindTexture(texture);
+
+  GLsizei stride = sizeof(RenderVertex);
+  glBindBuffer(GL_ARRAY_BUFFER, renderer.cube);
+  glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, stride,
+                        (const GLvoid *)offsetof(RenderVertex, position));
+  glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, stride,
+                        (const GLvoid *)offsetof(RenderVertex, normal));
+  glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, stride,
+                        (const GLvoid *)offsetof(RenderVertex, uv));
+  for (int a = 0; a < 3; a++)
+    glEnableVertexAttribArray(a);
+  // Translucent: the far faces first, then the near ones over them
+  stateEnable(GL_CULL_FACE);
+  stateCullFace(GL_FRONT);
+  glDrawArrays(GL_TRIANGLES, 0, RENDER_CUBE_VERTICES / 4 * 6);
+  stateCullFace(GL_BACK);
+  glDrawArrays(GL_TRIANGLES, 0, RENDER_CUBE_VERTICES / 4 * 6);
+  stateDisable(GL_CULL_FACE);
+  for (int a = 0; a < 3; a++)
+    glDisableVertexAttribArray(a);
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void renderPoints(const std::vector<RenderPoint> &points) {
+  if (points.empty())
+    return;
+  stateUseProgram(renderer.pointProgram);
+  GLsizei stride = sizeof(RenderPoint);
+  glBindBuffer(GL_ARRAY_BUFFER, renderer.points);
+  glBufferData(GL_ARRAY_BUFFER, points.size() * stride, points.data(),
+               GL_STREAM_DRAW);
+  glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, stride,
+                        (const GLvoid *)offsetof(RenderPoint, position));
+  glVertexAttribPointer(1, 1, GL_FLOAT, GL_FALSE, stride,
+                        (const GLvoid *)offsetof(RenderPoint, size));
+  glVertexAttribPointer(2, 4, GL_FLOAT, GL_FALSE, stride,
+                        (const GLvoid *)offsetof(RenderPoint, color));
+  for (int a = 0; a < 3; a++)
+    glEnableVertexAttribArray(a);
+  glDrawArrays(GL_POINTS, 0, points.size());
+  for (int a = 0; a < 3; a++)
+    glDisableVertexAttribArray(a);
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+// Queue a rectangle showing font cell 'c' (stretched over it)
+static void quad(float x0, float y0, float x1, float y1, int c,
+                 const float color[4]) {
+  int cell = c - 32;
+  float u0 = (float)(cell % FONT_COLUMNS * FONT_CELL_WIDTH) / FONT_WIDTH;
+  float u1 = u0 + (float)FONT_CELL_WIDTH / FONT_WIDTH;
+  float v1 = 1.0f - (float)(cell / FONT_COLUMNS * FONT_CELL_HEIGHT) /
+                        FONT_HEIGHT;
+  float v0 = v1 - (float)FONT_CELL_HEIGHT / FONT_HEIGHT;
+  const float r = color[0], g = color[1], b = color[2], a = color[3];
+  OverlayVertex corners[4] = {{x0, y0, u0, v0, {r, g, b, a}},
+                              {x1, y0, u1, v0, {r, g, b, a}},
+                              {x1, y1, u1, v1, {r, g, b, a}},
+                              {x0, y1, u0, v1, {r, g, b, a}}};
+  static const int QUAD_TRIANGLES[6] = {0, 1, 2, 0, 2, 3};
+  for (int i = 0; i < 6; i++)
+    renderer.quads.push_back(corners[QUAD_TRIANGLES[i]]);
+}
+
+void render2DRect(float x, float y, float width, float height,
+                  const float color[4]) {
+  // The middle of the solid cell, so filtering never reaches its edge
+  int cell = FONT_SOLID - 32;
+  float u = (cell % FONT_COLUMNS * FONT_CELL_WIDTH + 3.0f) / FONT_WIDTH;
+  float v = 1.0f - (cell / FONT_COLUMNS * FONT_CELL_HEIGHT + 4.0f) /
+                       FONT_HEIGHT;
+  const float r = color[0], g = color[1], b = color[2], a = color[3];
+  OverlayVertex corners[4] = {{x, y, u, v, {r, g, b, a}},
+                              {x + width, y, u, v, {r, g, b, a}},
+                              {x + width, y + height, u, v, {r, g, b, a}},
+                              {x, y + height, u, v, {r, g, b, a}}};
+  static const int QUAD_TRIANGLES[6] = {0, 1, 2, 0, 2, 3};
+  for (int i = 0; i < 6; i++)
+    renderer.quads.push_back(corners[QUAD_TRIANGLES[i]]);
+}
+
+void render2DText(float x, float y, const char *text, float scale,
+                  const float color[4]) {
+  // Whole pixels, so each font pixel covers the same number of them
+  x = floorf(x + 0.5f);
+  y = floorf(y + 0.5f);
+  for (const char *c = text; *c; c++) {
+    if (*c > ' ' && *c < FONT_SOLID)
+      quad(x, y - scale, x + FONT_CELL_WIDTH * scale,
+           y + (FONT_CELL_HEIGHT - 1) * scale, *c, color);
+    x += FONT_CELL_WIDTH * scale;
+  }
+}
+
+float render2DTextWidth(const char *text, float scale) {
+  return strlen(text) * FONT_CELL_WIDTH * scale;
+}
+
+void render2DFlush(int width, int height) {
+  if (renderer.quads.empty())
+    return;
+  stateUseProgram(renderer.overlayProgram);
+  glUniform2f(renderer.pixelScale, 2.0f / width, 2.0f / height);
+  stateBindTexture(renderer.font);
+  GLsizei stride = sizeof(OverlayVertex);
+  glBindBuffer(GL_ARRAY_BUFFER, renderer.overlay);
+  glBufferData(GL_ARRAY_BUFFER, renderer.quads.size() * stride,
+               renderer.quads.data(), GL_STREAM_DRAW);
+  glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, stride,
+                        (const GLvoid *)offsetof(OverlayVertex, x));
+  glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, stride,
+                        (const GLvoid *)offsetof(OverlayVertex, u));
+  glVertexAttribPointer(2, 4, GL_FLOAT, GL_FALSE, stride,
+                        (const GLvoid *)offsetof(OverlayVertex, color));
+  for (int a = 0; a < 3; a++)
+    glEnableVertexAttribArray(a);
+  glDrawArrays(GL_TRIANGLES, 0, renderer.quads.size());
+  for (int a = 0; a < 3; a++)
+    glDisableVertexAttribArray(a);
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+  renderer.quads.clear();
+}
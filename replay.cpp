@@ -0,0 +1,191 @@
+#include "headers/replay.h"
+#include "headers/grid.h"
+#include "headers/levelpack.h"
+#include "headers/levels.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+bool loadNamedLevel(const char *name, int packIndex,
+                    std::vector<std::vector<int> > &layout,
+                    std::vector<SwitchDef> &switches) {
+  switches.clear();
+  size_t len = strlen(name);
+  if (len > 0 && strspn(name, "0123456789") == len) {
+    layout = getLevelLayout(atoi(name));
+  } else if (packIndex >= 0) {
+    TileGrid grid;
+    if (!loadLevelFromPack(name, packIndex, grid))
+      return false;
+    gridToLayout(grid, layout);
+  } else {
+    LevelData level;
+    if (!loadLevelFile(name, level))
+      return false;
+    gridToLayout(level.grid, layout);
+    switches.swap(level.switches);
+  }
+  return !layout.empty() && !layout[0].empty();
+}
+
+static void putVarint(std::vector<unsigned char> &out, unsigned long long v) {
+  while (v >= 0x80) {
+    out.push_back((unsigned char)(v | 0x80));
+    v >>= 7;
+  }
+  out.push_back((unsigned char)v);
+}
+
+static bool getVarint(const unsigned char *&p, const unsigned char *end,
+                      unsigned long long &v) {
+  v = 0;
+  for (int shift = 0; p < end && shift < 64; shift += 7) {
+    unsigned char byte = *p++;
+    v |= (unsigned long long)(byte & 0x7F) << shift;
+    if (!(byte & 0x80))
+      return true;
+  }
+  return false;
+}
+
+static void putU64(std::vector<unsigned char> &out, unsigned long long v) {
+  for (int i = 0; i < 8; i++)
+    out.push_back((unsigned char)(v >> (8 * i)));
+}
+
+static bool getU64(const unsigned char *&p, const unsigned char *end,
+                   unsigned long long &v) {
+  if (end - p < 8)
+    return false;
+  v = 0;
+  for (int i = 0; i < 8; i++)
+    v |= (unsigned long long)p[i] << (8 * i);
+  p += 8;
+  return true;
+}
+
+void beginInputLog(InputLog &log, const char *levelName, int packIndex,
+                   const SimState &sim) {
+  log.levelName = levelName;
+  log.packIndex = packIndex;
+  log.levelHash = simLevelHash(sim);
+  log.events.clear();
+  log.lastTick = sim.tick;
+  log.finalTick = sim.tick;
+  log.finalHash = 0;
+}
+
+void logInput(InputLog &log, unsigned int tick, SimInput input) {
+  putVarint(log.events, (unsigned long long)(tick - log.lastTick) << 3 | input);
+  log.lastTick = tick;
+}
+
+void endInputLog(InputLog &log, const SimState &sim) {
+  log.finalTick = sim.tick;
+  log.finalHash = simStateHash(sim);
+}
+
+void encodeInputLog(const InputLog &log, std::vector<unsigned char> &out) {
+  out.assign((const unsigned char *)"BLXR", (const unsigned char *)"BLXR" + 4);
+  out.push_back(2); // Version (1 hashed the old float block state)
+  putVarint(out, log.levelName.size());
+  out.insert(out.end(), log.levelName.begin(), log.levelName.end());
+  putVarint(out, log.packIndex + 1);
+  putU64(out, log.levelHash);
+  putVarint(out, log.events.size());
+  out.insert(out.end(), log.events.begin(), log.events.end());
+  putVarint(out, log.finalTick - log.lastTick);
+  putU64(out, log.finalHash);
+}
+
+bool decodeInputLog(const unsigned char *data, size_t size, InputLog &log) {
+  const unsigned char *p = data, *end = data + size;
+  if (size < 5 || memcmp(p, "BLXR", 4) != 0 || p[4] != 2)
+    return false;
+  p += 5;
+
+  unsigned long long nameSize, packIndex, eventBytes, finalDelta;
+  if (!getVarint(p, end, nameSize) || (unsigned long long)(end - p) < nameSize)
+    return false;
+  log.levelName.assign((const char *)p, nameSize);
+  p += nameSize;
+  if (!getVarint(p, end, packIndex) || !getU64(p, end, log.levelHash) ||
+      !getVarint(p, end, eventBytes) ||
+      (unsigned long long)(end - p) < eventBytes)
+    return false;
+  log.packIndex = (int)packIndex - 1;
+  log.events.assign(p, p + eventBytes);
+  p += eventBytes;
+
+  // Sum the deltas to find the tick of the last event
+  unsigned long long tick = 0, event;
+  const unsigned char *e = log.events.data(), *eventsEnd = e + eventBytes;
+  while (e < eventsEnd) {
+    if (!getVarint(e, eventsEnd, event))
+      return false;
+    tick += event >> 3;
+  }
+  log.lastTick = (unsigned int)tick;
+  if (!getVarint(p, end, finalDelta) || !getU64(p, end, log.finalHash))
+    return false;
+  log.finalTick = (unsigned int)(tick + finalDelta);
+  return p == end;
+}
+
+bool saveInputLog(const char *path, const InputLog &log) {
+  std::vector<unsigned char> data;
+  encodeInputLog(log, data);
+  FILE *file = fopen(path, "wb");
+  if (!file) {
+    printf("Cannot write input log %s\n", path);
+    return false;
+  }
+  bool ok = fwrite(data.data(), 1, data.size(), file) == data.size();
+  ok = fclose(file) == 0 && ok;
+  if (!ok)
+    printf("Error writing input log %s\n", path);
+  return ok;
+}
+
+bool loadInputLog(const char *path, InputLog &log) {
+  FILE *file = fopen(path, "rb");
+  if (!file) {
+    printf("Cannot open input log %s\n", path);
+    return false;
+  }
+  std::vector<unsigned char> data;
+  unsigned char buffer[65536];
+  size_t n;
+  while ((n = fread(buffer, 1, sizeof(buffer), file)) > 0)
+    data.insert(data.end(), buffer, buffer + n);
+  fclose(file);
+  if (!decodeInputLog(data.data(), data.size(), log)) {
+    bool old = data.size() > 4 && data[4] < 2;
+    printf("Input log %s is %s\n", path,
+           old ? "from an older version, record it again" : "damaged");
+    return false;
+  }
+  return true;
+}
+
+bool replayInputLog(const InputLog &log, SimState &sim, long long &moves) {
+  moves = 0;
+  if (simLevelHash(sim) != log.levelHash)
+    return false;
+
+  const unsigned char *p = log.events.data(), *end = p + log.events.size();
+  unsigned int tick = sim.tick;
+  unsigned long long event;
+  while (p < end) {
+    getVarint(p, end, event);
+    tick += (unsigned int)(event >> 3);
+    while (sim.tick < tick)
+      simStep(sim, INPUT_NONE);
+    if (!simStep(sim, (SimInput)(event & 7)))
+      return false; // The recorded input could not be applied here
+    moves++;
+  }
+  while (sim.tick < log.finalTick)
+    simStep(sim, INPUT_NONE);
+  return sim.tick == log.finalTick && simStateHash(sim) == log.finalHash;
+}
@@ -0,0 +1,243 @@
+#include "headers/rewind.h"
+#include <cmath>
+#include <cstring>
+
+// Frame layout: block fields, win flag and roll origin, camera targets (as
+// float bits, so they come back exact), then the toggle groups' visibility,
+// 32 groups per int
+enum {
+  FIELD_ROW, FIELD_COL, FIELD_ORIENTATION,
+  FIELD_ANIMATING, FIELD_ANIMATION_TICK,
+  FIELD_FROM_ROW, FIELD_FROM_COL, FIELD_FROM_ORIENTATION,
+  FIELD_MOVE_DX, FIELD_MOVE_DZ,
+  FIELD_FALLING, FIELD_FALL_TICK,
+  FIELD_WON, FIELD_MOVE_FROM,
+  FIELD_CAMERA, // 3 fields
+  FIELD_GROUPS = FIELD_CAMERA + 3
+};
+
+static void writeVarint(std::vector<unsigned char> &out, unsigned int v) {
+  while (v >= 0x80) {
+    out.push_back((unsigned char)(v | 0x80));
+    v >>= 7;
+  }
+  out.push_back((unsigned char)v);
+}
+
+static unsigned int readVarint(const unsigned char *&p) {
+  unsigned int v = 0;
+  for (int shift = 0;; shift += 7) {
+    unsigned char byte = *p++;
+    v |= (unsigned int)(byte & 0x7F) << shift;
+    if (!(byte & 0x80))
+      return v;
+  }
+}
+
+// Small differences of either sign become small varints. The arithmetic
+// wraps, so float bits round-trip too.
+static unsigned int zigzag(unsigned int diff) {
+  return (diff << 1) ^ (unsigned int)((int)diff >> 31);
+}
+
+static unsigned int unzigzag(unsigned int v) {
+  return (v >> 1) ^ (0u - (v & 1));
+}
+
+static RewindSegment &segmentAt(RewindHistory &history, int i) {
+  return history.segments[(history.first + i) % history.segments.size()];
+}
+
+static const RewindSegment &segmentAt(const RewindHistory &history, int i) {
+  return history.segments[(history.first + i) % history.segments.size()];
+}
+
+// Decode frames 0 .. frame of a segment into 'fields'; returns the offset
+// just past that frame
+static size_t decodeSegment(const RewindSegment &segment, int frame,
+                            std::vector<int> &fields) {
+  const unsigned char *start = segment.bytes.data();
+  const unsigned char *p = start;
+  for (size_t i = 0; i < fields.size(); i++)
+    fields[i] = (int)unzigzag(readVarint(p));
+  for (int f = 1; f <= frame; f++) {
+    unsigned int changes = readVarint(p);
+    size_t i = 0;
+    for (unsigned int c = 0; c < changes; c++) {
+      i += readVarint(p);
+      fields[i] = (int)((unsigned int)fields[i] + unzigzag(readVarint(p)));
+    }
+  }
+  return p - start;
+}
+
+void rewindInit(RewindHistory &history, double seconds, int keyframeTicks) {
+  history.keyframeTicks = keyframeTicks;
+  int ticks = (int)ceil(seconds / SIM_TICK_SECONDS);
+  // The oldest segment may be partly dropped already, so keep one extra
+  history.segments.assign((ticks + keyframeTicks - 1) / keyframeTicks + 1,
+                          RewindSegment());
+  rewindClear(history);
+}
+
+void rewindClear(RewindHistory &history) {
+  history.first = 0;
+  history.count = 0;
+  history.newest.clear();
+  history.newestTick = 0;
+}
+
+void rewindRecord(RewindHistory &history, unsigned int tick,
+                  const std::vector<int> &fields) {
+  if (history.count > 0 && (tick != history.newestTick + 1 ||
+                            fields.size() != history.newest.size()))
+    rewindClear(history);
+
+  int ring = history.segments.size();
+  if (history.count == 0 ||
+      segmentAt(history, history.count - 1).frames == history.keyframeTicks) {
+    if (history.count == ring) {
+      history.first = (history.first + 1) % ring;
+      history.count--;
+    }
+    RewindSegment &segment = segmentAt(history, history.count++);
+    segment.firstTick = tick;
+    segment.frames = 1;
+    segment.bytes.clear(); // Keeps its capacity
+    for (size_t i = 0; i < fields.size(); i++)
+      writeVarint(segment.bytes, zigzag((unsigned int)fields[i]));
+  } else {
+    RewindSegment &segment = segmentAt(history, history.count - 1);
+    history.scratch.clear();
+    for (size_t i = 0; i < fields.size(); i++) {
+      if (fields[i] != history.newest[i])
+        history.scratch.push_back(i);
+    }
+    writeVarint(segment.bytes, history.scratch.size());
+    size_t previous = 0;
+    for (size_t c = 0; c < history.scratch.size(); c++) {
+      size_t i = history.scratch[c];
+      writeVarint(segment.bytes, i - previous);
+      writeVarint(segment.bytes, zigzag((unsigned int)fields[i] -
+                                        (unsigned int)history.newest[i]));
+      previous = i;
+    }
+    segment.frames++;
+  }
+  history.newest = fields;
+  history.newestTick = tick;
+}
+
+bool rewindSeek(const RewindHistory &history, unsigned int tick,
+                std::vector<int> &fields) {
+  if (history.count == 0 || tick > history.newestTick)
+    return false;
+  unsigned int oldest = segmentAt(history, 0).firstTick;
+  if (tick < oldest)
+    return false;
+  // Every segment but the newest holds keyframeTicks frames
+  const RewindSegment &segment =
+      segmentAt(history, (tick - oldest) / history.keyframeTicks);
+  fields.resize(history.newest.size());
+  decodeSegment(segment, tick - segment.firstTick, fields);
+  return true;
+}
+
+bool rewindPop(RewindHistory &history, std::vector<int> &fields,
+               unsigned int &tick) {
+  if (rewindTicks(history) <= 1)
+    return false;
+  RewindSegment &segment = segmentAt(history, history.count - 1);
+  history.newestTick--;
+  if (segment.frames == 1) {
+    history.count--;
+    rewindSeek(history, history.newestTick, history.newest);
+  } else {
+    segment.frames--;
+    segment.bytes.resize(
+        decodeSegment(segment, segment.frames - 1, history.newest));
+  }
+  fields = history.newest;
+  tick = history.newestTick;
+  return true;
+}
+
+unsigned int rewindTicks(const RewindHistory &history) {
+  if (history.count == 0)
+    return 0;
+  return history.newestTick - segmentAt(history, 0).firstTick + 1;
+}
+
+size_t rewindBytes(const RewindHistory &history) {
+  size_t bytes = 0;
+  for (size_t s = 0; s < history.segments.size(); s++)
+    bytes += history.segments[s].bytes.capacity();
+  return bytes;
+}
+
+static int floatBits(float value) {
+  int bits;
+  memcpy(&bits, &value, sizeof(bits));
+  return bits;
+}
+
+static float bitsFloat(int bits) {
+  float value;
+  memcpy(&value, &bits, sizeof(value));
+  return value;
+}
+
+void rewindCapture(const SimState &sim, const float camera[3],
+                   std::vector<int> &fields) {
+  const Block &block = sim.block;
+  fields.assign(FIELD_GROUPS + (sim.toggleGroups.size() + 31) / 32, 0);
+  fields[FIELD_ROW] = block.row;
+  fields[FIELD_COL] = block.col;
+  fields[FIELD_ORIENTATION] = block.orientation;
+  fields[FIELD_ANIMATING] = block.isAnimating;
+  fields[FIELD_ANIMATION_TICK] = block.animationTick;
+  fields[FIELD_FROM_ROW] = block.fromRow;
+  fields[FIELD_FROM_COL] = block.fromCol;
+  fields[FIELD_FROM_ORIENTATION] = block.fromOrientation;
+  fields[FIELD_MOVE_DX] = block.moveDx;
+  fields[FIELD_MOVE_DZ] = block.moveDz;
+  fields[FIELD_FALLING] = block.isFalling;
+  fields[FIELD_FALL_TICK] = block.fallTick;
+  fields[FIELD_WON] = sim.won;
+  fields[FIELD_MOVE_FROM] = sim.moveFrom;
+  for (int c = 0; c < 3; c++)
+    fields[FIELD_CAMERA + c] = floatBits(camera[c]);
+  for (size_t g = 0; g < sim.toggleGroups.size(); g++) {
+    if (sim.toggleGroups[g].visible)
+      fields[FIELD_GROUPS + g / 32] |= 1u << (g % 32);
+  }
+}
+
+bool rewindRestore(SimState &sim, float camera[3],
+                   const std::vector<int> &fields) {
+  if (fields.size() != FIELD_GROUPS + (sim.toggleGroups.size() + 31) / 32)
+    return false;
+  Block &block = sim.block;
+  block.row = fields[FIELD_ROW];
+  block.col = fields[FIELD_COL];
+  block.orientation = (BlockOrientation)fields[FIELD_ORIENTATION];
+  block.isAnimating = fields[FIELD_ANIMATING] != 0;
+  block.animationTick = fields[FIELD_ANIMATION_TICK];
+  block.fromRow = fields[FIELD_FROM_ROW];
+  block.fromCol = fields[FIELD_FROM_COL];
+  block.fromOrientation = (BlockOrientation)fields[FIELD_FROM_ORIENTATION];
+  block.moveDx = fields[FIELD_MOVE_DX];
+  block.moveDz = fields[FIELD_MOVE_DZ];
+  block.isFalling = fields[FIELD_FALLING] != 0;
+  block.fallTick = fields[FIELD_FALL_TICK];
+  sim.won = fields[FIELD_WON] != 0;
+  sim.moveFrom = fields[FIELD_MOVE_FROM];
+  for (int c = 0; c < 3; c++)
+    camera[c] = bitsFloat(fields[FIELD_CAMERA + c]);
+  for (size_t g = 0; g < sim.toggleGroups.size(); g++) {
+    bool visible = (fields[FIELD_GROUPS + g / 32] >> (g % 32)) & 1;
+    if (visible != sim.toggleGroups[g].visible)
+      simSetGroupVisible(sim, sim.toggleGroups[g], visible);
+  }
+  return true;
+}
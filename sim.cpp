@@ -0,0 +1,484 @@
+#include "headers/sim.h"
+#include <cstdlib>
+
+void simLoadLevel(SimState &sim, const std::vector<std::vector<int> > &layout,
+                  const std::vector<SwitchDef> &switches) {
+  sim.layout = layout;
+  sim.switches = switches;
+  sim.rows = sim.layout.size();
+  sim.cols = sim.rows ? sim.layout[0].size() : 0;
+  sim.startRow = sim.startCol = 1;
+
+  // Keep the authored level before any tiles are rewritten
+  sim.source = sim.layout;
+  simFindStart(sim);
+
+  // Pair action tiles with bridges and hide the bridges initially
+  simBuildToggleGroups(sim);
+  sim.tileCount = simCountTiles(sim);
+  simHideBridges(sim);
+
+  simResetBlock(sim);
+  sim.won = false;
+  sim.tick = 0;
+  sim.pendingTime = 0.0;
+  simClearHistory(sim);
+  sim.moveFrom = 0;
+}
+
+bool simIdle(const SimState &sim) {
+  return !sim.block.isAnimating && !sim.block.isFalling;
+}
+
+// Second footprint cell offset for each orientation (STANDING repeats the
+// first cell)
+static const int FOOT_DROW[3] = {0, 0, 1};
+static const int FOOT_DCOL[3] = {0, 1, 0};
+
+void simSecondCell(const Block &block, int &row, int &col) {
+  row = block.row + FOOT_DROW[block.orientation];
+  col = block.col + FOOT_DCOL[block.orientation];
+}
+
+static void writeVarint(std::vector<unsigned char> &out, unsigned int v) {
+  while (v >= 0x80) {
+    out.push_back((unsigned char)(v | 0x80));
+    v >>= 7;
+  }
+  out.push_back((unsigned char)v);
+}
+
+static unsigned int readVarint(const unsigned char *&p) {
+  unsigned int v = 0;
+  for (int shift = 0;; shift += 7) {
+    unsigned char byte = *p++;
+    v |= (unsigned int)(byte & 0x7F) << shift;
+    if (!(byte & 0x80))
+      return v;
+  }
+}
+
+// A roll from the grid lands at most 2 cells past its edge, so cells are
+// packed offset by this margin to keep off-grid (falling) blocks positive
+static const int PACK_MARGIN = 2;
+
+// Block cell and orientation in one number, for history deltas
+static int packBlock(const SimState &sim) {
+  int cols = sim.cols + 2 * PACK_MARGIN;
+  return ((sim.block.row + PACK_MARGIN) * cols + sim.block.col +
+          PACK_MARGIN) * 3 +
+         sim.block.orientation;
+}
+
+static void unpackBlock(const SimState &sim, int state, Block &block) {
+  int cols = sim.cols + 2 * PACK_MARGIN;
+  block.row = block.fromRow = state / 3 / cols - PACK_MARGIN;
+  block.col = block.fromCol = state / 3 % cols - PACK_MARGIN;
+  block.orientation = block.fromOrientation = (BlockOrientation)(state % 3);
+}
+
+// Check if block is on a toggle action tile and toggle the corresponding
+// tiles, appending each toggled group to the undo delta being written
+static void checkToggleTiles(SimState &sim) {
+  const Block &block = sim.block;
+  int row2, col2;
+  simSecondCell(block, row2, col2);
+  bool onAction1 = simTileAt(sim, block.row, block.col) == 5;
+  bool onAction2 = simTileAt(sim, row2, col2) == 5;
+  if (!onAction1 && !onAction2) {
+    return;
+  }
+
+  // Toggle every group whose action tile is under the block (a standing
+  // block counts its single cell once)
+  for (size_t g = 0; g < sim.toggleGroups.size(); g++) {
+    ToggleGroup &group = sim.toggleGroups[g];
+    bool onGroup = (onAction1 && block.row == group.actionRow &&
+                    block.col == group.actionCol) ||
+                   (onAction2 && row2 == group.actionRow &&
+                    col2 == group.actionCol);
+    if (onGroup) {
+      simSetGroupVisible(sim, group, !group.visible);
+      writeVarint(sim.undoBytes, g);
+    }
+  }
+}
+
+// Check if block is standing on the goal tile (type 2)
+static void checkWinCondition(SimState &sim) {
+  const Block &block = sim.block;
+  if (block.orientation == STANDING &&
+      simTileAt(sim, block.row, block.col) == 2) {
+    sim.won = true;
+  }
+}
+
+// Close a delta started at 'start' by appending its length backwards
+static void endDelta(std::vector<unsigned char> &bytes, size_t start) {
+  size_t length = bytes.size() - start;
+  unsigned char varint[8];
+  int n = 0;
+  for (; length >= 0x80; length >>= 7)
+    varint[n++] = (unsigned char)(length | 0x80);
+  varint[n++] = (unsigned char)length;
+  while (n > 0)
+    bytes.push_back(varint[--n]);
+}
+
+// Undo (or redo) one step: pop a delta, restore its block state and flip
+// its groups, and push the state it replaces as the opposite delta
+static bool popDelta(SimState &sim, std::vector<unsigned char> &from,
+                     int &fromCount, std::vector<unsigned char> &to,
+                     int &toCount) {
+  if (from.empty())
+    return false;
+  size_t end = from.size(), length = 0;
+  unsigned char byte;
+  int shift = 0;
+  do {
+    byte = from[--end];
+    length |= (size_t)(byte & 0x7F) << shift;
+    shift += 7;
+  } while (byte & 0x80);
+  size_t start = end - length;
+
+  const unsigned char *p = &from[start];
+  size_t toStart = to.size();
+  writeVarint(to, packBlock(sim));
+  int state = readVarint(p);
+  while (p < &from[0] + end) {
+    int g = readVarint(p);
+    simSetGroupVisible(sim, sim.toggleGroups[g], !sim.toggleGroups[g].visible);
+    writeVarint(to, g);
+  }
+  endDelta(to, toStart);
+  from.resize(start);
+  fromCount--;
+  toCount++;
+
+  Block &block = sim.block;
+  unpackBlock(sim, state, block);
+  block.isAnimating = false;
+  block.animationTick = 0;
+  block.moveDx = block.moveDz = 0;
+  block.isFalling = false;
+  block.fallTick = 0;
+  sim.won = false;
+  checkWinCondition(sim);
+  // Redoing a move that fell falls again
+  if (!sim.won && simBlockShouldFall(sim))
+    block.isFalling = true;
+  return true;
+}
+
+bool simStep(SimState &sim, SimInput input) {
+  Block &block = sim.block;
+  bool applied = false;
+  if (input == INPUT_RESET) {
+    sim.won = false;
+    simResetBlock(sim);
+    simHideBridges(sim);
+    simClearHistory(sim);
+    applied = true;
+  } else if (input == INPUT_UNDO || input == INPUT_REDO) {
+    if (simIdle(sim) || block.isFalling) {
+      applied = input == INPUT_UNDO
+                    ? popDelta(sim, sim.undoBytes, sim.undoCount,
+                               sim.redoBytes, sim.redoCount)
+                    : popDelta(sim, sim.redoBytes, sim.redoCount,
+                               sim.undoBytes, sim.undoCount);
+    }
+  } else if (input != INPUT_NONE && simIdle(sim)) {
+    sim.moveFrom = packBlock(sim);
+    simMoveBlock(sim, input);
+    sim.redoBytes.clear();
+    sim.redoCount = 0;
+    applied = true;
+  }
+  sim.tick++;
+
+  // Handle falling: reset when fallen far enough
+  if (block.isFalling) {
+    if (++block.fallTick >= FALL_RESET_TICKS) {
+      simResetBlock(sim);
+    }
+    return applied;
+  }
+
+  // The roll lands on its last tick; the block already holds its new cell
+  if (block.isAnimating && ++block.animationTick >= BLOCK_ANIMATION_TICKS) {
+    block.isAnimating = false;
+    size_t delta = sim.undoBytes.size();
+    writeVarint(sim.undoBytes, sim.moveFrom);
+    checkToggleTiles(sim);
+    endDelta(sim.undoBytes, delta);
+    sim.undoCount++;
+    checkWinCondition(sim);
+
+    // Check if block should fall (only if not won)
+    if (!sim.won && simBlockShouldFall(sim)) {
+      block.isFalling = true;
+      block.fallTick = 0;
+    }
+  }
+  return applied;
+}
+
+int simUpdate(SimState &sim, double dt, SimInput input, bool *applied) {
+  int ticks = 0;
+  if (applied)
+    *applied = false;
+  sim.pendingTime += dt;
+  while (sim.pendingTime >= SIM_TICK_SECONDS) {
+    sim.pendingTime -= SIM_TICK_SECONDS;
+    bool took = simStep(sim, ticks == 0 ? input : INPUT_NONE);
+    if (ticks == 0 && applied)
+      *applied = took;
+    ticks++;
+  }
+  return ticks;
+}
+
+static void hashBytes(unsigned long long &h, const void *data, size_t size) {
+  const unsigned char *p = (const unsigned char *)data;
+  for (size_t i = 0; i < size; i++) {
+    h ^= p[i];
+    h *= 1099511628211ull;
+  }
+}
+
+static void hashInt(unsigned long long &h, int value) {
+  hashBytes(h, &value, sizeof(value));
+}
+
+unsigned long long simLevelHash(const SimState &sim) {
+  unsigned long long h = 14695981039346656037ull;
+  hashInt(h, sim.rows);
+  hashInt(h, sim.cols);
+  for (int i = 0; i < sim.rows; i++)
+    for (int j = 0; j < sim.cols; j++)
+      hashInt(h, sim.source[i][j]);
+  for (size_t s = 0; s < sim.switches.size(); s++) {
+    hashInt(h, sim.switches[s].actionRow);
+    hashInt(h, sim.switches[s].actionCol);
+    for (size_t t = 0; t < sim.switches[s].tiles.size(); t++) {
+      hashInt(h, sim.switches[s].tiles[t].first);
+      hashInt(h, sim.switches[s].tiles[t].second);
+    }
+  }
+  return h;
+}
+
+unsigned long long simStateHash(const SimState &sim) {
+  const Block &block = sim.block;
+  unsigned long long h = 14695981039346656037ull;
+  hashInt(h, (int)sim.tick);
+  hashInt(h, block.row);
+  hashInt(h, block.col);
+  hashInt(h, block.orientation);
+  hashInt(h, block.isAnimating);
+  hashInt(h, block.animationTick);
+  hashInt(h, block.isFalling);
+  hashInt(h, block.fallTick);
+  for (size_t g = 0; g < sim.toggleGroups.size(); g++)
+    hashInt(h, sim.toggleGroups[g].visible);
+  hashInt(h, sim.won);
+  return h;
+}
+
+// Rolls: for each orientation and direction (left, right, up, down) the
+// change of the top-left cell and the new orientation. Rolling along the
+// long side of a lying block keeps it lying; otherwise the block stands up
+// or tips over, covering two cells.
+static const struct {
+  signed char dRow, dCol;
+  unsigned char orientation;
+} ROLLS[3][4] = {
+    // STANDING
+    {{0, -2, LYING_X}, {0, 1, LYING_X}, {-2, 0, LYING_Z}, {1, 0, LYING_Z}},
+    // LYING_X
+    {{0, -1, STANDING}, {0, 2, STANDING}, {-1, 0, LYING_X}, {1, 0, LYING_X}},
+    // LYING_Z
+    {{0, -1, LYING_Z}, {0, 1, LYING_Z}, {-1, 0, STANDING}, {2, 0, STANDING}},
+};
+
+void simMoveBlock(SimState &sim, SimInput direction) {
+  static const int dx[5] = {0, -1, 1, 0, 0};
+  static const int dz[5] = {0, 0, 0, -1, 1};
+  if (direction < INPUT_LEFT || direction > INPUT_DOWN)
+    return;
+
+  Block &block = sim.block;
+  block.fromRow = block.row;
+  block.fromCol = block.col;
+  block.fromOrientation = block.orientation;
+  block.moveDx = dx[direction];
+  block.moveDz = dz[direction];
+
+  const int d = direction - INPUT_LEFT;
+  block.row += ROLLS[block.orientation][d].dRow;
+  block.col += ROLLS[block.orientation][d].dCol;
+  block.orientation = (BlockOrientation)ROLLS[block.orientation][d].orientation;
+  block.isAnimating = true;
+  block.animationTick = 0;
+}
+
+int simTileAt(const SimState &sim, int row, int col) {
+  if ((unsigned)row >= (unsigned)sim.rows ||
+      (unsigned)col >= (unsigned)sim.cols) {
+    return 0; // Out of bounds = empty
+  }
+  return sim.layout[row][col];
+}
+
+// The block falls if either footprint cell is empty
+bool simBlockShouldFall(const SimState &sim) {
+  const Block &block = sim.block;
+  int row2, col2;
+  simSecondCell(block, row2, col2);
+  return simTileAt(sim, block.row, block.col) == 0 ||
+         simTileAt(sim, row2, col2) == 0;
+}
+
+void simResetBlock(SimState &sim) {
+  Block &block = sim.block;
+  block.row = block.fromRow = sim.startRow;
+  block.col = block.fromCol = sim.startCol;
+  block.orientation = block.fromOrientation = STANDING;
+  block.isAnimating = false;
+  block.animationTick = 0;
+  block.moveDx = block.moveDz = 0;
+  block.isFalling = false;
+  block.fallTick = 0;
+}
+
+// Find starting position from tile 9 in level data and convert it to normal
+// tile
+void simFindStart(SimState &sim) {
+  for (int i = 0; i < sim.rows; i++) {
+    for (int j = 0; j < sim.cols; j++) {
+      if (sim.layout[i][j] == 9) {
+        sim.startRow = i;
+        sim.startCol = j;
+        sim.layout[i][j] = 1;
+        return;
+      }
+    }
+  }
+}
+
+// Build the toggle table from the level's @switch lines, or pair every
+// action tile (5) with the connected run of bridge tiles (4) closest to it
+// in the authored level
+void simBuildToggleGroups(SimState &sim) {
+  std::vector<ToggleGroup> &groups = sim.toggleGroups;
+  const std::vector<std::vector<int> > &source = sim.source;
+  groups.clear();
+
+  if (!sim.switches.empty()) {
+    for (size_t s = 0; s < sim.switches.size(); s++) {
+      ToggleGroup group = {sim.switches[s].actionRow,
+                           sim.switches[s].actionCol, sim.switches[s].tiles,
+                           false};
+      groups.push_back(group);
+    }
+    return;
+  }
+
+  // Label connected bridge runs with a flood fill
+  std::vector<std::vector<int> > runId(sim.rows,
+                                       std::vector<int>(sim.cols, -1));
+  std::vector<std::vector<std::pair<int, int> > > runs;
+  const int dr[4] = {-1, 1, 0, 0};
+  const int dc[4] = {0, 0, -1, 1};
+  for (int i = 0; i < sim.rows; i++) {
+    for (int j = 0; j < sim.cols; j++) {
+      if (source[i][j] != 4 || runId[i][j] >= 0)
+        continue;
+      std::vector<std::pair<int, int> > run;
+      std::vector<std::pair<int, int> > stack(1, std::make_pair(i, j));
+      runId[i][j] = runs.size();
+      while (!stack.empty()) {
+        std::pair<int, int> cell = stack.back();
+        stack.pop_back();
+        run.push_back(cell);
+        for (int d = 0; d < 4; d++) {
+          int r = cell.first + dr[d];
+          int c = cell.second + dc[d];
+          if (r >= 0 && r < sim.rows && c >= 0 && c < sim.cols &&
+              source[r][c] == 4 && runId[r][c] < 0) {
+            runId[r][c] = runs.size();
+            stack.push_back(std::make_pair(r, c));
+          }
+        }
+      }
+      runs.push_back(run);
+    }
+  }
+  if (runs.empty())
+    return;
+
+  // Nearest run by Manhattan distance to any of its tiles
+  for (int i = 0; i < sim.rows; i++) {
+    for (int j = 0; j < sim.cols; j++) {
+      if (source[i][j] != 5)
+        continue;
+      int best = 0, bestDist = -1;
+      for (size_t r = 0; r < runs.size(); r++) {
+        for (size_t t = 0; t < runs[r].size(); t++) {
+          int dist = abs(runs[r][t].first - i) + abs(runs[r][t].second - j);
+          if (bestDist < 0 || dist < bestDist) {
+            bestDist = dist;
+            best = r;
+          }
+        }
+      }
+      ToggleGroup group = {i, j, runs[best], false};
+      groups.push_back(group);
+    }
+  }
+}
+
+void simClearHistory(SimState &sim) {
+  sim.undoBytes.clear();
+  sim.redoBytes.clear();
+  sim.undoCount = sim.redoCount = 0;
+}
+
+// Hide every bridge (the state a level starts in)
+void simHideBridges(SimState &sim) {
+  for (size_t g = 0; g < sim.toggleGroups.size(); g++) {
+    sim.toggleGroups[g].visible = false;
+    for (size_t i = 0; i < sim.toggleGroups[g].tiles.size(); i++) {
+      int &tile = sim.layout[sim.toggleGroups[g].tiles[i].first]
+                            [sim.toggleGroups[g].tiles[i].second];
+      if (tile != 0) {
+        tile = 0;
+        sim.tileCount--;
+      }
+    }
+  }
+}
+
+// Show or hide every bridge tile of a toggle group
+void simSetGroupVisible(SimState &sim, ToggleGroup &group, bool visible) {
+  group.visible = visible;
+  for (size_t i = 0; i < group.tiles.size(); i++) {
+    int &tile = sim.layout[group.tiles[i].first][group.tiles[i].second];
+    int value = visible ? 4 : 0;
+    sim.tileCount += (value != 0) - (tile != 0);
+    tile = value;
+  }
+}
+
+// Count non-empty tiles (full scan; tile changes keep the count current)
+int simCountTiles(const SimState &sim) {
+  int count = 0;
+  for (int i = 0; i < sim.rows; ++i) {
+    for (int j = 0; j < sim.cols; ++j) {
+      if (sim.layout[i][j] != 0)
+        count++;
+    }
+  }
+  return count;
+}
@@ -0,0 +1,55 @@
+#include "headers/startup.h"
+#include <cstdio>
+#include <mutex>
+#include <vector>
+
+struct StartupPhase {
+  const char *name;
+  double beginMs, endMs;
+  bool background;
+};
+
+static StartupTime processStart;
+static std::vector<StartupPhase> phases;
+static std::mutex phasesMutex;
+static double firstFrameMs = -1.0;
+
+// High priority so it runs ahead of the other files' static initializers
+__attribute__((constructor(101))) static void markProcessStart() {
+  processStart = std::chrono::steady_clock::now();
+}
+
+static double msSinceStart(StartupTime t) {
+  return std::chrono::duration<double, std::milli>(t - processStart).count();
+}
+
+StartupTime startupProcessStart() { return processStart; }
+
+void startupRecord(const char *phase, StartupTime begin, bool background) {
+  StartupPhase p = {phase, msSinceStart(begin),
+                    msSinceStart(std::chrono::steady_clock::now()),
+                    background};
+  std::lock_guard<std::mutex> lock(phasesMutex);
+  phases.push_back(p);
+}
+
+void startupFirstFrame() {
+  if (firstFrameMs < 0.0)
+    firstFrameMs = msSinceStart(std::chrono::steady_clock::now());
+}
+
+bool startupFrameShown() { return firstFrameMs >= 0.0; }
+
+void printStartupTrace() {
+  std::lock_guard<std::mutex> lock(phasesMutex);
+  printf("Startup trace (ms since process start):\n");
+  for (size_t i = 0; i < phases.size(); i++) {
+    const StartupPhase &p = phases[i];
+    printf("  %-16s %8.2f -> %8.2f  %8.2f ms%s\n", p.name, p.beginMs, p.endMs,
+           p.endMs - p.beginMs, p.background ? "  (background)" : "");
+  }
+  if (firstFrameMs >= 0.0)
+    printf("  time to first frame %.2f ms\n", firstFrameMs);
+  else
+    printf("  no frame was shown\n");
+}
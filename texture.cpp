@@ -0,0 +1,109 @@
+#define GL_SILENCE_DEPRECATION // Ignore deprecation errors
+#include "headers/texture.h"
+#include "headers/glstate.h"
+#include "dependencies/include/SOIL2/SOIL2.h"
+#include "dependencies/include/SOIL2/image_helper.h"
+#include <GLUT/glut.h>
+#include <cstring>
+
+static bool isPowerOfTwo(int n) { return (n & (n - 1)) == 0; }
+
+bool decodeTexture(const char *path, TextureImage &image) {
+  int width, height, channels;
+  unsigned char *data =
+      SOIL_load_image(path, &width, &height, &channels, SOIL_LOAD_AUTO);
+  if (!data) {
+    image.error = SOIL_last_result();
+    return false;
+  }
+
+  // Flip rows so the first row is the bottom of the image, as GL expects
+  size_t rowBytes = (size_t)width * channels;
+  std::vector<unsigned char> pixels(rowBytes * height);
+  for (int i = 0; i < height; i++)
+    memcpy(&pixels[(height - 1 - i) * rowBytes], data + i * rowBytes,
+           rowBytes);
+  SOIL_free_image_data(data);
+
+  // Grey images become RGB(A): GL_LUMINANCE and GL_LUMINANCE_ALPHA do not
+  // exist in the core profile (--renderer core), and this looks the same
+  if (channels < 3) {
+    int expanded = channels + 2;
+    std::vector<unsigned char> colour((size_t)width * height * expanded);
+    for (size_t p = 0; p < (size_t)width * height; p++) {
+      const unsigned char *in = &pixels[p * channels];
+      unsigned char *out = &colour[p * expanded];
+      out[0] = out[1] = out[2] = in[0];
+      if (channels == 2)
+        out[3] = in[1];
+    }
+    pixels.swap(colour);
+    channels = expanded;
+  }
+
+  // Mipmaps need power-of-two sizes (same rule SOIL applies)
+  if (!isPowerOfTwo(width) || !isPowerOfTwo(height)) {
+    int newWidth = 1, newHeight = 1;
+    while (newWidth < width)
+      newWidth *= 2;
+    while (newHeight < height)
+      newHeight *= 2;
+    std::vector<unsigned char> scaled((size_t)newWidth * newHeight * channels);
+    up_scale_image(pixels.data(), width, height, channels, scaled.data(),
+                   newWidth, newHeight);
+    pixels.swap(scaled);
+    width = newWidth;
+    height = newHeight;
+  }
+
+  image.width = width;
+  image.height = height;
+  image.channels = channels;
+  image.levels.assign(1, std::vector<unsigned char>());
+  image.levels[0].swap(pixels);
+  return true;
+}
+
+void generateMipmaps(TextureImage &image) {
+  int width = image.width, height = image.height;
+  image.levels.resize(1);
+  while (width > 1 || height > 1) {
+    int blockX = width > 1 ? 2 : 1, blockY = height > 1 ? 2 : 1;
+    std::vector<unsigned char> level((size_t)(width / blockX) *
+                                     (height / blockY) * image.channels);
+    mipmap_image(image.levels.back().data(), width, height, image.channels,
+                 level.data(), blockX, blockY);
+    image.levels.push_back(std::vector<unsigned char>());
+    image.levels.back().swap(level);
+    width /= blockX;
+    height /= blockY;
+  }
+}
+
+unsigned int uploadTexture(const TextureImage &image) {
+  if (image.levels.empty() || image.channels < 3 || image.channels > 4)
+    return 0;
+  GLenum format = image.channels == 4 ? GL_RGBA : GL_RGB;
+
+  GLuint id;
+  glGenTextures(1, &id);
+  stateBindTexture(id);
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+  int width = image.width, height = image.height;
+  for (size_t i = 0; i < image.levels.size(); i++) {
+    glTexImage2D(GL_TEXTURE_2D, (GLint)i, format, width, height, 0, format,
+                 GL_UNSIGNED_BYTE, image.levels[i].data());
+    width = width > 1 ? width / 2 : 1;
+    height = height > 1 ? height / 2 : 1;
+  }
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER,
+                  image.levels.size() > 1 ? GL_LINEAR_MIPMAP_LINEAR
+                                          : GL_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+  stateBindTexture(0);
+  return id;
+}
@@ -1,6 +1,8 @@
 #define GL_SILENCE_DEPRECATION
 #include "headers/win.h"
 #include "headers/menu.h"
+#include "headers/glstate.h"
+#include "headers/render.h"
 #include <GLUT/glut.h>
 
 // Win state
@@ -21,20 +23,20 @@ void drawWinScreen() {
     return;
 
   // Switch to 2D orthographic projection
-  glMatrixMode(GL_PROJECTION);
+  stateMatrixMode(GL_PROJECTION);
   glPushMatrix();
   glLoadIdentity();
   gluOrtho2D(0, windowWidth, 0, windowHeight);
-  glMatrixMode(GL_MODELVIEW);
+  stateMatrixMode(GL_MODELVIEW);
   glPushMatrix();
   glLoadIdentity();
 
-  glDisable(GL_LIGHTING);
-  glDisable(GL_DEPTH_TEST);
+  stateDisable(GL_LIGHTING);
+  stateDisable(GL_DEPTH_TEST);
 
   // Semi-transparent dark overlay
-  glEnable(GL_BLEND);
-  glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+  stateEnable(GL_BLEND);
+  stateBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
   glColor4f(0.0f, 0.0f, 0.1f, 0.7f);
   glBegin(GL_QUADS);
   glVertex2i(0, 0);
@@ -58,7 +60,7 @@ void drawWinScreen() {
   glTranslatef((windowWidth - scaledTitleWidth) / 2.0f, windowHeight * 0.55f,
                0);
   glScalef(scale, scale, 1.0f);
-  glLineWidth(4.0f);
+  stateLineWidth(4.0f);
   for (const char *c = title; *c; c++) {
     glutStrokeCharacter(GLUT_STROKE_ROMAN, *c);
   }
@@ -72,14 +74,34 @@ void drawWinScreen() {
   renderWinText((windowWidth - textWidth) / 2.0f, windowHeight * 0.35f,
                 instruction, GLUT_BITMAP_HELVETICA_18);
 
-  glEnable(GL_DEPTH_TEST);
-  glEnable(GL_LIGHTING);
-
-  glMatrixMode(GL_PROJECTION);
+  stateMatrixMode(GL_PROJECTION);
   glPopMatrix();
-  glMatrixMode(GL_MODELVIEW);
+  stateMatrixMode(GL_MODELVIEW);
   glPopMatrix();
 }
 
+// The same with the core renderer, in the pixel font
+void drawWinScreenCore() {
+  if (!hasWon)
+    return;
+
+  stateDisable(GL_DEPTH_TEST);
+  stateEnable(GL_BLEND);
+  stateBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+  const float shade[4] = {0.0f, 0.0f, 0.1f, 0.7f};
+  render2DRect(0, 0, windowWidth, windowHeight, shade);
+
+  const float green[4] = {0.0f, 1.0f, 0.5f, 1.0f};
+  const char *title = "YOU WON!";
+  float titleScale = 10.0f;
+  render2DText((windowWidth - render2DTextWidth(title, titleScale)) / 2.0f,
+               windowHeight * 0.55f, title, titleScale, green);
+
+  const float white[4] = {1.0f, 1.0f, 1.0f, 1.0f};
+  const char *instruction = "Press SPACE to play again";
+  render2DText((windowWidth - render2DTextWidth(instruction, 2.0f)) / 2.0f,
+               windowHeight * 0.35f, instruction, 2.0f, white);
+}
+
 // Reset win state
 void resetWinState() { hasWon = false; }